@@ -0,0 +1,32 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <cstdio>
+#include "../headers/ldata.h"
+
+/*
+ * Helpers shared by the benchmarks in `bench/`, each a standalone program
+ * built by `make bench` into `build/`.
+ */
+namespace bench {
+    // Seconds since an arbitrary point, for timing a run
+    inline auto seconds(void) -> f64 {
+        using Clock = std::chrono::steady_clock;
+        return std::chrono::duration<f64>(Clock::now().time_since_epoch()).count();
+    }
+
+    // Keeps the compiler from throwing away a result nothing else reads
+    template <class T> inline void keep(T const& value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    // Runs `fn` once and returns how long it took in seconds
+    template <class F> inline auto time(F &&fn) -> f64 {
+        f64 const start = seconds();
+        fn();
+        return seconds() - start;
+    }
+}
+
+#endif
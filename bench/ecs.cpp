@@ -0,0 +1,101 @@
+#include "../headers/ldata.h"
+#include "../headers/lecs.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * A movement pass over a million entities, stored in the archetype ECS and
+ * as one heap object per entity updated through a virtual call, the design
+ * the ECS replaces.
+ */
+namespace {
+    constexpr usize ENTITIES = 1000000;
+    constexpr usize FRAMES = 50;
+    constexpr f32 DT = 0.016f;
+
+    struct Position { f32 x, y; };
+    struct Velocity { f32 x, y; };
+    struct Health { i32 value; };
+    struct Name { char text[40]; };
+
+    // The object per entity design, each entity its own allocation
+    struct Object {
+        virtual ~Object(void) {}
+        virtual void update(f32 const dt) = 0;
+    };
+
+    struct Mover: Object {
+        Position position;
+        Velocity velocity;
+        Health health;
+        Name name;
+
+        void update(f32 const dt) override {
+            position.x += velocity.x * dt;
+            position.y += velocity.y * dt;
+        }
+    };
+
+    // A small deterministic generator for the shuffle
+    auto next(u64 &state) -> u64 {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return state >> 33;
+    }
+}
+
+auto main(void) -> int {
+    llib::EcsWorld world(4096);
+    for (usize i = 0; i < ENTITIES; ++i) {
+        Position const p = { static_cast<f32>(i), 0.0f };
+        // Two archetypes, so the query walks more than one table
+        if (i % 3 == 0) world.create(p, Velocity{ 1.0f, 2.0f }, Health{ 10 });
+        else world.create(p, Velocity{ 1.0f, 2.0f }, Health{ 10 }, Name{});
+    }
+
+    llib::EcsQuery<Position, Velocity> query;
+    f64 const ecs = bench::time([&] {
+        for (usize f = 0; f < FRAMES; ++f) {
+            query.each_chunk(world, [](usize const n, llib::Entity const *, Position *p, Velocity *v) {
+                for (usize i = 0; i < n; ++i) {
+                    p[i].x += v[i].x * DT;
+                    p[i].y += v[i].y * DT;
+                }
+            });
+        }
+    });
+
+    // Objects are allocated with other allocations in between and visited
+    // in shuffled order, as they end up after a while of spawning and dying.
+    Object **const objects = reinterpret_cast<Object **>(std::malloc(ENTITIES * sizeof(Object *)));
+    char **const noise = reinterpret_cast<char **>(std::malloc(ENTITIES / 5 * sizeof(char *)));
+    if (objects == nullptr || noise == nullptr) return EXIT_FAILURE;
+    for (usize i = 0; i < ENTITIES; ++i) {
+        Mover *const m = new Mover();
+        m->position = { static_cast<f32>(i), 0.0f };
+        m->velocity = { 1.0f, 2.0f };
+        objects[i] = m;
+        if (i % 5 == 0) noise[i / 5] = new char[64 + i % 200];
+    }
+    u64 state = 1;
+    for (usize i = ENTITIES; i-- > 1;) {
+        usize const j = static_cast<usize>(next(state) % (i + 1));
+        Object *const t = objects[i];
+        objects[i] = objects[j];
+        objects[j] = t;
+    }
+
+    f64 const naive = bench::time([&] {
+        for (usize f = 0; f < FRAMES; ++f)
+            for (usize i = 0; i < ENTITIES; ++i) objects[i]->update(DT);
+    });
+
+    (void)std::printf("ecs query         %6.2f ms/frame\n", ecs * 1e3 / FRAMES);
+    (void)std::printf("object per entity %6.2f ms/frame, %.1fx slower\n", naive * 1e3 / FRAMES, naive / ecs);
+
+    for (usize i = 0; i < ENTITIES; ++i) delete objects[i];
+    for (usize i = 0; i < ENTITIES / 5; ++i) delete[] noise[i];
+    std::free(objects);
+    std::free(noise);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include "../headers/ldata.h"
+#include "../headers/lflatmap.hpp"
+#include "../headers/lrandom.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+
+/*
+ * The flat map against `std::unordered_map` on the keys the game uses:
+ * sequential entity ids, random 64 bit asset hashes and object pointers.
+ * Each size times inserts, hits in shuffled order, misses, and erasing and
+ * re-inserting every other key. Times are nanoseconds per operation.
+ */
+namespace {
+    constexpr usize SIZES[] = { 1000, 100000, 1000000 };
+
+    // Passes over the keys for the hit timing, so small maps time long enough
+    constexpr usize HIT_PASSES = 5;
+
+    struct Times { f64 insert, hit, miss, churn; };
+
+    template <class K> auto run(K const *const keys, K const *const missing, usize const n, Times &flat, Times &std_map) -> bool {
+        K *const shuffled = reinterpret_cast<K *>(std::malloc(n * sizeof(K)));
+        if (shuffled == nullptr) return false;
+        llib::Xoshiro256 rng(n);
+        for (usize i = 0; i < n; ++i) shuffled[i] = keys[i];
+        for (usize i = n; i > 1; --i) {
+            usize const j = rng.next_below(static_cast<u32>(i));
+            K const k = shuffled[i - 1];
+            shuffled[i - 1] = shuffled[j];
+            shuffled[j] = k;
+        }
+
+        llib::FlatMap<K, u32> f;
+        std::unordered_map<K, u32> u;
+        u64 sum = 0;
+        f64 const per_key = 1e9 / static_cast<f64>(n);
+
+        flat.insert = bench::time([&] { for (usize i = 0; i < n; ++i) f.insert(keys[i], static_cast<u32>(i)); }) * per_key;
+        std_map.insert = bench::time([&] { for (usize i = 0; i < n; ++i) u[keys[i]] = static_cast<u32>(i); }) * per_key;
+
+        flat.hit = bench::time([&] {
+            for (usize p = 0; p < HIT_PASSES; ++p)
+                for (usize i = 0; i < n; ++i) sum += *f.find(shuffled[i]);
+        }) * per_key / HIT_PASSES;
+        std_map.hit = bench::time([&] {
+            for (usize p = 0; p < HIT_PASSES; ++p)
+                for (usize i = 0; i < n; ++i) sum += u.find(shuffled[i])->second;
+        }) * per_key / HIT_PASSES;
+
+        flat.miss = bench::time([&] { for (usize i = 0; i < n; ++i) sum += f.find(missing[i]) != nullptr; }) * per_key;
+        std_map.miss = bench::time([&] { for (usize i = 0; i < n; ++i) sum += u.count(missing[i]); }) * per_key;
+
+        flat.churn = bench::time([&] {
+            for (usize i = 0; i < n; i += 2) f.erase(keys[i]);
+            for (usize i = 0; i < n; i += 2) f.insert(keys[i], 1);
+        }) * per_key;
+        std_map.churn = bench::time([&] {
+            for (usize i = 0; i < n; i += 2) u.erase(keys[i]);
+            for (usize i = 0; i < n; i += 2) u[keys[i]] = 1;
+        }) * per_key;
+        bench::keep(sum);
+
+        bool ok = f.size() == u.size();
+        for (usize i = 0; ok && i < n; ++i) {
+            u32 const *const v = f.find(keys[i]);
+            ok = v != nullptr && *v == u[keys[i]] && f.find(missing[i]) == nullptr;
+        }
+        std::free(shuffled);
+        return ok;
+    }
+
+    void print(char const *const name, usize const n, Times const& flat, Times const& std_map) {
+        (void)std::printf(
+            "%-9s %8zu  insert %6.1f %6.1f  hit %6.1f %6.1f  miss %6.1f %6.1f  churn %6.1f %6.1f\n",
+            name, n, flat.insert, std_map.insert, flat.hit, std_map.hit, flat.miss, std_map.miss, flat.churn, std_map.churn
+        );
+    }
+}
+
+auto main(void) -> int {
+    usize const most = SIZES[sizeof(SIZES) / sizeof(SIZES[0]) - 1];
+    u32 *const ids = reinterpret_cast<u32 *>(std::malloc(2 * most * sizeof(u32)));
+    u64 *const hashes = reinterpret_cast<u64 *>(std::malloc(2 * most * sizeof(u64)));
+    u64 *const objects = reinterpret_cast<u64 *>(std::malloc(2 * most * sizeof(u64)));
+    u64 **const pointers = reinterpret_cast<u64 **>(std::malloc(2 * most * sizeof(u64 *)));
+    if (ids == nullptr || hashes == nullptr || objects == nullptr || pointers == nullptr) return EXIT_FAILURE;
+
+    (void)std::printf("ns per operation, flat map then std::unordered_map\n");
+    llib::Xoshiro256 rng(1);
+    for (usize const n : SIZES) {
+        // The first `n` of each are inserted and the next `n` are misses
+        for (usize i = 0; i < 2 * n; ++i) {
+            ids[i] = static_cast<u32>(i);
+            hashes[i] = rng.next();
+            pointers[i] = objects + (i % 2 == 0 ? i / 2 : n + i / 2);
+        }
+
+        Times flat, std_map;
+        if (!run(ids, ids + n, n, flat, std_map)) return EXIT_FAILURE;
+        print("ids", n, flat, std_map);
+        if (!run(hashes, hashes + n, n, flat, std_map)) return EXIT_FAILURE;
+        print("hashes", n, flat, std_map);
+        if (!run(pointers, pointers + n, n, flat, std_map)) return EXIT_FAILURE;
+        print("pointers", n, flat, std_map);
+    }
+
+    std::free(ids);
+    std::free(hashes);
+    std::free(objects);
+    std::free(pointers);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+#include "../headers/ldata.h"
+#include "../headers/lassets.hpp"
+#include "../headers/lloader.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Loading an asset pack of mixed sizes, with `pread` on the game thread
+ * against the asynchronous loader over io_uring and over its worker pool:
+ *
+ * - a level load, requesting every asset and waiting for them all
+ * - frames of 2 ms of game work that each stream in a few assets, timing
+ *   what the loading costs the game thread
+ *
+ * The page cache is dropped for the pack before each run, so reads go to
+ * the disk where the kernel honours that.
+ */
+namespace {
+    char const *const PACK_PATH = "/tmp/bench_loader.pak";
+
+    constexpr usize SMALL = 1000;
+    constexpr usize MEDIUM = 200;
+    constexpr usize LARGE = 10;
+    constexpr usize ASSETS = SMALL + MEDIUM + LARGE;
+
+    constexpr usize FRAMES = 300;
+    constexpr usize STREAM_PER_FRAME = 8;
+    constexpr f64 FRAME_WORK = 0.002;
+
+    enum Method { METHOD_PREAD, METHOD_URING, METHOD_WORKERS };
+
+    char const *const NAMES[] = { "pread", "io_uring", "workers" };
+
+    auto asset_size(usize const i) -> usize {
+        if (i < SMALL) return 4096 + (i * 7919) % 12288;
+        if (i < SMALL + MEDIUM) return 65536 + (i * 104729) % 196608;
+        return 2 << 20;
+    }
+
+    auto write_pack(void) -> bool {
+        u8 *const data = reinterpret_cast<u8 *>(std::malloc(2 << 20));
+        if (data == nullptr) return false;
+        llib::AssetPackBuilder builder(ASSETS);
+        char name[32];
+        bool ok = true;
+        for (usize i = 0; i < ASSETS && ok; ++i) {
+            usize const size = asset_size(i);
+            for (usize k = 0; k < size; ++k) data[k] = static_cast<u8>(i + k);
+            (void)std::snprintf(name, sizeof(name), "bench/%zu", i);
+            ok = builder.add(name, 0, data, size);
+        }
+        ok = ok && builder.write(PACK_PATH);
+        std::free(data);
+        return ok;
+    }
+
+    void drop_cache(int const fd) {
+        (void)::fdatasync(fd);
+        (void)::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+
+    // What every load is checked against: its size plus its middle byte
+    auto check(u8 const *const data, usize const size) -> u64 { return size + data[size / 2]; }
+
+    // Reads every asset and returns the sum of their checks, or 0 on failure
+    auto level_load(Method const method, int const fd, llib::AssetPack &pack) -> u64 {
+        u64 sum = 0;
+        if (method == METHOD_PREAD) {
+            u8 *const buffer = reinterpret_cast<u8 *>(std::malloc(2 << 20));
+            if (buffer == nullptr) return 0;
+            for (usize i = 0; i < pack.count(); ++i) {
+                llib::AssetEntry const& e = pack.entry(i);
+                usize const size = static_cast<usize>(e.size);
+                if (::pread(fd, buffer, size, static_cast<off_t>(e.offset)) != static_cast<isize>(size)) {
+                    sum = 0;
+                    break;
+                }
+                sum += check(buffer, size);
+            }
+            std::free(buffer);
+            return sum;
+        }
+
+        llib::AsyncLoader loader(ASSETS, 64, 4, method == METHOD_URING);
+        for (usize i = 0; i < pack.count(); ++i)
+            if (loader.request(fd, pack.entry(i), llib::LOAD_NORMAL) == nullptr) return 0;
+
+        bool failed = false;
+        while (loader.pending() > 0) {
+            loader.pump();
+            loader.poll([&](llib::LoadSlot &slot) {
+                if (slot.state == llib::LOAD_DONE) sum += check(slot.data, slot.size);
+                else failed = true;
+                loader.release(&slot);
+            });
+        }
+        return failed ? 0 : sum;
+    }
+
+    struct FrameTimes {
+        // Game thread time spent on loading per frame
+        f64 load_mean;
+        f64 load_worst;
+        f64 frame_worst;
+    };
+
+    // Runs frames of game work, each streaming in a few more assets
+    auto stream(Method const method, int const fd, llib::AssetPack &pack) -> FrameTimes {
+        FrameTimes times{};
+        u8 *const buffer = reinterpret_cast<u8 *>(std::malloc(2 << 20));
+        llib::AsyncLoader loader(FRAMES * STREAM_PER_FRAME, 64, 4, method == METHOD_URING);
+        u64 sum = 0;
+        usize next = 0;
+
+        for (usize f = 0; f < FRAMES && buffer != nullptr; ++f) {
+            f64 const start = bench::seconds();
+            for (usize k = 0; k < STREAM_PER_FRAME; ++k, ++next) {
+                // Skip the large assets, which no frame would stream whole
+                llib::AssetEntry const& e = pack.entry(next * 7 % (SMALL + MEDIUM));
+                if (method == METHOD_PREAD) {
+                    usize const size = static_cast<usize>(e.size);
+                    if (::pread(fd, buffer, size, static_cast<off_t>(e.offset)) == static_cast<isize>(size))
+                        sum += check(buffer, size);
+                } else {
+                    (void)loader.request(fd, e, llib::LOAD_BACKGROUND);
+                }
+            }
+            if (method != METHOD_PREAD) {
+                loader.pump();
+                loader.poll([&](llib::LoadSlot &slot) {
+                    if (slot.state == llib::LOAD_DONE) sum += check(slot.data, slot.size);
+                    loader.release(&slot);
+                });
+            }
+            f64 const load = bench::seconds() - start;
+
+            while (bench::seconds() - start < FRAME_WORK + load) {}
+            f64 const frame = bench::seconds() - start;
+
+            times.load_mean += load / FRAMES;
+            if (load > times.load_worst) times.load_worst = load;
+            if (frame > times.frame_worst) times.frame_worst = frame;
+        }
+
+        bench::keep(sum);
+        std::free(buffer);
+        return times;
+    }
+}
+
+auto main(void) -> int {
+    if (!write_pack()) {
+        (void)std::printf("couldn't write %s\n", PACK_PATH);
+        return EXIT_FAILURE;
+    }
+
+    int const fd = ::open(PACK_PATH, O_RDONLY);
+    bool ok = fd >= 0;
+    {
+        llib::AssetPack pack(PACK_PATH);
+        ok = ok && pack.valid();
+
+        {
+            llib::AsyncLoader probe(1, 1, 1);
+            (void)std::printf("%zu assets, io_uring %s\n", ASSETS, probe.using_uring() ? "available" : "unavailable, both async rows use workers");
+        }
+
+        u64 expected = 0;
+        for (usize m = METHOD_PREAD; ok && m <= METHOD_WORKERS; ++m) {
+            Method const method = static_cast<Method>(m);
+            drop_cache(fd);
+            u64 sum = 0;
+            f64 const seconds = bench::time([&] { sum = level_load(method, fd, pack); });
+            if (m == METHOD_PREAD) expected = sum;
+            ok = sum != 0 && sum == expected;
+            (void)std::printf("level load  %-8s %8.2f ms\n", NAMES[m], seconds * 1e3);
+        }
+
+        for (usize m = METHOD_PREAD; ok && m <= METHOD_WORKERS; ++m) {
+            drop_cache(fd);
+            FrameTimes const t = stream(static_cast<Method>(m), fd, pack);
+            (void)std::printf(
+                "streaming   %-8s loading per frame mean %7.1f us worst %7.1f us, worst frame %6.2f ms\n",
+                NAMES[m], t.load_mean * 1e6, t.load_worst * 1e6, t.frame_worst * 1e3
+            );
+        }
+    }
+
+    if (fd >= 0) ::close(fd);
+    ::unlink(PACK_PATH);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
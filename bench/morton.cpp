@@ -0,0 +1,170 @@
+#include "../headers/ldata.h"
+#include "../headers/lmorton.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * A uniform grid broad phase over a million randomly placed entities,
+ * before and after the pool is put in Morton order, and the amortised
+ * re-sort's cost per frame.
+ *
+ * L1 data and last level cache misses are counted with perf events where
+ * the kernel allows it, otherwise only wall time is reported.
+ */
+namespace {
+    constexpr usize ENTITIES = 1 << 20;
+    constexpr usize GRID = 256;
+    constexpr f32 CELL = 16.0f;
+    constexpr usize RUNS = 5;
+    constexpr usize KEY_BUDGET = 131072;
+
+    struct Hot { f32 x, y, vx, vy; };
+    struct Cold { char name[48]; };
+
+    using Pool = llib::SplitPool<Hot, Cold>;
+
+    u32 cell_start[GRID * GRID + 1];
+    u32 cell_fill[GRID * GRID];
+    u32 *cell_items;
+
+    auto cell_of(Hot const *const h) -> usize {
+        return static_cast<usize>(h->y / CELL) * GRID + static_cast<usize>(h->x / CELL);
+    }
+
+    __attribute__((noinline)) void build(Pool &pool) {
+        std::memset(cell_start, 0, sizeof(cell_start));
+        for (usize i = 0; i < ENTITIES; ++i) ++cell_start[cell_of(pool.hot_at(i)) + 1];
+        for (usize c = 0; c < GRID * GRID; ++c) cell_start[c + 1] += cell_start[c];
+        std::memcpy(cell_fill, cell_start, sizeof(cell_fill));
+        for (usize i = 0; i < ENTITIES; ++i) cell_items[cell_fill[cell_of(pool.hot_at(i))]++] = static_cast<u32>(i);
+    }
+
+    // Counts pairs closer than 8 units, checking the 3x3 cells around each entity
+    __attribute__((noinline)) auto query(Pool &pool) -> usize {
+        usize pairs = 0;
+        for (usize i = 0; i < ENTITIES; ++i) {
+            Hot const *const h = pool.hot_at(i);
+            i32 const cx = static_cast<i32>(h->x / CELL), cy = static_cast<i32>(h->y / CELL);
+            i32 const x0 = cx > 0 ? cx - 1 : 0, x1 = cx + 1 < static_cast<i32>(GRID) ? cx + 1 : cx;
+            i32 const y0 = cy > 0 ? cy - 1 : 0, y1 = cy + 1 < static_cast<i32>(GRID) ? cy + 1 : cy;
+            for (i32 y = y0; y <= y1; ++y) {
+                for (i32 x = x0; x <= x1; ++x) {
+                    usize const c = static_cast<usize>(y) * GRID + static_cast<usize>(x);
+                    for (u32 k = cell_start[c]; k < cell_start[c + 1]; ++k) {
+                        Hot const *const o = pool.hot_at(cell_items[k]);
+                        f32 const dx = o->x - h->x, dy = o->y - h->y;
+                        pairs += dx * dx + dy * dy < 64.0f;
+                    }
+                }
+            }
+        }
+        return pairs;
+    }
+
+    // A perf event counter for this thread in user space, -1 if unavailable
+    auto open_counter(u32 const type, u64 const config) -> int {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    int l1_misses = -1;
+    int llc_misses = -1;
+
+    void start_counters(void) {
+        for (int const fd : { l1_misses, llc_misses }) {
+            if (fd < 0) continue;
+            ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    auto stop_counter(int const fd) -> u64 {
+        u64 value = 0;
+        if (fd < 0) return 0;
+        ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (::read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+        return value;
+    }
+
+    void run(char const *const label, Pool &pool) {
+        f64 build_time = 0.0, query_time = 0.0;
+        u64 l1 = 0, llc = 0;
+        usize pairs = 0;
+        for (usize r = 0; r < RUNS; ++r) {
+            build_time += bench::time([&] { build(pool); });
+            start_counters();
+            query_time += bench::time([&] { pairs += query(pool); });
+            l1 += stop_counter(l1_misses);
+            llc += stop_counter(llc_misses);
+        }
+        bench::keep(pairs);
+
+        (void)std::printf("%-8s build %6.2f ms  query %8.2f ms", label, build_time * 1e3 / RUNS, query_time * 1e3 / RUNS);
+        if (l1_misses >= 0) (void)std::printf("  L1d misses %llu", static_cast<unsigned long long>(l1 / RUNS));
+        if (llc_misses >= 0) (void)std::printf("  LLC misses %llu", static_cast<unsigned long long>(llc / RUNS));
+        (void)std::printf("\n");
+    }
+}
+
+auto main(void) -> int {
+    Pool pool(ENTITIES / 1024 + 1);
+    cell_items = reinterpret_cast<u32 *>(std::malloc(ENTITIES * sizeof(u32)));
+    if (cell_items == nullptr) return EXIT_FAILURE;
+
+    // Positions from a fixed LCG, so every run places the same world
+    u64 state = 1;
+    auto coord = [&state](void) -> f32 {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<f32>(state >> 40) / static_cast<f32>(1 << 24) * 4095.0f;
+    };
+    for (usize i = 0; i < ENTITIES; ++i) {
+        f32 const x = coord();
+        f32 const y = coord();
+        if (pool.create(Hot{ x, y, 0.0f, 0.0f }, Cold{}).index == llib::SPLIT_NONE) return EXIT_FAILURE;
+    }
+
+    l1_misses = open_counter(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    llc_misses = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    if (l1_misses < 0 && llc_misses < 0)
+        (void)std::printf("perf events unavailable, cache misses not measured\n");
+
+    run("unsorted", pool);
+
+    llib::JobPool jobs(0);
+    llib::MortonSorter<Hot, Cold> sorter(ENTITIES, &jobs);
+    sorter.configure(0.0f, 0.0f, 1.0f);
+    auto position = [](Hot const& h, f32 &x, f32 &y) {
+        x = h.x;
+        y = h.y;
+    };
+
+    usize frames = 0;
+    f64 total = 0.0, worst = 0.0;
+    for (bool done = false; !done; ++frames) {
+        f64 const t = bench::time([&] { done = sorter.step(pool, position, KEY_BUDGET); });
+        total += t;
+        worst = t > worst ? t : worst;
+    }
+    (void)std::printf("re-sort  %zu frames  %.2f ms total  %.2f ms worst frame\n", frames, total * 1e3, worst * 1e3);
+
+    run("sorted", pool);
+
+    if (l1_misses >= 0) ::close(l1_misses);
+    if (llc_misses >= 0) ::close(llc_misses);
+    std::free(cell_items);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+#include "../headers/ldata.h"
+#include "../headers/ljobs.hpp"
+#include "../headers/lradix.hpp"
+#include "bench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Radix sort against `std::sort` for keys and `std::stable_sort` for key and
+ * index pairs, on uniformly random 32 and 64 bit keys from 10 thousand to 10
+ * million items.
+ */
+namespace {
+    constexpr usize SIZES[] = { 10000, 100000, 1000000, 10000000 };
+
+    // Items sorted per size and method, split into as many runs as that takes
+    constexpr usize ITEMS_PER_SIZE = 20000000;
+
+    struct Pair { u64 key; u32 value; };
+
+    auto next(u64 &state) -> u64 {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    template <class K> auto run(usize const n, llib::JobPool *const jobs) -> bool {
+        K *const base = reinterpret_cast<K *>(std::malloc(n * sizeof(K)));
+        K *const keys = reinterpret_cast<K *>(std::malloc(n * sizeof(K)));
+        K *const keys_tmp = reinterpret_cast<K *>(std::malloc(n * sizeof(K)));
+        K *const expected = reinterpret_cast<K *>(std::malloc(n * sizeof(K)));
+        u32 *const values = reinterpret_cast<u32 *>(std::malloc(n * sizeof(u32)));
+        u32 *const values_tmp = reinterpret_cast<u32 *>(std::malloc(n * sizeof(u32)));
+        Pair *const pairs = reinterpret_cast<Pair *>(std::malloc(n * sizeof(Pair)));
+        llib::RadixCounts *const counts = reinterpret_cast<llib::RadixCounts *>(std::malloc(sizeof(llib::RadixCounts)));
+        bool ok = base != nullptr && keys != nullptr && keys_tmp != nullptr && expected != nullptr
+            && values != nullptr && values_tmp != nullptr && pairs != nullptr && counts != nullptr;
+
+        usize const runs = ITEMS_PER_SIZE / n > 1 ? ITEMS_PER_SIZE / n : 1;
+        f64 radix_keys = 0.0, std_keys = 0.0, radix_pairs = 0.0, std_pairs = 0.0;
+
+        u64 state = 0x9e3779b97f4a7c15ull ^ n;
+        for (usize i = 0; ok && i < n; ++i) base[i] = static_cast<K>(next(state));
+
+        for (usize r = 0; ok && r < runs; ++r) {
+            std::memcpy(keys, base, n * sizeof(K));
+            radix_keys += bench::time([&] { llib::radix_sort_keys(keys, keys_tmp, n, sizeof(K) * 8, *counts, jobs); });
+            std::memcpy(expected, base, n * sizeof(K));
+            std_keys += bench::time([&] { std::sort(expected, expected + n); });
+            ok = std::memcmp(keys, expected, n * sizeof(K)) == 0;
+
+            std::memcpy(keys, base, n * sizeof(K));
+            for (usize i = 0; i < n; ++i) {
+                values[i] = static_cast<u32>(i);
+                pairs[i] = Pair{ base[i], static_cast<u32>(i) };
+            }
+            radix_pairs += bench::time([&] {
+                llib::radix_sort_pairs(keys, values, keys_tmp, values_tmp, n, sizeof(K) * 8, *counts, jobs);
+            });
+            std_pairs += bench::time([&] {
+                std::stable_sort(pairs, pairs + n, [](Pair const& a, Pair const& b) { return a.key < b.key; });
+            });
+            for (usize i = 0; ok && i < n; ++i) ok = pairs[i].key == keys[i] && pairs[i].value == values[i];
+        }
+
+        if (ok) {
+            f64 const scale = 1e3 / static_cast<f64>(runs);
+            (void)std::printf(
+                "u%-2zu %9zu  keys  radix %9.3f ms  std::sort   %9.3f ms  %4.1fx\n",
+                sizeof(K) * 8, n, radix_keys * scale, std_keys * scale, std_keys / radix_keys
+            );
+            (void)std::printf(
+                "u%-2zu %9zu  pairs radix %9.3f ms  stable_sort %9.3f ms  %4.1fx\n",
+                sizeof(K) * 8, n, radix_pairs * scale, std_pairs * scale, std_pairs / radix_pairs
+            );
+        }
+
+        std::free(base);
+        std::free(keys);
+        std::free(keys_tmp);
+        std::free(expected);
+        std::free(values);
+        std::free(values_tmp);
+        std::free(pairs);
+        std::free(counts);
+        return ok;
+    }
+}
+
+auto main(void) -> int {
+    llib::JobPool jobs;
+    (void)std::printf("%zu threads\n", jobs.thread_count());
+
+    for (usize const n : SIZES) {
+        if (!run<u32>(n, &jobs) || !run<u64>(n, &jobs)) {
+            (void)std::printf("radix sort disagreed with std::sort at %zu items\n", n);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
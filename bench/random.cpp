@@ -0,0 +1,79 @@
+#include "../headers/ldata.h"
+#include "../headers/lrandom.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+/*
+ * Random number throughput against `std::mt19937`: raw 32 bit values, floats
+ * in [0, 1) and points on the unit disc, the last by rejection sampling for
+ * `std::mt19937`.
+ */
+namespace {
+    constexpr usize VALUES = 1 << 24;
+    constexpr usize RUNS = 3;
+
+    // Fastest of a few runs, in millions of values per second
+    template <class F> auto rate(F &&fn) -> f64 {
+        f64 best = 0.0;
+        for (usize r = 0; r < RUNS; ++r) {
+            f64 const t = bench::time(fn);
+            if (r == 0 || t < best) best = t;
+        }
+        return static_cast<f64>(VALUES) / best * 1e-6;
+    }
+}
+
+auto main(void) -> int {
+    u32 *const u = reinterpret_cast<u32 *>(std::malloc(VALUES * sizeof(u32)));
+    f32 *const x = reinterpret_cast<f32 *>(std::malloc(VALUES * sizeof(f32)));
+    f32 *const y = reinterpret_cast<f32 *>(std::malloc(VALUES * sizeof(f32)));
+    if (u == nullptr || x == nullptr || y == nullptr) return EXIT_FAILURE;
+
+    std::mt19937 mt(1);
+    std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+    llib::Xoshiro256 xoshiro(1);
+    llib::Pcg32 pcg(1);
+    llib::RandomBatch batch(1);
+
+    f64 const mt_u32 = rate([&] { for (usize i = 0; i < VALUES; ++i) u[i] = mt(); });
+    f64 const xoshiro_u32 = rate([&] { for (usize i = 0; i < VALUES; ++i) u[i] = xoshiro.next_u32(); });
+    f64 const pcg_u32 = rate([&] { for (usize i = 0; i < VALUES; ++i) u[i] = pcg.next_u32(); });
+    f64 const batch_u32 = rate([&] { batch.fill_u32(u, VALUES); });
+    bench::keep(u[VALUES - 1]);
+
+    f64 const mt_f32 = rate([&] { for (usize i = 0; i < VALUES; ++i) x[i] = unit(mt); });
+    f64 const batch_f32 = rate([&] { batch.fill_f32(x, VALUES); });
+    bench::keep(x[VALUES - 1]);
+
+    f64 const mt_disc = rate([&] {
+        for (usize i = 0; i < VALUES; ++i) {
+            f32 px, py;
+            do {
+                px = unit(mt) * 2.0f - 1.0f;
+                py = unit(mt) * 2.0f - 1.0f;
+            } while (px * px + py * py > 1.0f);
+            x[i] = px;
+            y[i] = py;
+        }
+    });
+    f64 const batch_disc = rate([&] { batch.fill_disc(x, y, VALUES); });
+    bench::keep(x[VALUES - 1]);
+    bench::keep(y[VALUES - 1]);
+
+#if defined(LRANDOM_AVX2)
+    (void)std::printf("batch uses AVX2\n");
+#else
+    (void)std::printf("batch uses the scalar path\n");
+#endif
+    (void)std::printf("M values/s     mt19937  xoshiro   pcg32    batch\n");
+    (void)std::printf("u32           %8.0f %8.0f %8.0f %8.0f  %.1fx\n", mt_u32, xoshiro_u32, pcg_u32, batch_u32, batch_u32 / mt_u32);
+    (void)std::printf("f32 [0, 1)    %8.0f %8s %8s %8.0f  %.1fx\n", mt_f32, "", "", batch_f32, batch_f32 / mt_f32);
+    (void)std::printf("disc points   %8.0f %8s %8s %8.0f  %.1fx\n", mt_disc, "", "", batch_disc, batch_disc / mt_disc);
+
+    std::free(u);
+    std::free(x);
+    std::free(y);
+    return EXIT_SUCCESS;
+}
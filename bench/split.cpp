@@ -0,0 +1,84 @@
+#include "../headers/ldata.h"
+#include "../headers/lsplit.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * Movement and collision passes over two million entities, stored as one
+ * 108 byte record each and split into a 16 byte hot part and a cold part.
+ */
+namespace {
+    constexpr usize ENTITIES = 2000000;
+    constexpr usize FRAMES = 20;
+    constexpr f32 DT = 0.016f;
+
+    struct Hot { f32 x, y, vx, vy; };
+    struct Cold { char name[48]; u32 loot[8]; f32 spawn_x, spawn_y; u32 flags; };
+
+    // Every field in one record, the layout splitting replaces
+    struct Record { f32 x, y, vx, vy; char name[48]; u32 loot[8]; f32 spawn_x, spawn_y; u32 flags; };
+
+    // Counts entities within 50 units of (`ox`, 100)
+    template <class T> __attribute__((noinline)) auto collide(T const *const items, usize const n, f32 const ox) -> usize {
+        usize hits = 0;
+        for (usize i = 0; i < n; ++i) {
+            f32 const dx = items[i].x - ox, dy = items[i].y - 100.0f;
+            hits += dx * dx + dy * dy < 2500.0f;
+        }
+        return hits;
+    }
+
+    template <class T> __attribute__((noinline)) void move(T *const items, usize const n) {
+        for (usize i = 0; i < n; ++i) {
+            items[i].x += items[i].vx * DT;
+            items[i].y += items[i].vy * DT;
+        }
+    }
+}
+
+auto main(void) -> int {
+    llib::SplitPool<Hot, Cold> split(ENTITIES / 1024 + 2);
+    Record *const records = reinterpret_cast<Record *>(std::calloc(ENTITIES, sizeof(Record)));
+    if (records == nullptr) return EXIT_FAILURE;
+
+    for (usize i = 0; i < ENTITIES; ++i) {
+        f32 const x = static_cast<f32>(i % 4096), y = static_cast<f32>(i / 4096);
+        if (split.create(Hot{ x, y, 1.0f, 1.0f }, Cold{}).index == llib::SPLIT_NONE) return EXIT_FAILURE;
+        records[i].x = x;
+        records[i].y = y;
+        records[i].vx = 1.0f;
+        records[i].vy = 1.0f;
+    }
+
+    f64 const move_aos = bench::time([&] {
+        for (usize f = 0; f < FRAMES; ++f) move(records, ENTITIES);
+    });
+    f64 const move_split = bench::time([&] {
+        for (usize f = 0; f < FRAMES; ++f) split.each_hot([](usize const n, Hot *const h) { move(h, n); });
+    });
+
+    usize hits_aos = 0, hits_split = 0;
+    f64 const collide_aos = bench::time([&] {
+        for (usize f = 0; f < FRAMES; ++f) hits_aos += collide(records, ENTITIES, 100.0f + static_cast<f32>(f));
+    });
+    f64 const collide_split = bench::time([&] {
+        for (usize f = 0; f < FRAMES; ++f) {
+            f32 const ox = 100.0f + static_cast<f32>(f);
+            split.each_hot([&](usize const n, Hot *const h) { hits_split += collide(h, n, ox); });
+        }
+    });
+    if (hits_aos != hits_split) return EXIT_FAILURE;
+
+    (void)std::printf(
+        "move     records %6.2f ms  split %6.2f ms  %.1fx\n",
+        move_aos * 1e3 / FRAMES, move_split * 1e3 / FRAMES, move_aos / move_split
+    );
+    (void)std::printf(
+        "collide  records %6.2f ms  split %6.2f ms  %.1fx\n",
+        collide_aos * 1e3 / FRAMES, collide_split * 1e3 / FRAMES, collide_aos / collide_split
+    );
+
+    std::free(records);
+    return EXIT_SUCCESS;
+}
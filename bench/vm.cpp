@@ -0,0 +1,111 @@
+#include "../headers/ldata.h"
+#include "../src/vm.hpp"
+#include "bench.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * Instructions per second for thousands of scripts running a spiral bullet
+ * pattern, against the same pattern written as native C++.
+ */
+namespace {
+    constexpr usize SCRIPTS = 5000;
+    constexpr usize TICKS = 200;
+    constexpr f32 DT = 0.016f;
+
+    /*
+     * Each frame, fire 8 bullets an eighth of a turn apart, then turn the
+     * spiral a little and wait a frame.
+     *
+     * r0 angle, r1 step, r2 speed, r3 shot, r4 shots, r5 one
+     */
+    f32 const constants[] = { 0.0f, 0.785398f, 120.0f, 8.0f, 1.0f, 0.05f };
+
+    u32 const code[] = {
+        game::vm_encode_wide(game::VM_LOADK, 0, 0),
+        game::vm_encode_wide(game::VM_LOADK, 1, 1),
+        game::vm_encode_wide(game::VM_LOADK, 2, 2),
+        game::vm_encode_wide(game::VM_LOADK, 4, 3),
+        game::vm_encode_wide(game::VM_LOADK, 5, 4),
+        // frame:
+        game::vm_encode_wide(game::VM_LOADK, 3, 0),
+        // shot:
+        game::vm_encode(game::VM_FIRE, 0, 2, 0),
+        game::vm_encode(game::VM_ADD, 0, 0, 1),
+        game::vm_encode(game::VM_ADD, 3, 3, 5),
+        game::vm_encode(game::VM_JLT, 3, 4, static_cast<u8>(static_cast<i8>(-4))),
+        game::vm_encode(game::VM_ADDK, 0, 0, 5),
+        game::vm_encode_wide(game::VM_WAITK, 0, 1),
+        game::vm_encode_wide(game::VM_JMP, 0, 5)
+    };
+
+    // The same pattern's state, written by hand
+    struct Spiral {
+        f32 x;
+        f32 y;
+        f32 angle;
+    };
+
+    Spiral spirals[SCRIPTS];
+
+    void native_tick(game::ProjectilePool &pool) {
+        for (Spiral &s : spirals) {
+            for (usize shot = 0; shot < 8; ++shot) {
+                usize reserved;
+                usize const b = pool.reserve(1, reserved);
+                if (reserved == 1) {
+                    pool.x[b] = s.x;
+                    pool.y[b] = s.y;
+                    pool.vx[b] = std::cos(s.angle) * 120.0f;
+                    pool.vy[b] = std::sin(s.angle) * 120.0f;
+                    pool.damage[b] = 1.0f;
+                    pool.homing[b] = 0.0f;
+                    pool.life[b] = 5.0f;
+                    pool.flags[b] = game::PROJECTILE_NONE;
+                    pool.bounces[b] = 0;
+                }
+                s.angle += 0.785398f;
+            }
+            s.angle += 0.05f;
+        }
+    }
+}
+
+auto main(void) -> int {
+    game::VmProgram const program = { code, sizeof(code) / sizeof(code[0]), constants, sizeof(constants) / sizeof(constants[0]) };
+    if (!game::vm_validate(program)) {
+        (void)std::fprintf(stderr, "spiral program failed to validate\n");
+        return EXIT_FAILURE;
+    }
+
+    game::VmMachine machine(SCRIPTS);
+    game::ProjectilePool pool(1 << 20);
+    for (usize i = 0; i < SCRIPTS; ++i)
+        if (machine.spawn(program, static_cast<f32>(i), static_cast<f32>(i)) == nullptr) return EXIT_FAILURE;
+
+    u64 executed = 0;
+    f64 const vm = bench::time([&] {
+        for (usize t = 0; t < TICKS; ++t) {
+            pool.clear();
+            executed += machine.step(pool, DT);
+        }
+    });
+    bench::keep(pool.vx[0]);
+
+    for (usize i = 0; i < SCRIPTS; ++i) spirals[i] = { static_cast<f32>(i), static_cast<f32>(i), 0.0f };
+    f64 const native = bench::time([&] {
+        for (usize t = 0; t < TICKS; ++t) {
+            pool.clear();
+            native_tick(pool);
+        }
+    });
+    bench::keep(pool.vx[0]);
+
+    (void)std::printf(
+        "vm      %7.1f M instructions/s  %6.3f ms/tick for %zu scripts\n",
+        static_cast<f64>(executed) / vm / 1e6, vm * 1e3 / TICKS, SCRIPTS
+    );
+    (void)std::printf("native  %23s  %6.3f ms/tick, vm takes %.2fx as long\n", "", native * 1e3 / TICKS, vm / native);
+    return EXIT_SUCCESS;
+}
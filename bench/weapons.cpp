@@ -0,0 +1,84 @@
+#include "../headers/ldata.h"
+#include "../src/weapon.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * Bullets generated per second by compiled weapons, from a single shot up to
+ * a stacked volley of 512, firing into a projectile pool.
+ */
+namespace {
+    constexpr u32 VOLLEYS = 200000;
+
+    struct Case {
+        char const *name;
+        game::WeaponModifier const *modifiers;
+        usize modifier_count;
+    };
+
+    game::WeaponModifier const single[] = {
+        { game::MOD_DAMAGE, 0, 2.0f }
+    };
+
+    game::WeaponModifier const shotgun[] = {
+        { game::MOD_SPREAD, 8, 1.0f },
+        { game::MOD_SPEED, 0, 1.5f }
+    };
+
+    game::WeaponModifier const stacked[] = {
+        { game::MOD_SPREAD, 8, 1.0f },
+        { game::MOD_SPLIT, 4, 3.0f },
+        { game::MOD_SPEED, 0, 1.5f },
+        { game::MOD_RAMP, 4, 1.1f },
+        { game::MOD_SPIN, 0, 0.1f },
+        { game::MOD_HOMING, 0, 2.0f },
+        { game::MOD_BOUNCE, 2, 0.0f }
+    };
+
+    game::WeaponModifier const storm[] = {
+        { game::MOD_SPREAD, 16, 6.0f },
+        { game::MOD_SPLIT, 4, 2.0f },
+        { game::MOD_RAMP, 8, 1.05f },
+        { game::MOD_SPIN, 0, 0.03f }
+    };
+
+    Case const cases[] = {
+        { "single", single, 1 },
+        { "shotgun", shotgun, 2 },
+        { "stacked", stacked, 7 },
+        { "storm", storm, 4 }
+    };
+
+    game::WeaponProgram program;
+    game::WeaponInterpreter interpreter;
+}
+
+auto main(void) -> int {
+    game::ProjectilePool pool(1 << 20);
+    if (pool.capacity() == 0) return EXIT_FAILURE;
+
+    for (Case const& c : cases) {
+        game::WeaponConfig const config = { 300.0f, 1.0f, 2.0f, c.modifiers, c.modifier_count };
+        if (!game::compile_weapon(config, program)) {
+            (void)std::fprintf(stderr, "%s: failed to compile\n", c.name);
+            return EXIT_FAILURE;
+        }
+
+        usize total = 0;
+        f64 const elapsed = bench::time([&] {
+            for (u32 v = 0; v < VOLLEYS; ++v) {
+                if (pool.count() + program.volley_size > pool.capacity()) pool.clear();
+                total += interpreter.fire(program, pool, 100.0f, 100.0f, 0.6f, 0.8f, v);
+            }
+        });
+        bench::keep(pool.vx[0]);
+
+        (void)std::printf(
+            "%-8s volley %4u  %3u ops  %7.1f M bullets/s\n",
+            c.name, program.volley_size, program.op_count, static_cast<f64>(total) / elapsed / 1e6
+        );
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#ifndef LARENA_HPP
+#define LARENA_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstdio>
+#include "ldata.h"
+
+namespace llib {
+    /*
+     * The frame arena, a bump allocator for memory that only lives until the
+     * end of a frame.
+     *
+     * Like the pool allocator, memory is taken from the OS in blocks up to a
+     * maximum number, but allocations can be any size and are never freed one
+     * by one. `reset` rewinds to the first block, keeping every block for
+     * reuse, so a warmed up arena never touches the heap again.
+     */
+    struct FrameArena {
+        FrameArena(void) = delete;
+        FrameArena(FrameArena const&) = delete;
+        FrameArena operator=(FrameArena&) = delete;
+
+        /*
+         * - block_size is the size of each block in bytes, and so the largest
+         *   single allocation
+         * - max_blocks is the number of blocks available to the arena
+         */
+        FrameArena(usize const block_size, usize const max_blocks) {
+            m_block_size = block_size;
+            m_max_blocks = max_blocks;
+            m_block_count = 0;
+            m_current_block = 0;
+            m_offset = 0;
+            m_blocks = reinterpret_cast<u8 **>(std::calloc(max_blocks, sizeof(ptr)));
+        }
+
+        ~FrameArena(void) {
+            for (usize i = 0; i < m_block_count; ++i) std::free(m_blocks[i]);
+            std::free(m_blocks);
+        }
+
+        /*
+         * Returns `size` bytes aligned to `align`, a power of two.
+         *
+         * Returns `nullptr` if the size is larger than a block or the arena
+         * has run out of blocks.
+         */
+        auto allocate(usize const size, usize const align = alignof(std::max_align_t)) -> ptr {
+            if (size > m_block_size || m_blocks == nullptr) return nullptr;
+
+            while (m_current_block < m_max_blocks) {
+                if (m_current_block == m_block_count && !_allocate_block()) return nullptr;
+
+                // Align the address rather than the offset, so alignments
+                // stricter than `malloc`'s still hold.
+                uintptr_t const base = reinterpret_cast<uintptr_t>(m_blocks[m_current_block]);
+                usize const start = ((base + m_offset + align - 1) & ~(align - 1)) - base;
+                if (start + size <= m_block_size) {
+                    m_offset = start + size;
+                    return m_blocks[m_current_block] + start;
+                }
+
+                // Doesn't fit in what's left, move on to the next block.
+                ++m_current_block;
+                m_offset = 0;
+            }
+
+            return nullptr;
+        }
+
+        // Returns an uninitialised array of `n` items of type T
+        template <class T> auto allocate_array(usize const n) -> T* {
+            return reinterpret_cast<T *>(allocate(n * sizeof(T), alignof(T)));
+        }
+
+        /*
+         * Releases every allocation at once, keeping the blocks.
+         */
+        void reset(void) {
+            m_current_block = 0;
+            m_offset = 0;
+        }
+
+        // Bytes handed out since the last reset, ignoring padding
+        auto used(void) -> usize { return m_current_block * m_block_size + m_offset; }
+
+        // Size of each block in bytes
+        auto block_size(void) -> usize { return m_block_size; }
+
+    private:
+        auto _allocate_block(void) -> bool {
+            u8 *const block = reinterpret_cast<u8 *>(std::malloc(m_block_size));
+            if (block == nullptr) return false;
+            m_blocks[m_block_count++] = block;
+            return true;
+        }
+
+        // Size of each block in bytes
+        usize m_block_size;
+
+        // Max number of blocks for the arena
+        usize m_max_blocks;
+
+        // Blocks taken from the OS so far
+        usize m_block_count;
+
+        // Block being bumped and the offset of its free space
+        usize m_current_block;
+        usize m_offset;
+
+        // The block pointers in a dynamically allocated array
+        u8 **m_blocks;
+    };
+}
+
+#endif
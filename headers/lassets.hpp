@@ -0,0 +1,280 @@
+#ifndef LASSETS_HPP
+#define LASSETS_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ldata.h"
+#include "lhash.hpp"
+#include "lradix.hpp"
+
+namespace llib {
+    constexpr u32 LASSET_MAGIC = 0x4b41504c; // "LPAK"
+    constexpr u32 LASSET_VERSION = 1;
+
+    // Every payload starts on a multiple of this many bytes, a cache line
+    constexpr usize LASSET_ALIGN = 64;
+
+    // The start of an asset pack
+    struct AssetPackHeader {
+        u32 magic;
+        u32 version;
+        u32 count;
+        u32 reserved;
+        // Where the index starts, right after the header
+        u64 index_offset;
+        u64 file_size;
+    };
+
+    // One asset in the index, which is sorted by hash
+    struct AssetEntry {
+        u64 hash;
+        u64 offset;
+        u64 size;
+        // Left to the game, the pack only stores it
+        u32 type;
+        u32 reserved;
+    };
+
+    // An asset's payload inside the mapping, `data` is `nullptr` if missing
+    struct AssetView {
+        void const *data;
+        usize size;
+        u32 type;
+    };
+
+    /*
+     * The asset pack, a read-only memory-mapped archive of assets looked up
+     * by the hash of their name.
+     *
+     * Opening a pack maps the whole file but only reads the header, and a
+     * lookup binary searches the sorted index, so a startup touches just the
+     * index pages it searches and an asset's payload is paged in the first
+     * time it's used. Payloads are aligned to `LASSET_ALIGN`, so plain data
+     * written by the builder can be read in place through `as`.
+     */
+    struct AssetPack {
+        AssetPack(void) = delete;
+        AssetPack(AssetPack const&) = delete;
+        AssetPack operator=(AssetPack&) = delete;
+
+        /*
+         * Maps the pack at `path`. Check `valid()` before use.
+         */
+        AssetPack(char const *const path) {
+            m_map = nullptr;
+            m_size = 0;
+            m_index = nullptr;
+            m_count = 0;
+
+            int const fd = ::open(path, O_RDONLY);
+            if (fd < 0) return;
+
+            struct stat info;
+            if (::fstat(fd, &info) == 0 && static_cast<usize>(info.st_size) >= sizeof(AssetPackHeader)) {
+                ptr const map = ::mmap(nullptr, static_cast<usize>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map != MAP_FAILED) {
+                    m_map = reinterpret_cast<u8 const *>(map);
+                    m_size = static_cast<usize>(info.st_size);
+                }
+            }
+            // The mapping keeps the file open
+            ::close(fd);
+            if (m_map == nullptr) return;
+
+            AssetPackHeader const& h = *reinterpret_cast<AssetPackHeader const *>(m_map);
+            bool const ok = h.magic == LASSET_MAGIC && h.version == LASSET_VERSION && h.file_size == m_size
+                && h.index_offset % alignof(AssetEntry) == 0
+                && h.index_offset <= m_size && (m_size - h.index_offset) / sizeof(AssetEntry) >= h.count;
+            if (!ok) {
+                ::munmap(const_cast<u8 *>(m_map), m_size);
+                m_map = nullptr;
+                return;
+            }
+
+            m_index = reinterpret_cast<AssetEntry const *>(m_map + h.index_offset);
+            m_count = h.count;
+            // Payloads are read wherever assets are used, not in order
+            ::madvise(const_cast<u8 *>(m_map), m_size, MADV_RANDOM);
+        }
+
+        ~AssetPack(void) {
+            if (m_map != nullptr) ::munmap(const_cast<u8 *>(m_map), m_size);
+        }
+
+        // Whether the pack opened and its header checked out
+        auto valid(void) -> bool { return m_map != nullptr; }
+
+        // Number of assets in the pack
+        auto count(void) -> usize { return m_count; }
+
+        // The `i`th index entry, in hash order
+        auto entry(usize const i) -> AssetEntry const& { return m_index[i]; }
+
+        /*
+         * Returns the index entry for a name hash, or `nullptr` if the pack
+         * has no such asset.
+         */
+        auto find(u64 const hash) -> AssetEntry const* {
+            usize lo = 0, hi = m_count;
+            while (lo < hi) {
+                usize const mid = lo + (hi - lo) / 2;
+                if (m_index[mid].hash < hash) lo = mid + 1;
+                else hi = mid;
+            }
+            return lo < m_count && m_index[lo].hash == hash ? &m_index[lo] : nullptr;
+        }
+
+        /*
+         * Returns an asset's payload, with a `nullptr` `data` if it's missing
+         * or its entry points outside the file.
+         */
+        auto get(u64 const hash) -> AssetView {
+            AssetEntry const *const e = find(hash);
+            if (e == nullptr || e->offset > m_size || e->size > m_size - e->offset) return { nullptr, 0, 0 };
+            return { m_map + e->offset, static_cast<usize>(e->size), e->type };
+        }
+
+        auto get(char const *const name) -> AssetView { return get(hash_name(name)); }
+
+        /*
+         * Returns an asset's payload as a `T`, or `nullptr` if it's missing
+         * or too small to hold one.
+         */
+        template <class T> auto as(u64 const hash) -> T const* {
+            AssetView const view = get(hash);
+            return view.size >= sizeof(T) ? reinterpret_cast<T const *>(view.data) : nullptr;
+        }
+
+    private:
+        u8 const *m_map;
+        usize m_size;
+        AssetEntry const *m_index;
+        usize m_count;
+    };
+
+    /*
+     * Collects assets and writes them out as an asset pack.
+     *
+     * Added payloads are copied, so callers can free theirs straight away.
+     * Writing sorts the index by hash and fails if two names share a hash,
+     * so lookups in the finished pack never need the names.
+     */
+    struct AssetPackBuilder {
+        AssetPackBuilder(void) = delete;
+        AssetPackBuilder(AssetPackBuilder const&) = delete;
+        AssetPackBuilder operator=(AssetPackBuilder&) = delete;
+
+        /*
+         * - capacity is the most assets the pack can hold
+         */
+        AssetPackBuilder(usize const capacity) {
+            m_capacity = capacity;
+            m_count = 0;
+            m_entries = reinterpret_cast<AssetEntry *>(std::malloc(capacity * sizeof(AssetEntry)));
+            m_payloads = reinterpret_cast<u8 **>(std::calloc(capacity, sizeof(ptr)));
+        }
+
+        ~AssetPackBuilder(void) {
+            for (usize i = 0; i < m_count; ++i) std::free(m_payloads[i]);
+            std::free(m_payloads);
+            std::free(m_entries);
+        }
+
+        /*
+         * Adds an asset under `name`. Returns false if the builder is full.
+         */
+        auto add(char const *const name, u32 const type, void const *const data, usize const size) -> bool {
+            if (m_count == m_capacity) return false;
+            u8 *const copy = reinterpret_cast<u8 *>(std::malloc(size > 0 ? size : 1));
+            if (copy == nullptr) return false;
+            std::memcpy(copy, data, size);
+
+            m_entries[m_count] = { hash_name(name), 0, size, type, 0 };
+            m_payloads[m_count] = copy;
+            ++m_count;
+            return true;
+        }
+
+        /*
+         * Writes the pack to `path`: the header, the sorted index, then every
+         * payload on an `LASSET_ALIGN` boundary. Returns false if two names
+         * collide or the file can't be written.
+         */
+        auto write(char const *const path) -> bool {
+            usize const n = m_count;
+            u64 *const keys = reinterpret_cast<u64 *>(std::malloc((n > 0 ? n : 1) * sizeof(u64) * 2));
+            u32 *const order = reinterpret_cast<u32 *>(std::malloc((n > 0 ? n : 1) * sizeof(u32) * 2));
+            AssetEntry *const index = reinterpret_cast<AssetEntry *>(std::malloc((n > 0 ? n : 1) * sizeof(AssetEntry)));
+            RadixCounts *const counts = reinterpret_cast<RadixCounts *>(std::malloc(sizeof(RadixCounts)));
+            bool ok = keys != nullptr && order != nullptr && index != nullptr && counts != nullptr;
+
+            if (ok) {
+                for (usize i = 0; i < n; ++i) {
+                    keys[i] = m_entries[i].hash;
+                    order[i] = static_cast<u32>(i);
+                }
+                radix_sort_pairs<u64>(keys, order, keys + n, order + n, n, 64, *counts, nullptr);
+                for (usize i = 1; i < n; ++i) ok = ok && keys[i] != keys[i - 1];
+            }
+
+            std::FILE *const file = ok ? std::fopen(path, "wb") : nullptr;
+            if (file != nullptr) {
+                u64 const index_offset = _align(sizeof(AssetPackHeader));
+                u64 offset = _align(index_offset + n * sizeof(AssetEntry));
+                for (usize i = 0; i < n; ++i) {
+                    index[i] = m_entries[order[i]];
+                    index[i].offset = offset;
+                    offset = _align(offset + index[i].size);
+                }
+
+                AssetPackHeader const header = { LASSET_MAGIC, LASSET_VERSION, static_cast<u32>(n), 0, index_offset, offset };
+                ok = _put(file, &header, sizeof(header), 0)
+                    && _put(file, index, n * sizeof(AssetEntry), index_offset);
+                for (usize i = 0; ok && i < n; ++i)
+                    ok = _put(file, m_payloads[order[i]], static_cast<usize>(index[i].size), index[i].offset);
+                // Pad the last payload out to the size in the header
+                ok = ok && _pad(file, offset);
+                ok = std::fclose(file) == 0 && ok;
+            } else {
+                ok = false;
+            }
+
+            std::free(keys);
+            std::free(order);
+            std::free(index);
+            std::free(counts);
+            return ok;
+        }
+
+        // Number of assets added
+        auto count(void) -> usize { return m_count; }
+
+    private:
+        static auto _align(u64 const offset) -> u64 { return (offset + LASSET_ALIGN - 1) / LASSET_ALIGN * LASSET_ALIGN; }
+
+        // Pads with zeros up to `offset`, then writes `size` bytes
+        static auto _put(std::FILE *const file, void const *const data, usize const size, u64 const offset) -> bool {
+            return _pad(file, offset) && std::fwrite(data, 1, size, file) == size;
+        }
+
+        static auto _pad(std::FILE *const file, u64 const offset) -> bool {
+            static u8 const zeros[LASSET_ALIGN] = {};
+            long const at = std::ftell(file);
+            if (at < 0 || static_cast<u64>(at) > offset) return false;
+            usize const gap = static_cast<usize>(offset - static_cast<u64>(at));
+            return std::fwrite(zeros, 1, gap, file) == gap;
+        }
+
+        usize m_capacity;
+        usize m_count;
+        AssetEntry *m_entries;
+        u8 **m_payloads;
+    };
+}
+
+#endif
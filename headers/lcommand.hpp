@@ -0,0 +1,307 @@
+#ifndef LCOMMAND_HPP
+#define LCOMMAND_HPP
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "ldata.h"
+#include "larena.hpp"
+#include "lpool.hpp"
+
+namespace llib {
+    // Kinds of deferred change, in the order they are applied
+    enum CommandKind : u8 {
+        COMMAND_SET,
+        COMMAND_DESTROY,
+        COMMAND_SPAWN
+    };
+
+    /*
+     * A recorded change, followed in memory by `size` bytes of payload for
+     * sets and spawns.
+     */
+    struct Command {
+        Command *next;
+
+        // Object being changed or destroyed, unused for spawns
+        ptr target;
+
+        // Order the command was recorded in, to keep sets to one object in order
+        u64 sequence;
+
+        // Payload size and, for sets, where in the object it is written
+        u32 size;
+        u32 offset;
+
+        u16 pool;
+        CommandKind kind;
+    };
+
+    /*
+     * A pool commands can spawn into and destroy from, with the pool's type
+     * erased so pools of different object types can share one queue.
+     */
+    struct CommandTarget {
+        ptr pool;
+        auto (*allocate)(ptr pool) -> ptr;
+        void (*deallocate)(ptr pool, ptr object);
+        usize object_size;
+    };
+
+    // Wraps a pool allocator as a command target
+    template <class T> auto command_target(PoolAllocator<T> &pool) -> CommandTarget {
+        return CommandTarget{
+            &pool,
+            [](ptr p) -> ptr { return reinterpret_cast<PoolAllocator<T> *>(p)->allocate(); },
+            [](ptr p, ptr object) { reinterpret_cast<PoolAllocator<T> *>(p)->deallocate(object); },
+            sizeof(T)
+        };
+    }
+
+    /*
+     * A command buffer, owned by a single thread during a parallel update.
+     *
+     * Rather than touching shared pools, systems record what they want to
+     * spawn, destroy or change. Commands and their payloads are bump allocated
+     * from the buffer's own frame arena, so recording never locks and never
+     * touches the heap once warmed up.
+     */
+    struct CommandBuffer {
+        CommandBuffer(void) = delete;
+        CommandBuffer(CommandBuffer const&) = delete;
+        CommandBuffer operator=(CommandBuffer&) = delete;
+
+        /*
+         * - block_size and max_blocks size the buffer's arena
+         */
+        CommandBuffer(usize const block_size, usize const max_blocks):
+            m_arena(block_size, max_blocks)
+        {
+            m_first = nullptr;
+            m_last = nullptr;
+            m_count = 0;
+        }
+
+        /*
+         * Records a spawn of a new object in `pool`, initialised from `size`
+         * bytes of `data`.
+         *
+         * Returns false if the buffer is out of space.
+         */
+        auto spawn(u16 const pool, void const *const data, u32 const size) -> bool {
+            Command *const command = _record(COMMAND_SPAWN, pool, nullptr, 0, size);
+            if (command == nullptr) return false;
+            std::memcpy(command + 1, data, size);
+            return true;
+        }
+
+        /*
+         * Records destroying `object`, which lives in `pool`.
+         */
+        auto destroy(u16 const pool, ptr const object) -> bool {
+            return _record(COMMAND_DESTROY, pool, object, 0, 0) != nullptr;
+        }
+
+        /*
+         * Records writing `size` bytes of `data` at `offset` into `object`.
+         */
+        auto set(u16 const pool, ptr const object, u32 const offset, void const *const data, u32 const size) -> bool {
+            Command *const command = _record(COMMAND_SET, pool, object, offset, size);
+            if (command == nullptr) return false;
+            std::memcpy(command + 1, data, size);
+            return true;
+        }
+
+        // Records writing a single field of an object
+        template <class T, class F> auto set_field(u16 const pool, T *const object, F T::*field, F const& value) -> bool {
+            u32 const offset = static_cast<u32>(
+                reinterpret_cast<u8 const *>(&(object->*field)) - reinterpret_cast<u8 const *>(object)
+            );
+            return set(pool, object, offset, &value, sizeof(F));
+        }
+
+        /*
+         * Forgets every recorded command.
+         */
+        void clear(void) {
+            m_arena.reset();
+            m_first = nullptr;
+            m_last = nullptr;
+            m_count = 0;
+        }
+
+        // Number of recorded commands
+        auto count(void) -> usize { return m_count; }
+
+        // First recorded command, following `next` to the rest
+        auto first(void) -> Command* { return m_first; }
+
+    private:
+        auto _record(
+            CommandKind const kind, u16 const pool, ptr const target,
+            u32 const offset, u32 const size
+        ) -> Command* {
+            Command *const command = reinterpret_cast<Command *>(
+                m_arena.allocate(sizeof(Command) + size, alignof(Command))
+            );
+            if (command == nullptr) return nullptr;
+
+            command->next = nullptr;
+            command->target = target;
+            command->sequence = m_count;
+            command->size = size;
+            command->offset = offset;
+            command->pool = pool;
+            command->kind = kind;
+
+            if (m_last != nullptr) m_last->next = command;
+            else m_first = command;
+            m_last = command;
+            ++m_count;
+            return command;
+        }
+
+        FrameArena m_arena;
+        Command *m_first;
+        Command *m_last;
+        usize m_count;
+    };
+
+    // What applying a set of command buffers did
+    struct CommandStats {
+        usize set;
+        usize destroyed;
+        usize spawned;
+        // Spawns dropped because their pool was full or unknown
+        usize failed;
+        // Commands left in their buffers because there was no memory to sort them
+        usize skipped;
+    };
+
+    /*
+     * The sync point where every thread's command buffer is merged and applied.
+     *
+     * All commands are gathered and sorted by kind, pool and object address, so
+     * each pool is written by one thread in address order. Destroys of the same
+     * object from several threads collapse into one, and are freed from the
+     * highest address down so the pool hands chunks back out in address order
+     * to the spawns that follow.
+     *
+     * The sort is what makes applying safe, so commands are never applied
+     * unsorted. When the sort doesn't fit in the scratch arena it falls back
+     * to the heap, and if that fails too nothing is applied.
+     */
+    struct CommandQueue {
+        CommandQueue(void) = delete;
+        CommandQueue(CommandQueue const&) = delete;
+        CommandQueue operator=(CommandQueue&) = delete;
+
+        /*
+         * - block_size and max_blocks size the scratch arena used for sorting
+         */
+        CommandQueue(usize const block_size, usize const max_blocks):
+            m_scratch(block_size, max_blocks) {}
+
+        /*
+         * Applies and then clears every command in `buffers`. Spawned objects
+         * are passed to `on_spawn(u16 pool, ptr object)`.
+         *
+         * `targets` is indexed by the pool numbers used when recording. If
+         * there's no memory to sort the commands, none are applied, the
+         * buffers are left as they were and `skipped` counts the commands.
+         */
+        template <class F> auto apply(
+            CommandBuffer *const *const buffers, usize const buffer_count,
+            CommandTarget const *const targets, usize const target_count,
+            F &&on_spawn
+        ) -> CommandStats {
+            CommandStats stats{};
+
+            usize total = 0;
+            for (usize b = 0; b < buffer_count; ++b) total += buffers[b]->count();
+
+            m_scratch.reset();
+            Command **order = m_scratch.allocate_array<Command *>(total);
+            // Too many commands for the scratch arena, sort on the heap instead
+            bool const heap = order == nullptr && total > 0;
+            if (heap) order = reinterpret_cast<Command **>(std::malloc(total * sizeof(Command *)));
+            if (order == nullptr && total > 0) {
+                stats.skipped = total;
+                return stats;
+            }
+
+            usize n = 0;
+            for (usize b = 0; b < buffer_count; ++b) {
+                for (Command *c = buffers[b]->first(); c != nullptr; c = c->next) {
+                    c->sequence |= static_cast<u64>(b) << 40;
+                    order[n++] = c;
+                }
+            }
+
+            std::sort(order, order + n, [](Command const *const a, Command const *const b) {
+                if (a->kind != b->kind) return a->kind < b->kind;
+                if (a->pool != b->pool) return a->pool < b->pool;
+                if (a->target != b->target) {
+                    // Destroys run from the top of each pool down.
+                    return a->kind == COMMAND_DESTROY ? a->target > b->target : a->target < b->target;
+                }
+                return a->sequence < b->sequence;
+            });
+
+            for (usize i = 0; i < n; ++i) {
+                bool const repeat = i > 0
+                    && order[i]->kind == COMMAND_DESTROY
+                    && order[i - 1]->kind == COMMAND_DESTROY
+                    && order[i]->target == order[i - 1]->target;
+                if (!repeat) _apply(order[i], targets, target_count, stats, on_spawn);
+            }
+
+            if (heap) std::free(order);
+            for (usize b = 0; b < buffer_count; ++b) buffers[b]->clear();
+            return stats;
+        }
+
+        // Applies every command without being told about spawns
+        auto apply(
+            CommandBuffer *const *const buffers, usize const buffer_count,
+            CommandTarget const *const targets, usize const target_count
+        ) -> CommandStats {
+            return apply(buffers, buffer_count, targets, target_count, [](u16, ptr) {});
+        }
+
+    private:
+        template <class F> static void _apply(
+            Command *const c,
+            CommandTarget const *const targets, usize const target_count,
+            CommandStats &stats, F &on_spawn
+        ) {
+            switch (c->kind) {
+            case COMMAND_SET:
+                std::memcpy(reinterpret_cast<u8 *>(c->target) + c->offset, c + 1, c->size);
+                ++stats.set;
+                break;
+            case COMMAND_DESTROY:
+                if (c->pool >= target_count) break;
+                targets[c->pool].deallocate(targets[c->pool].pool, c->target);
+                ++stats.destroyed;
+                break;
+            case COMMAND_SPAWN: {
+                ptr const object = c->pool < target_count
+                    ? targets[c->pool].allocate(targets[c->pool].pool) : nullptr;
+                if (object == nullptr) {
+                    ++stats.failed;
+                    break;
+                }
+                usize const object_size = targets[c->pool].object_size;
+                std::memcpy(object, c + 1, c->size < object_size ? c->size : object_size);
+                on_spawn(c->pool, object);
+                ++stats.spawned;
+            } break;
+            }
+        }
+
+        FrameArena m_scratch;
+    };
+}
+
+#endif
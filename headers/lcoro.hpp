@@ -0,0 +1,311 @@
+#ifndef LCORO_HPP
+#define LCORO_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
+#include "ldata.h"
+#include "lpool.hpp"
+
+namespace llib {
+    // Frames per block in each size class pool
+    constexpr usize LCORO_FRAMES_PER_BLOCK = 128;
+
+    // Blocks each size class pool may use
+    constexpr usize LCORO_MAX_BLOCKS = 256;
+
+    // Frames in the scheduler's ring, waits longer than this wrap around
+    constexpr usize LCORO_WHEEL_SIZE = 256;
+
+    // A chunk big enough to hold a coroutine frame of up to `N` bytes
+    template <usize N> struct CoroFrame {
+        alignas(std::max_align_t) u8 bytes[N];
+    };
+
+    /*
+     * The coroutine frame allocator, one pool allocator per power of two size
+     * class from 64 bytes to 4 KiB.
+     *
+     * Script frames are all roughly the same size, so once the pools have
+     * warmed up starting and finishing scripts never touches the heap.
+     */
+    struct CoroFramePools {
+        CoroFramePools(void):
+            m_64(LCORO_FRAMES_PER_BLOCK, LCORO_MAX_BLOCKS),
+            m_128(LCORO_FRAMES_PER_BLOCK, LCORO_MAX_BLOCKS),
+            m_256(LCORO_FRAMES_PER_BLOCK, LCORO_MAX_BLOCKS),
+            m_512(LCORO_FRAMES_PER_BLOCK, LCORO_MAX_BLOCKS),
+            m_1024(LCORO_FRAMES_PER_BLOCK, LCORO_MAX_BLOCKS),
+            m_2048(LCORO_FRAMES_PER_BLOCK, LCORO_MAX_BLOCKS),
+            m_4096(LCORO_FRAMES_PER_BLOCK, LCORO_MAX_BLOCKS) {}
+
+        /*
+         * Returns a frame from the smallest size class that fits `size` bytes,
+         * or `nullptr` if the frame is larger than 4 KiB or its pool is full.
+         */
+        auto allocate(usize const size) -> ptr {
+            if (size <= 64) return m_64.allocate();
+            if (size <= 128) return m_128.allocate();
+            if (size <= 256) return m_256.allocate();
+            if (size <= 512) return m_512.allocate();
+            if (size <= 1024) return m_1024.allocate();
+            if (size <= 2048) return m_2048.allocate();
+            if (size <= 4096) return m_4096.allocate();
+            return nullptr;
+        }
+
+        /*
+         * Returns a frame of `size` bytes to its size class.
+         */
+        void deallocate(ptr const frame, usize const size) {
+            if (size <= 64) m_64.deallocate(frame);
+            else if (size <= 128) m_128.deallocate(frame);
+            else if (size <= 256) m_256.deallocate(frame);
+            else if (size <= 512) m_512.deallocate(frame);
+            else if (size <= 1024) m_1024.deallocate(frame);
+            else if (size <= 2048) m_2048.deallocate(frame);
+            else m_4096.deallocate(frame);
+        }
+
+    private:
+        PoolAllocator<CoroFrame<64>> m_64;
+        PoolAllocator<CoroFrame<128>> m_128;
+        PoolAllocator<CoroFrame<256>> m_256;
+        PoolAllocator<CoroFrame<512>> m_512;
+        PoolAllocator<CoroFrame<1024>> m_1024;
+        PoolAllocator<CoroFrame<2048>> m_2048;
+        PoolAllocator<CoroFrame<4096>> m_4096;
+    };
+
+    // The frame pools shared by every script
+    inline auto coro_frame_pools(void) -> CoroFramePools& {
+        static CoroFramePools pools;
+        return pools;
+    }
+
+    struct ScriptScheduler;
+    struct WaitFrames;
+
+    /*
+     * A script, a coroutine that is run a frame at a time by a scheduler.
+     *
+     * ```c++
+     * auto boss_pattern(Boss &boss) -> llib::Script {
+     *     for (;;) {
+     *         boss.fire_ring();
+     *         co_await llib::wait_frames(30);
+     *     }
+     * }
+     * ```
+     *
+     * A script that could not get a frame from the pools is empty, and
+     * `valid()` returns false.
+     */
+    struct Script {
+        struct promise_type {
+            static auto operator new(usize const size) noexcept -> ptr {
+                return coro_frame_pools().allocate(size);
+            }
+
+            static void operator delete(ptr const frame, usize const size) noexcept {
+                coro_frame_pools().deallocate(frame, size);
+            }
+
+            static auto get_return_object_on_allocation_failure(void) noexcept -> Script {
+                return Script(nullptr);
+            }
+
+            auto get_return_object(void) noexcept -> Script {
+                return Script(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            // Scripts don't run until a scheduler picks them up.
+            auto initial_suspend(void) noexcept -> std::suspend_always { return {}; }
+
+            // The scheduler destroys finished scripts itself.
+            auto final_suspend(void) noexcept -> std::suspend_always { return {}; }
+
+            void return_void(void) noexcept {}
+
+            /*
+             * Only the scheduler's awaitables put a script back in the
+             * wheel, anything else would leave it suspended for good with
+             * its frame never freed.
+             */
+            template <class A> auto await_transform(A &&awaitable) noexcept -> A&& {
+                static_assert(std::is_same_v<std::remove_cvref_t<A>, WaitFrames>,
+                    "scripts can only co_await wait_frames");
+                return std::forward<A>(awaitable);
+            }
+
+            void unhandled_exception(void) noexcept { std::abort(); }
+
+            // Scheduler running the script
+            ScriptScheduler *scheduler = nullptr;
+
+            // Next script sleeping in the same wheel slot
+            promise_type *next = nullptr;
+
+            // Full turns of the wheel left before the script wakes
+            usize rounds = 0;
+        };
+
+        using Handle = std::coroutine_handle<promise_type>;
+
+        Script(Script const&) = delete;
+        Script operator=(Script&) = delete;
+
+        Script(Script &&other) noexcept: m_handle(other.m_handle) { other.m_handle = nullptr; }
+
+        ~Script(void) {
+            if (m_handle) m_handle.destroy();
+        }
+
+        // Whether the script got a frame
+        auto valid(void) -> bool { return static_cast<bool>(m_handle); }
+
+        // Gives up ownership of the coroutine
+        auto release(void) -> Handle {
+            Handle const handle = m_handle;
+            m_handle = nullptr;
+            return handle;
+        }
+
+    private:
+        explicit Script(Handle const handle): m_handle(handle) {}
+
+        Handle m_handle;
+    };
+
+    /*
+     * The script scheduler.
+     *
+     * Sleeping scripts are kept in a ring of `LCORO_WHEEL_SIZE` slots, one per
+     * frame, as intrusive lists threaded through their promises. Each tick the
+     * current slot's list is detached and every script in it resumed in one
+     * batch, so neither waiting nor waking allocates.
+     */
+    struct ScriptScheduler {
+        ScriptScheduler(void) {
+            m_frame = 0;
+            m_live = 0;
+            for (usize i = 0; i < LCORO_WHEEL_SIZE; ++i) m_wheel[i] = nullptr;
+        }
+
+        ScriptScheduler(ScriptScheduler const&) = delete;
+        ScriptScheduler operator=(ScriptScheduler&) = delete;
+
+        /*
+         * Destroys every script still sleeping.
+         */
+        ~ScriptScheduler(void) {
+            for (usize i = 0; i < LCORO_WHEEL_SIZE; ++i) {
+                Script::promise_type *p = m_wheel[i];
+                while (p != nullptr) {
+                    Script::promise_type *const next = p->next;
+                    Script::Handle::from_promise(*p).destroy();
+                    p = next;
+                }
+            }
+        }
+
+        /*
+         * Takes ownership of a script and runs it from the next tick.
+         *
+         * Returns false if the script is empty.
+         */
+        auto spawn(Script &&script) -> bool {
+            if (!script.valid()) return false;
+            Script::Handle const handle = script.release();
+            handle.promise().scheduler = this;
+            ++m_live;
+            sleep(handle, 1);
+            return true;
+        }
+
+        /*
+         * Advances one frame and resumes every script due this frame.
+         *
+         * Returns the number of scripts resumed.
+         */
+        auto tick(void) -> usize {
+            ++m_frame;
+            usize const slot = m_frame % LCORO_WHEEL_SIZE;
+
+            // Detach the whole slot first, scripts that wait again land in
+            // later slots or are put back here for a later round.
+            Script::promise_type *p = m_wheel[slot];
+            m_wheel[slot] = nullptr;
+
+            usize resumed = 0;
+            while (p != nullptr) {
+                Script::promise_type *const next = p->next;
+
+                if (p->rounds > 0) {
+                    --p->rounds;
+                    p->next = m_wheel[slot];
+                    m_wheel[slot] = p;
+                } else {
+                    Script::Handle const handle = Script::Handle::from_promise(*p);
+                    handle.resume();
+                    ++resumed;
+                    if (handle.done()) {
+                        handle.destroy();
+                        --m_live;
+                    }
+                }
+
+                p = next;
+            }
+
+            return resumed;
+        }
+
+        /*
+         * Puts a script to sleep for `frames` frames, at least one.
+         */
+        void sleep(Script::Handle const handle, usize const frames) {
+            usize const wait = frames == 0 ? 1 : frames;
+            usize const slot = (m_frame + wait) % LCORO_WHEEL_SIZE;
+            Script::promise_type &promise = handle.promise();
+            promise.rounds = (wait - 1) / LCORO_WHEEL_SIZE;
+            promise.next = m_wheel[slot];
+            m_wheel[slot] = &promise;
+        }
+
+        // Scripts spawned and not yet finished
+        auto live(void) -> usize { return m_live; }
+
+        // Frames ticked so far
+        auto frame(void) -> u64 { return m_frame; }
+
+    private:
+        Script::promise_type *m_wheel[LCORO_WHEEL_SIZE];
+        u64 m_frame;
+        usize m_live;
+    };
+
+    // Awaitable that suspends a script for a number of frames
+    struct WaitFrames {
+        usize frames;
+
+        auto await_ready(void) const noexcept -> bool { return false; }
+
+        void await_suspend(Script::Handle const handle) const noexcept {
+            handle.promise().scheduler->sleep(handle, frames);
+        }
+
+        void await_resume(void) const noexcept {}
+    };
+
+    /*
+     * Suspends the calling script for `frames` frames.
+     */
+    inline auto wait_frames(usize const frames) -> WaitFrames {
+        return WaitFrames{ frames };
+    }
+}
+
+#endif
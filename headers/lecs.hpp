@@ -0,0 +1,497 @@
+#ifndef LECS_HPP
+#define LECS_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include "ldata.h"
+#include "lpool.hpp"
+
+namespace llib {
+    // Size of a chunk of archetype storage (in bytes)
+    constexpr usize ECS_CHUNK_BYTES = 16384;
+
+    // Chunks per block of the world's chunk pool
+    constexpr usize ECS_CHUNKS_PER_BLOCK = 16;
+
+    // Most component types, one bit each in an archetype's mask
+    constexpr usize ECS_MAX_COMPONENTS = 64;
+
+    // Most distinct component combinations in a world
+    constexpr usize ECS_MAX_ARCHETYPES = 256;
+
+    // Marks a missing archetype, column or entity
+    constexpr u32 ECS_NONE = ~0u;
+
+    /*
+     * A handle to an entity. The generation changes every time an index is
+     * reused, so handles to destroyed entities are recognised as stale.
+     */
+    struct Entity {
+        u32 index;
+        u32 generation;
+    };
+
+    // A fixed size block of archetype storage
+    struct EcsChunk {
+        alignas(std::max_align_t) u8 bytes[ECS_CHUNK_BYTES];
+    };
+
+    struct EcsComponentInfo {
+        u32 size;
+        u32 align;
+    };
+
+    // Size and alignment of every component type seen so far
+    inline EcsComponentInfo ecs_components[ECS_MAX_COMPONENTS];
+    inline u32 ecs_component_count = 0;
+
+    /*
+     * Returns the id of component type T, assigning the next free id the
+     * first time T is used. Components are plain data and are moved with
+     * `memcpy`.
+     *
+     * Every id is a bit in a 64 bit mask, so using more than
+     * `ECS_MAX_COMPONENTS` component types is a bug and aborts.
+     */
+    template <class T> auto component_id(void) -> u32 {
+        static_assert(std::is_trivially_copyable_v<T>, "Components must be trivially copyable");
+        static u32 const id = [] {
+            if (ecs_component_count == ECS_MAX_COMPONENTS) {
+                (void)std::fprintf(stderr, "ECS: more than %zu component types\n", ECS_MAX_COMPONENTS);
+                std::abort();
+            }
+            u32 const i = ecs_component_count++;
+            ecs_components[i] = EcsComponentInfo{ sizeof(T), alignof(T) };
+            return i;
+        }();
+        return id;
+    }
+
+    // The archetype mask of a set of component types
+    template <class... Cs> auto component_mask(void) -> u64 {
+        return (u64(0) | ... | (u64(1) << component_id<Cs>()));
+    }
+
+    /*
+     * All entities with exactly one set of components.
+     *
+     * Rows are packed into chunks, each laid out as one array per component
+     * (plus one of entity handles) so iterating a component is a linear walk.
+     * Every chunk is full except the last.
+     */
+    struct EcsArchetype {
+        u64 mask;
+
+        // Rows per chunk and rows in use
+        u32 capacity;
+        u32 count;
+
+        // Offset of each component's array within a chunk, or `ECS_NONE`
+        u32 column_offset[ECS_MAX_COMPONENTS];
+        u32 entity_offset;
+
+        EcsChunk **chunks;
+        u32 chunk_count;
+        u32 chunk_slots;
+
+        // Archetype reached by adding or removing each component
+        u32 add_edge[ECS_MAX_COMPONENTS];
+        u32 remove_edge[ECS_MAX_COMPONENTS];
+    };
+
+    // Where an entity's row lives, indexed by entity index
+    struct EcsRecord {
+        u32 archetype;
+        u32 row;
+        u32 generation;
+        u32 next_free;
+    };
+
+    /*
+     * The entity world.
+     *
+     * An entity's record gives its archetype and row, so finding a component
+     * is an index, a mask check and some arithmetic. Archetype chunks come
+     * from a pool allocator, so growing and shrinking archetypes never goes to
+     * the heap once the pool is warm.
+     *
+     * Structural changes (create, destroy, add, remove) move rows around, so
+     * they must not happen while a query is iterating. Record them in a
+     * command buffer and apply them afterwards instead.
+     */
+    struct EcsWorld {
+        EcsWorld(void) = delete;
+        EcsWorld(EcsWorld const&) = delete;
+        EcsWorld operator=(EcsWorld&) = delete;
+
+        /*
+         * - max_chunk_blocks is the number of blocks the chunk pool may use,
+         *   each holding `ECS_CHUNKS_PER_BLOCK` chunks
+         */
+        EcsWorld(usize const max_chunk_blocks):
+            m_chunks(ECS_CHUNKS_PER_BLOCK, max_chunk_blocks)
+        {
+            m_archetypes = reinterpret_cast<EcsArchetype *>(
+                std::calloc(ECS_MAX_ARCHETYPES, sizeof(EcsArchetype))
+            );
+            m_archetype_count = 0;
+            m_records = nullptr;
+            m_record_count = 0;
+            m_record_slots = 0;
+            m_free = ECS_NONE;
+            m_alive = 0;
+        }
+
+        ~EcsWorld(void) {
+            for (u32 a = 0; a < m_archetype_count; ++a) std::free(m_archetypes[a].chunks);
+            std::free(m_archetypes);
+            std::free(m_records);
+        }
+
+        /*
+         * Creates an entity with the given components.
+         *
+         * Returns an entity with index `ECS_NONE` if the world is out of
+         * chunks or archetypes.
+         */
+        template <class... Cs> auto create(Cs const&... values) -> Entity {
+            u32 const archetype = _find_archetype(component_mask<Cs...>());
+            if (archetype == ECS_NONE) return Entity{ ECS_NONE, 0 };
+
+            u32 const index = _new_record();
+            if (index == ECS_NONE) return Entity{ ECS_NONE, 0 };
+
+            EcsRecord &record = m_records[index];
+            Entity const entity{ index, record.generation };
+
+            u32 const row = _push_row(archetype, entity);
+            if (row == ECS_NONE) {
+                _free_record(index);
+                return Entity{ ECS_NONE, 0 };
+            }
+
+            record.archetype = archetype;
+            record.row = row;
+            (_write<Cs>(archetype, row, values), ...);
+            return entity;
+        }
+
+        /*
+         * Destroys an entity. Stale handles are ignored.
+         */
+        void destroy(Entity const entity) {
+            if (!alive(entity)) return;
+            EcsRecord const record = m_records[entity.index];
+            _remove_row(record.archetype, record.row);
+            _free_record(entity.index);
+        }
+
+        // Whether a handle still refers to a live entity
+        auto alive(Entity const entity) -> bool {
+            return entity.index < m_record_count
+                && m_records[entity.index].generation == entity.generation
+                && m_records[entity.index].archetype != ECS_NONE;
+        }
+
+        /*
+         * Returns an entity's component T, or `nullptr` if it doesn't have
+         * one. The pointer is valid until the next structural change.
+         */
+        template <class T> auto get(Entity const entity) -> T* {
+            if (!alive(entity)) return nullptr;
+            EcsRecord const& record = m_records[entity.index];
+            EcsArchetype const& archetype = m_archetypes[record.archetype];
+            u32 const offset = archetype.column_offset[component_id<T>()];
+            if (offset == ECS_NONE) return nullptr;
+            EcsChunk *const chunk = archetype.chunks[record.row / archetype.capacity];
+            return reinterpret_cast<T *>(chunk->bytes + offset) + record.row % archetype.capacity;
+        }
+
+        template <class T> auto has(Entity const entity) -> bool {
+            return get<T>(entity) != nullptr;
+        }
+
+        /*
+         * Adds component T to an entity, or overwrites it if already present.
+         *
+         * Returns false if the entity is stale or the world is out of space.
+         */
+        template <class T> auto add(Entity const entity, T const& value) -> bool {
+            if (!alive(entity)) return false;
+            u32 const id = component_id<T>();
+            EcsRecord &record = m_records[entity.index];
+
+            if (m_archetypes[record.archetype].column_offset[id] == ECS_NONE) {
+                u32 target = m_archetypes[record.archetype].add_edge[id];
+                if (target == ECS_NONE) {
+                    target = _find_archetype(m_archetypes[record.archetype].mask | (u64(1) << id));
+                    if (target == ECS_NONE) return false;
+                    m_archetypes[record.archetype].add_edge[id] = target;
+                }
+                if (!_move(entity, target)) return false;
+            }
+
+            *get<T>(entity) = value;
+            return true;
+        }
+
+        /*
+         * Removes component T from an entity.
+         */
+        template <class T> auto remove(Entity const entity) -> bool {
+            if (!alive(entity)) return false;
+            u32 const id = component_id<T>();
+            EcsRecord &record = m_records[entity.index];
+            if (m_archetypes[record.archetype].column_offset[id] == ECS_NONE) return true;
+
+            u32 target = m_archetypes[record.archetype].remove_edge[id];
+            if (target == ECS_NONE) {
+                target = _find_archetype(m_archetypes[record.archetype].mask & ~(u64(1) << id));
+                if (target == ECS_NONE) return false;
+                m_archetypes[record.archetype].remove_edge[id] = target;
+            }
+            return _move(entity, target);
+        }
+
+        // Number of live entities
+        auto alive_count(void) -> usize { return m_alive; }
+
+        // Number of archetypes created so far, queries use it to spot new ones
+        auto archetype_count(void) -> u32 { return m_archetype_count; }
+
+        auto archetype(u32 const i) -> EcsArchetype& { return m_archetypes[i]; }
+
+    private:
+        auto _find_archetype(u64 const mask) -> u32 {
+            for (u32 a = 0; a < m_archetype_count; ++a)
+                if (m_archetypes[a].mask == mask) return a;
+            if (m_archetype_count >= ECS_MAX_ARCHETYPES) return ECS_NONE;
+
+            EcsArchetype &archetype = m_archetypes[m_archetype_count];
+            archetype = EcsArchetype{};
+            archetype.mask = mask;
+            for (usize c = 0; c < ECS_MAX_COMPONENTS; ++c) {
+                archetype.column_offset[c] = ECS_NONE;
+                archetype.add_edge[c] = ECS_NONE;
+                archetype.remove_edge[c] = ECS_NONE;
+            }
+
+            // Bytes per row, and the worst case padding between columns.
+            usize row_bytes = sizeof(Entity), padding = 0;
+            for (usize c = 0; c < ECS_MAX_COMPONENTS; ++c) {
+                if (!(mask & (u64(1) << c))) continue;
+                row_bytes += ecs_components[c].size;
+                padding += ecs_components[c].align;
+            }
+
+            archetype.capacity = static_cast<u32>((ECS_CHUNK_BYTES - padding) / row_bytes);
+            if (archetype.capacity == 0) return ECS_NONE;
+
+            // Entity handles first, then each component's array in id order.
+            usize offset = 0;
+            archetype.entity_offset = 0;
+            offset += sizeof(Entity) * archetype.capacity;
+            for (usize c = 0; c < ECS_MAX_COMPONENTS; ++c) {
+                if (!(mask & (u64(1) << c))) continue;
+                usize const align = ecs_components[c].align;
+                offset = (offset + align - 1) & ~(align - 1);
+                archetype.column_offset[c] = static_cast<u32>(offset);
+                offset += static_cast<usize>(ecs_components[c].size) * archetype.capacity;
+            }
+
+            return m_archetype_count++;
+        }
+
+        auto _new_record(void) -> u32 {
+            u32 index;
+            if (m_free != ECS_NONE) {
+                index = m_free;
+                m_free = m_records[index].next_free;
+            } else {
+                if (m_record_count == m_record_slots) {
+                    u32 const slots = m_record_slots == 0 ? 1024 : m_record_slots * 2;
+                    EcsRecord *const records = reinterpret_cast<EcsRecord *>(
+                        std::realloc(m_records, slots * sizeof(EcsRecord))
+                    );
+                    if (records == nullptr) return ECS_NONE;
+                    m_records = records;
+                    m_record_slots = slots;
+                }
+                index = m_record_count++;
+                m_records[index].generation = 0;
+            }
+
+            m_records[index].archetype = ECS_NONE;
+            m_records[index].next_free = ECS_NONE;
+            ++m_alive;
+            return index;
+        }
+
+        void _free_record(u32 const index) {
+            EcsRecord &record = m_records[index];
+            record.archetype = ECS_NONE;
+            ++record.generation;
+            record.next_free = m_free;
+            m_free = index;
+            --m_alive;
+        }
+
+        // Appends a row for `entity`, returning the row or `ECS_NONE`
+        auto _push_row(u32 const a, Entity const entity) -> u32 {
+            EcsArchetype &archetype = m_archetypes[a];
+
+            if (archetype.count == archetype.chunk_count * archetype.capacity) {
+                if (archetype.chunk_count == archetype.chunk_slots) {
+                    u32 const slots = archetype.chunk_slots == 0 ? 8 : archetype.chunk_slots * 2;
+                    EcsChunk **const chunks = reinterpret_cast<EcsChunk **>(
+                        std::realloc(archetype.chunks, slots * sizeof(EcsChunk *))
+                    );
+                    if (chunks == nullptr) return ECS_NONE;
+                    archetype.chunks = chunks;
+                    archetype.chunk_slots = slots;
+                }
+
+                EcsChunk *const chunk = m_chunks.allocate();
+                if (chunk == nullptr) return ECS_NONE;
+                archetype.chunks[archetype.chunk_count++] = chunk;
+            }
+
+            u32 const row = archetype.count++;
+            *_entity_at(archetype, row) = entity;
+            return row;
+        }
+
+        // Fills a row's hole with the archetype's last row
+        void _remove_row(u32 const a, u32 const row) {
+            EcsArchetype &archetype = m_archetypes[a];
+            u32 const last = --archetype.count;
+
+            if (row != last) {
+                for (usize c = 0; c < ECS_MAX_COMPONENTS; ++c) {
+                    if (archetype.column_offset[c] == ECS_NONE) continue;
+                    usize const size = ecs_components[c].size;
+                    std::memcpy(_column_at(archetype, c, row), _column_at(archetype, c, last), size);
+                }
+                Entity const moved = *_entity_at(archetype, last);
+                *_entity_at(archetype, row) = moved;
+                m_records[moved.index].row = row;
+            }
+
+            // Hand an emptied last chunk back to the pool.
+            if (archetype.count <= (archetype.chunk_count - 1) * archetype.capacity) {
+                m_chunks.deallocate(archetype.chunks[--archetype.chunk_count]);
+            }
+        }
+
+        // Moves an entity's row to another archetype, keeping shared components
+        auto _move(Entity const entity, u32 const target) -> bool {
+            EcsRecord &record = m_records[entity.index];
+            u32 const source = record.archetype;
+            u32 const row = _push_row(target, entity);
+            if (row == ECS_NONE) return false;
+
+            EcsArchetype &from = m_archetypes[source];
+            EcsArchetype &to = m_archetypes[target];
+            for (usize c = 0; c < ECS_MAX_COMPONENTS; ++c) {
+                if (from.column_offset[c] == ECS_NONE || to.column_offset[c] == ECS_NONE) continue;
+                std::memcpy(_column_at(to, c, row), _column_at(from, c, record.row), ecs_components[c].size);
+            }
+
+            _remove_row(source, record.row);
+            record.archetype = target;
+            record.row = row;
+            return true;
+        }
+
+        template <class T> void _write(u32 const a, u32 const row, T const& value) {
+            std::memcpy(_column_at(m_archetypes[a], component_id<T>(), row), &value, sizeof(T));
+        }
+
+        static auto _column_at(EcsArchetype &archetype, usize const c, u32 const row) -> u8* {
+            EcsChunk *const chunk = archetype.chunks[row / archetype.capacity];
+            return chunk->bytes + archetype.column_offset[c]
+                + static_cast<usize>(ecs_components[c].size) * (row % archetype.capacity);
+        }
+
+        static auto _entity_at(EcsArchetype &archetype, u32 const row) -> Entity* {
+            EcsChunk *const chunk = archetype.chunks[row / archetype.capacity];
+            return reinterpret_cast<Entity *>(chunk->bytes + archetype.entity_offset) + row % archetype.capacity;
+        }
+
+        // Allocator for archetype chunks
+        PoolAllocator<EcsChunk> m_chunks;
+
+        EcsArchetype *m_archetypes;
+        u32 m_archetype_count;
+
+        // Entity records, with destroyed indices chained through `next_free`
+        EcsRecord *m_records;
+        u32 m_record_count;
+        u32 m_record_slots;
+        u32 m_free;
+        usize m_alive;
+    };
+
+    /*
+     * A cached query over every archetype with at least the components `Cs`.
+     *
+     * Matching archetypes are remembered, and only archetypes created since
+     * the last run are checked again, so running a query is a walk over its
+     * archetypes' chunks.
+     */
+    template <class... Cs> struct EcsQuery {
+        EcsQuery(void) {
+            m_mask = component_mask<Cs...>();
+            m_count = 0;
+            m_seen = 0;
+        }
+
+        /*
+         * Calls `fn(usize n, Entity const *entities, Cs *...columns)` once per
+         * chunk with that chunk's arrays, for loops the compiler can vectorise.
+         */
+        template <class F> void each_chunk(EcsWorld &world, F &&fn) {
+            _refresh(world);
+            for (u32 m = 0; m < m_count; ++m) {
+                EcsArchetype &archetype = world.archetype(m_archetypes[m]);
+                for (u32 c = 0; c < archetype.chunk_count; ++c) {
+                    u32 const start = c * archetype.capacity;
+                    u32 const rows = archetype.count - start < archetype.capacity
+                        ? archetype.count - start : archetype.capacity;
+                    u8 *const bytes = archetype.chunks[c]->bytes;
+                    fn(
+                        static_cast<usize>(rows),
+                        reinterpret_cast<Entity const *>(bytes + archetype.entity_offset),
+                        reinterpret_cast<Cs *>(bytes + archetype.column_offset[component_id<Cs>()])...
+                    );
+                }
+            }
+        }
+
+        /*
+         * Calls `fn(Cs &...components)` for every matching entity.
+         */
+        template <class F> void each(EcsWorld &world, F &&fn) {
+            each_chunk(world, [&fn](usize const n, Entity const *, Cs *const ...columns) {
+                for (usize i = 0; i < n; ++i) fn(columns[i]...);
+            });
+        }
+
+    private:
+        void _refresh(EcsWorld &world) {
+            for (; m_seen < world.archetype_count(); ++m_seen)
+                if ((world.archetype(m_seen).mask & m_mask) == m_mask)
+                    m_archetypes[m_count++] = m_seen;
+        }
+
+        u64 m_mask;
+        u32 m_archetypes[ECS_MAX_ARCHETYPES];
+        u32 m_count;
+        u32 m_seen;
+    };
+}
+
+#endif
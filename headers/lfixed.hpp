@@ -0,0 +1,259 @@
+#ifndef LFIXED_HPP
+#define LFIXED_HPP
+
+#include <cmath>
+#include <compare>
+#include "ldata.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LFIXED_AVX2 1
+#endif
+
+/*
+ * Fixed point numbers for a deterministic simulation mode: `q16` is Q16.16
+ * in an `i32` and `q32` is Q32.32 in an `i64`.
+ *
+ * Every operation is integer only and saturates at the ends of the range
+ * rather than wrapping, so a simulation gives bit identical results on every
+ * compiler and CPU, which replays and regression checks rely on. Products and
+ * quotients round towards negative infinity, and dividing by zero saturates
+ * to the end of the range with the dividend's sign.
+ *
+ * Floats only come in through `from_float`, for loading level data, and go
+ * out through `to_float`, for rendering; neither feeds back into the state.
+ *
+ * The `q16` movement and collision kernels work on the raw values in SoA
+ * arrays, 8 at a time with AVX2 when the build enables it, and give the same
+ * bits either way.
+ */
+namespace llib {
+    __extension__ typedef __int128 i128;
+
+    constexpr i32 Q16_ONE = 1 << 16;
+    constexpr i64 Q32_ONE = i64(1) << 32;
+
+    // Clamps to the range of an `i32`
+    constexpr auto saturate_i32(i64 const v) -> i32 {
+        return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : static_cast<i32>(v));
+    }
+
+    // Clamps to the range of an `i64`
+    constexpr auto saturate_i64(i128 const v) -> i64 {
+        return v > INT64_MAX ? INT64_MAX : (v < INT64_MIN ? INT64_MIN : static_cast<i64>(v));
+    }
+
+    /*
+     * Q16.16, 16 integer bits and 16 fraction bits, from -32768 to just under
+     * 32768 in steps of 1/65536.
+     */
+    struct q16 {
+        i32 raw;
+
+        static constexpr auto from_raw(i32 const raw) -> q16 { return { raw }; }
+        static constexpr auto from_int(i32 const v) -> q16 { return { saturate_i32(static_cast<i64>(v) * Q16_ONE) }; }
+
+        // Nearest value to `v`, saturating
+        static auto from_float(f64 const v) -> q16 {
+            f64 const scaled = std::nearbyint(v * Q16_ONE);
+            return { scaled >= 2147483647.0 ? INT32_MAX : (scaled <= -2147483648.0 ? INT32_MIN : static_cast<i32>(scaled)) };
+        }
+
+        constexpr auto to_float(void) const -> f64 { return static_cast<f64>(raw) / Q16_ONE; }
+
+        // Rounded towards negative infinity
+        constexpr auto to_int(void) const -> i32 { return raw >> 16; }
+
+        constexpr auto operator<=>(q16 const&) const = default;
+    };
+
+    constexpr auto operator+(q16 const a, q16 const b) -> q16 { return { saturate_i32(static_cast<i64>(a.raw) + b.raw) }; }
+    constexpr auto operator-(q16 const a, q16 const b) -> q16 { return { saturate_i32(static_cast<i64>(a.raw) - b.raw) }; }
+    constexpr auto operator-(q16 const a) -> q16 { return { saturate_i32(-static_cast<i64>(a.raw)) }; }
+    constexpr auto operator*(q16 const a, q16 const b) -> q16 { return { saturate_i32((static_cast<i64>(a.raw) * b.raw) >> 16) }; }
+
+    constexpr auto operator/(q16 const a, q16 const b) -> q16 {
+        if (b.raw == 0) return { a.raw < 0 ? INT32_MIN : INT32_MAX };
+        i64 const n = static_cast<i64>(a.raw) * Q16_ONE;
+        i64 q = n / b.raw;
+        // Integer division truncates, step down to the floor.
+        if ((n % b.raw != 0) && ((n < 0) != (b.raw < 0))) --q;
+        return { saturate_i32(q) };
+    }
+
+    constexpr auto operator+=(q16 &a, q16 const b) -> q16& { a = a + b; return a; }
+    constexpr auto operator-=(q16 &a, q16 const b) -> q16& { a = a - b; return a; }
+    constexpr auto operator*=(q16 &a, q16 const b) -> q16& { a = a * b; return a; }
+
+    /*
+     * Q32.32, 32 integer bits and 32 fraction bits, for world scale positions
+     * and accumulators that outgrow `q16`.
+     */
+    struct q32 {
+        i64 raw;
+
+        static constexpr auto from_raw(i64 const raw) -> q32 { return { raw }; }
+        static constexpr auto from_int(i32 const v) -> q32 { return { static_cast<i64>(v) * Q32_ONE }; }
+        static constexpr auto from_q16(q16 const v) -> q32 { return { static_cast<i64>(v.raw) << 16 }; }
+
+        // Nearest value to `v`, saturating
+        static auto from_float(f64 const v) -> q32 {
+            f64 const scaled = std::nearbyint(v * static_cast<f64>(Q32_ONE));
+            return { scaled >= 9223372036854775807.0 ? INT64_MAX : (scaled <= -9223372036854775808.0 ? INT64_MIN : static_cast<i64>(scaled)) };
+        }
+
+        constexpr auto to_float(void) const -> f64 { return static_cast<f64>(raw) / static_cast<f64>(Q32_ONE); }
+
+        // Rounded towards negative infinity
+        constexpr auto to_int(void) const -> i32 { return static_cast<i32>(raw >> 32); }
+
+        // Nearest `q16` below, saturating
+        constexpr auto to_q16(void) const -> q16 { return { saturate_i32(raw >> 16) }; }
+
+        constexpr auto operator<=>(q32 const&) const = default;
+    };
+
+    constexpr auto operator+(q32 const a, q32 const b) -> q32 { return { saturate_i64(static_cast<i128>(a.raw) + b.raw) }; }
+    constexpr auto operator-(q32 const a, q32 const b) -> q32 { return { saturate_i64(static_cast<i128>(a.raw) - b.raw) }; }
+    constexpr auto operator-(q32 const a) -> q32 { return { saturate_i64(-static_cast<i128>(a.raw)) }; }
+    constexpr auto operator*(q32 const a, q32 const b) -> q32 { return { saturate_i64((static_cast<i128>(a.raw) * b.raw) >> 32) }; }
+
+    constexpr auto operator/(q32 const a, q32 const b) -> q32 {
+        if (b.raw == 0) return { a.raw < 0 ? INT64_MIN : INT64_MAX };
+        i128 const n = static_cast<i128>(a.raw) * Q32_ONE;
+        i128 q = n / b.raw;
+        if ((n % b.raw != 0) && ((n < 0) != (b.raw < 0))) --q;
+        return { saturate_i64(q) };
+    }
+
+    constexpr auto operator+=(q32 &a, q32 const b) -> q32& { a = a + b; return a; }
+    constexpr auto operator-=(q32 &a, q32 const b) -> q32& { a = a - b; return a; }
+    constexpr auto operator*=(q32 &a, q32 const b) -> q32& { a = a * b; return a; }
+
+    /*        Kernels        */
+
+#if defined(LFIXED_AVX2)
+    // Saturating add of 8 lanes: on overflow both inputs share a sign the
+    // sum doesn't, and the result clamps towards that sign
+    inline auto _q16_adds(__m256i const a, __m256i const b) -> __m256i {
+        __m256i const sum = _mm256_add_epi32(a, b);
+        __m256i const overflow = _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(a, sum), _mm256_xor_si256(b, sum)), 31);
+        __m256i const limit = _mm256_xor_si256(_mm256_srai_epi32(a, 31), _mm256_set1_epi32(INT32_MAX));
+        return _mm256_blendv_epi8(sum, limit, overflow);
+    }
+
+    // Saturating subtract of 8 lanes: on overflow the inputs differ in sign
+    // and the difference doesn't share the first's
+    inline auto _q16_subs(__m256i const a, __m256i const b) -> __m256i {
+        __m256i const diff = _mm256_sub_epi32(a, b);
+        __m256i const overflow = _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(a, diff)), 31);
+        __m256i const limit = _mm256_xor_si256(_mm256_srai_epi32(a, 31), _mm256_set1_epi32(INT32_MAX));
+        return _mm256_blendv_epi8(diff, limit, overflow);
+    }
+
+    // Saturating Q16.16 product of 4 lanes widened to 64 bits, the result in
+    // the low half of each
+    inline auto _q16_mul_wide(__m256i const product) -> __m256i {
+        __m256i const shifted = _mm256_srli_epi64(product, 16);
+        // Fits when the product lies in [-2^47, 2^47).
+        __m256i const biased = _mm256_add_epi64(product, _mm256_set1_epi64x(i64(1) << 47));
+        __m256i const fits = _mm256_cmpeq_epi64(_mm256_srli_epi64(biased, 48), _mm256_setzero_si256());
+        __m256i const negative = _mm256_cmpgt_epi64(_mm256_setzero_si256(), product);
+        __m256i const limit = _mm256_xor_si256(negative, _mm256_set1_epi64x(INT32_MAX));
+        return _mm256_blendv_epi8(limit, shifted, fits);
+    }
+
+    // Saturating Q16.16 product of 8 lanes with one value
+    inline auto _q16_mul(__m256i const a, __m256i const b) -> __m256i {
+        __m256i const even = _q16_mul_wide(_mm256_mul_epi32(a, b));
+        __m256i const odd = _q16_mul_wide(_mm256_mul_epi32(_mm256_srli_epi64(a, 32), b));
+        return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+    }
+#endif
+
+    /*
+     * Moves `n` positions by their velocities over `dt`, on raw Q16.16
+     * arrays: `x += vx * dt` and `y += vy * dt`, saturating.
+     */
+    inline void q16_integrate(
+        i32 *const x, i32 *const y,
+        i32 const *const vx, i32 const *const vy,
+        usize const n, q16 const dt
+    ) {
+        usize i = 0;
+#if defined(LFIXED_AVX2)
+        __m256i const step = _mm256_set1_epi32(dt.raw);
+        for (; i + 8 <= n; i += 8) {
+            __m256i const px = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(x + i));
+            __m256i const py = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(y + i));
+            __m256i const dx = _q16_mul(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(vx + i)), step);
+            __m256i const dy = _q16_mul(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(vy + i)), step);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(x + i), _q16_adds(px, dx));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(y + i), _q16_adds(py, dy));
+        }
+#endif
+        for (; i < n; ++i) {
+            x[i] = (q16{ x[i] } + q16{ vx[i] } * dt).raw;
+            y[i] = (q16{ y[i] } + q16{ vy[i] } * dt).raw;
+        }
+    }
+
+    /*
+     * Finds the positions within `radius` of (`qx`, `qy`), on raw Q16.16
+     * arrays, writing their indices to `hits` in order and returning how
+     * many there were. `hits` must have room for `n` indices.
+     *
+     * Offsets are clamped to 2^30 raw before squaring so the sums stay in
+     * 64 bits, which is exact for any radius under 16384.
+     */
+    inline auto q16_overlaps(
+        i32 const *const x, i32 const *const y, usize const n,
+        q16 const qx, q16 const qy, q16 const radius,
+        u32 *const hits
+    ) -> usize {
+        i64 const r2 = static_cast<i64>(radius.raw) * radius.raw;
+        usize count = 0;
+        usize i = 0;
+#if defined(LFIXED_AVX2)
+        __m256i const cx = _mm256_set1_epi32(qx.raw);
+        __m256i const cy = _mm256_set1_epi32(qy.raw);
+        __m256i const hi = _mm256_set1_epi32(1 << 30);
+        __m256i const lo = _mm256_set1_epi32(-(1 << 30));
+        __m256i const limit = _mm256_set1_epi64x(r2);
+
+        // dx^2 + dy^2 <= r^2 for the even lanes, as 64 bit masks
+        auto const within = [&](__m256i const dx, __m256i const dy) -> __m256i {
+            __m256i const d2 = _mm256_add_epi64(_mm256_mul_epi32(dx, dx), _mm256_mul_epi32(dy, dy));
+            return _mm256_xor_si256(_mm256_cmpgt_epi64(d2, limit), _mm256_set1_epi64x(-1));
+        };
+
+        for (; i + 8 <= n; i += 8) {
+            __m256i const px = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(x + i));
+            __m256i const py = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(y + i));
+            __m256i dx = _q16_subs(px, cx);
+            __m256i dy = _q16_subs(py, cy);
+            dx = _mm256_max_epi32(_mm256_min_epi32(dx, hi), lo);
+            dy = _mm256_max_epi32(_mm256_min_epi32(dy, hi), lo);
+
+            __m256i const even = within(dx, dy);
+            __m256i const odd = within(_mm256_srli_epi64(dx, 32), _mm256_srli_epi64(dy, 32));
+            __m256i const mask = _mm256_blend_epi32(even, odd, 0xaa);
+
+            u32 bits = static_cast<u32>(_mm256_movemask_ps(_mm256_castsi256_ps(mask)));
+            while (bits != 0) {
+                hits[count++] = static_cast<u32>(i) + static_cast<u32>(__builtin_ctz(bits));
+                bits &= bits - 1;
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            i64 dx = (q16{ x[i] } - qx).raw, dy = (q16{ y[i] } - qy).raw;
+            dx = dx > (1 << 30) ? (1 << 30) : (dx < -(1 << 30) ? -(1 << 30) : dx);
+            dy = dy > (1 << 30) ? (1 << 30) : (dy < -(1 << 30) ? -(1 << 30) : dy);
+            if (dx * dx + dy * dy <= r2) hits[count++] = static_cast<u32>(i);
+        }
+        return count;
+    }
+}
+
+#endif
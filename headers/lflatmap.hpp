@@ -0,0 +1,332 @@
+#ifndef LFLATMAP_HPP
+#define LFLATMAP_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "ldata.h"
+#include "larena.hpp"
+
+namespace llib {
+    // Slots whose control bytes are checked together
+    constexpr usize FLATMAP_GROUP = 16;
+
+    // Control bytes of slots without a key, full slots hold 7 bits of hash
+    constexpr u8 FLATMAP_EMPTY = 0x80;
+    constexpr u8 FLATMAP_DELETED = 0xfe;
+
+    // A slot index meaning no slot
+    constexpr usize FLATMAP_NONE = ~usize(0);
+
+    /*
+     * The default hash, mixing integer and pointer keys so nearby ids and
+     * aligned addresses spread over the table.
+     */
+    template <class K> struct FlatHash {
+        auto operator()(K const& key) const -> u64 {
+            u64 x;
+            if constexpr (std::is_pointer_v<K>) x = static_cast<u64>(reinterpret_cast<uintptr_t>(key));
+            else x = static_cast<u64>(key);
+            x ^= x >> 33;
+            x *= 0xff51afd7ed558ccdull;
+            x ^= x >> 33;
+            x *= 0xc4ceb9fe1a85ec53ull;
+            x ^= x >> 33;
+            return x;
+        }
+    };
+
+    /*
+     * A bit per slot of a group, set where the group matched.
+     */
+    struct FlatMatch {
+        u32 bits;
+
+        auto any(void) const -> bool { return bits != 0; }
+        // Index of the lowest set slot, only when `any`
+        auto first(void) const -> usize { return static_cast<usize>(__builtin_ctz(bits)); }
+        void next(void) { bits &= bits - 1; }
+    };
+
+    /*
+     * Sixteen control bytes, compared at once with SSE2 or one by one without.
+     */
+    struct FlatGroup {
+        explicit FlatGroup(u8 const *const ctrl) {
+#if defined(__SSE2__)
+            m_ctrl = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ctrl));
+#else
+            std::memcpy(m_ctrl, ctrl, FLATMAP_GROUP);
+#endif
+        }
+
+        // Slots whose control byte is `h2`
+        auto match(u8 const h2) const -> FlatMatch {
+#if defined(__SSE2__)
+            __m128i const eq = _mm_cmpeq_epi8(m_ctrl, _mm_set1_epi8(static_cast<char>(h2)));
+            return { static_cast<u32>(_mm_movemask_epi8(eq)) };
+#else
+            u32 bits = 0;
+            for (usize i = 0; i < FLATMAP_GROUP; ++i) bits |= static_cast<u32>(m_ctrl[i] == h2) << i;
+            return { bits };
+#endif
+        }
+
+        auto match_empty(void) const -> FlatMatch { return match(FLATMAP_EMPTY); }
+
+        // Slots that are empty or deleted, the only control bytes with the top bit set
+        auto match_free(void) const -> FlatMatch {
+#if defined(__SSE2__)
+            return { static_cast<u32>(_mm_movemask_epi8(m_ctrl)) };
+#else
+            u32 bits = 0;
+            for (usize i = 0; i < FLATMAP_GROUP; ++i) bits |= static_cast<u32>(m_ctrl[i] >> 7) << i;
+            return { bits };
+#endif
+        }
+
+    private:
+#if defined(__SSE2__)
+        __m128i m_ctrl;
+#else
+        u8 m_ctrl[FLATMAP_GROUP];
+#endif
+    };
+
+    /*
+     * The flat map, an open addressing hash map storing keys and values in
+     * one array with no per entry allocation.
+     *
+     * Each slot has a control byte that is empty, deleted, or holds 7 bits of
+     * its key's hash, and control bytes are scanned a group of 16 at a time,
+     * so most lookups check one group and compare one key. Probing goes from
+     * group to group, so a key only ends up past a group that was full when
+     * it went in. Erasing from a group that still has an empty slot can
+     * therefore mark the slot empty rather than leave a tombstone, and
+     * tombstones only appear in groups that have filled up.
+     *
+     * Keys and values must be trivially copyable, and are moved with plain
+     * copies when the table grows. Tables come from `malloc`, or from a frame
+     * arena for maps that live only as long as the arena's frame, where grown
+     * out of tables are left to the arena's reset.
+     */
+    template <class K, class V, class H = FlatHash<K>> struct FlatMap {
+        static_assert(std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>,
+            "FlatMap keys and values must be trivially copyable");
+
+        FlatMap(FlatMap const&) = delete;
+        FlatMap operator=(FlatMap&) = delete;
+
+        /*
+         * - capacity is the number of entries to make room for up front
+         * - arena, if given, provides every table instead of `malloc`
+         */
+        FlatMap(usize const capacity = 0, FrameArena *const arena = nullptr) {
+            m_arena = arena;
+            m_ctrl = nullptr;
+            m_slots = nullptr;
+            m_mask = 0;
+            m_size = 0;
+            m_growth_left = 0;
+            if (capacity > 0) reserve(capacity);
+        }
+
+        ~FlatMap(void) { _free(); }
+
+        // The value stored for `key`, or `nullptr`
+        auto find(K const& key) -> V* {
+            usize const index = _find(key);
+            return index == FLATMAP_NONE ? nullptr : &m_slots[index].value;
+        }
+
+        auto contains(K const& key) -> bool { return find(key) != nullptr; }
+
+        /*
+         * Stores `value` for `key`, replacing any earlier value. Returns the
+         * stored value, or `nullptr` if the table couldn't grow.
+         */
+        auto insert(K const& key, V const& value) -> V* {
+            if (V *const existing = find(key)) {
+                *existing = value;
+                return existing;
+            }
+            if (m_growth_left == 0 && !_grow()) return nullptr;
+
+            u64 const hash = m_hash(key);
+            usize const index = _free_slot(hash);
+            if (m_ctrl[index] == FLATMAP_EMPTY) --m_growth_left;
+            m_ctrl[index] = _h2(hash);
+            m_slots[index] = { key, value };
+            ++m_size;
+            return &m_slots[index].value;
+        }
+
+        /*
+         * Removes `key`, returning false if it wasn't there.
+         */
+        auto erase(K const& key) -> bool {
+            usize const index = _find(key);
+            if (index == FLATMAP_NONE) return false;
+
+            FlatGroup const g(m_ctrl + (index & ~(FLATMAP_GROUP - 1)));
+            // No probe has gone past a group that was never full
+            if (g.match_empty().any()) {
+                m_ctrl[index] = FLATMAP_EMPTY;
+                ++m_growth_left;
+            } else {
+                m_ctrl[index] = FLATMAP_DELETED;
+            }
+            --m_size;
+            return true;
+        }
+
+        // Calls `fn(K const&, V&)` for every entry, in no particular order
+        template <class F> void for_each(F &&fn) {
+            usize const slots = m_ctrl == nullptr ? 0 : (m_mask + 1) * FLATMAP_GROUP;
+            for (usize i = 0; i < slots; ++i)
+                if (m_ctrl[i] < FLATMAP_EMPTY) fn(static_cast<K const&>(m_slots[i].key), m_slots[i].value);
+        }
+
+        // Removes every entry, keeping the table
+        void clear(void) {
+            if (m_ctrl == nullptr) return;
+            usize const slots = (m_mask + 1) * FLATMAP_GROUP;
+            std::memset(m_ctrl, FLATMAP_EMPTY, slots);
+            m_size = 0;
+            m_growth_left = _max_load(slots);
+        }
+
+        /*
+         * Grows the table to hold `count` entries without growing again.
+         * Returns false if the table couldn't be allocated.
+         */
+        auto reserve(usize const count) -> bool {
+            usize groups = 1;
+            while (_max_load(groups * FLATMAP_GROUP) < count) groups <<= 1;
+            if (m_ctrl != nullptr && groups <= m_mask + 1) return true;
+            return _rehash(groups);
+        }
+
+        auto size(void) -> usize { return m_size; }
+        auto empty(void) -> bool { return m_size == 0; }
+        auto capacity(void) -> usize { return m_ctrl == nullptr ? 0 : (m_mask + 1) * FLATMAP_GROUP; }
+
+    private:
+        struct Slot {
+            K key;
+            V value;
+        };
+
+        static auto _h1(u64 const hash) -> usize { return static_cast<usize>(hash >> 7); }
+        static auto _h2(u64 const hash) -> u8 { return static_cast<u8>(hash & 0x7f); }
+
+        // Most entries a table of `slots` holds, seven eighths
+        static auto _max_load(usize const slots) -> usize { return slots - slots / 8; }
+
+        // The slot holding `key`, or `FLATMAP_NONE`
+        auto _find(K const& key) -> usize {
+            if (m_ctrl == nullptr) return FLATMAP_NONE;
+            u64 const hash = m_hash(key);
+            u8 const h2 = _h2(hash);
+            usize group = _h1(hash) & m_mask;
+
+            for (usize step = 1;; ++step) {
+                FlatGroup const g(m_ctrl + group * FLATMAP_GROUP);
+                for (FlatMatch m = g.match(h2); m.any(); m.next()) {
+                    usize const index = group * FLATMAP_GROUP + m.first();
+                    if (m_slots[index].key == key) return index;
+                }
+                if (g.match_empty().any()) return FLATMAP_NONE;
+                group = (group + step) & m_mask;
+            }
+        }
+
+        // The first empty or deleted slot on a hash's probe path
+        auto _free_slot(u64 const hash) -> usize {
+            usize group = _h1(hash) & m_mask;
+            for (usize step = 1;; ++step) {
+                FlatMatch const m = FlatGroup(m_ctrl + group * FLATMAP_GROUP).match_free();
+                if (m.any()) return group * FLATMAP_GROUP + m.first();
+                group = (group + step) & m_mask;
+            }
+        }
+
+        /*
+         * Makes room for one more entry: rehashing in place to the same size
+         * when tombstones take up much of the table, doubling otherwise.
+         */
+        auto _grow(void) -> bool {
+            if (m_ctrl == nullptr) return _rehash(1);
+            usize const groups = m_mask + 1;
+            usize const tombstones = _max_load(groups * FLATMAP_GROUP) - m_size - m_growth_left;
+            return _rehash(tombstones * 2 > m_size ? groups : groups * 2);
+        }
+
+        auto _rehash(usize const groups) -> bool {
+            usize const slots = groups * FLATMAP_GROUP;
+            u8 *const ctrl = reinterpret_cast<u8 *>(_allocate(slots, 1));
+            Slot *const table = reinterpret_cast<Slot *>(_allocate(slots * sizeof(Slot), alignof(Slot)));
+            if (ctrl == nullptr || table == nullptr) {
+                if (m_arena == nullptr) {
+                    std::free(ctrl);
+                    std::free(table);
+                }
+                return false;
+            }
+            std::memset(ctrl, FLATMAP_EMPTY, slots);
+
+            u8 *const old_ctrl = m_ctrl;
+            Slot *const old_slots = m_slots;
+            usize const old_count = m_ctrl == nullptr ? 0 : (m_mask + 1) * FLATMAP_GROUP;
+
+            m_ctrl = ctrl;
+            m_slots = table;
+            m_mask = groups - 1;
+            m_growth_left = _max_load(slots) - m_size;
+
+            for (usize i = 0; i < old_count; ++i) {
+                if (old_ctrl[i] >= FLATMAP_EMPTY) continue;
+                u64 const hash = m_hash(old_slots[i].key);
+                usize const index = _free_slot(hash);
+                m_ctrl[index] = _h2(hash);
+                m_slots[index] = old_slots[i];
+            }
+
+            if (m_arena == nullptr) {
+                std::free(old_ctrl);
+                std::free(old_slots);
+            }
+            return true;
+        }
+
+        auto _allocate(usize const size, usize const align) -> ptr {
+            if (m_arena != nullptr) return m_arena->allocate(size, align);
+            return std::malloc(size);
+        }
+
+        void _free(void) {
+            if (m_arena != nullptr) return;
+            std::free(m_ctrl);
+            std::free(m_slots);
+        }
+
+        FrameArena *m_arena;
+        [[no_unique_address]] H m_hash;
+
+        // A control byte per slot, then the slots
+        u8 *m_ctrl;
+        Slot *m_slots;
+
+        // Groups less one, a power of two less one
+        usize m_mask;
+        usize m_size;
+
+        // Empty slots that can still be filled before the table must grow
+        usize m_growth_left;
+    };
+}
+
+#endif
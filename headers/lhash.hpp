@@ -0,0 +1,32 @@
+#ifndef LHASH_HPP
+#define LHASH_HPP
+
+#include "ldata.h"
+
+namespace llib {
+    constexpr u64 FNV_OFFSET = 0xcbf29ce484222325ull;
+    constexpr u64 FNV_PRIME = 0x100000001b3ull;
+
+    /*
+     * Hashes `length` bytes of a name with 64 bit FNV-1a. Usable in constant
+     * expressions, so names written in code can be hashed at compile time and
+     * match names hashed at run time or by tools.
+     */
+    constexpr auto hash_name(char const *const name, usize const length) -> u64 {
+        u64 h = FNV_OFFSET;
+        for (usize i = 0; i < length; ++i) {
+            h ^= static_cast<u8>(name[i]);
+            h *= FNV_PRIME;
+        }
+        return h;
+    }
+
+    // Hashes a null terminated name
+    constexpr auto hash_name(char const *const name) -> u64 {
+        usize length = 0;
+        while (name[length] != '\0') ++length;
+        return hash_name(name, length);
+    }
+}
+
+#endif
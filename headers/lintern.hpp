@@ -0,0 +1,132 @@
+#ifndef LINTERN_HPP
+#define LINTERN_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include "ldata.h"
+#include "larena.hpp"
+#include "lhash.hpp"
+
+namespace llib {
+    // Returned for names that aren't in the table
+    constexpr u32 NAME_NONE = ~0u;
+
+    /*
+     * The name table, interning strings as dense 32 bit ids.
+     *
+     * A string is hashed and copied once, when it is interned, into a frame
+     * arena that is never reset, so the chunks of text stay put and `str`
+     * pointers live as long as the table. Ids count up from zero, so anything
+     * keyed by name can be a plain array indexed by id.
+     *
+     * The table is open addressed on the 64 bit `hash_name` of each string
+     * and interning refuses a string whose hash is already taken by another,
+     * so a hash names at most one id. That lets `find` take a precomputed
+     * hash, including one computed at compile time, and resolve it with
+     * integer compares alone.
+     */
+    struct NameTable {
+        NameTable(void) = delete;
+        NameTable(NameTable const&) = delete;
+        NameTable operator=(NameTable&) = delete;
+
+        /*
+         * - max_names is the most strings the table holds
+         * - block_size and max_blocks size the text arena, and block_size
+         *   bounds the longest string
+         */
+        NameTable(usize const max_names, usize const block_size, usize const max_blocks):
+            m_text(block_size, max_blocks)
+        {
+            m_max_names = max_names;
+            m_count = 0;
+            m_strings = reinterpret_cast<char const **>(std::malloc(max_names * sizeof(ptr)));
+            m_lengths = reinterpret_cast<u32 *>(std::malloc(max_names * sizeof(u32)));
+            m_hashes = reinterpret_cast<u64 *>(std::malloc(max_names * sizeof(u64)));
+
+            // At most half full, so probes stay short
+            m_mask = 1;
+            while (m_mask < max_names * 2) m_mask <<= 1;
+            m_slots = reinterpret_cast<u32 *>(std::malloc(m_mask * sizeof(u32)));
+            for (usize i = 0; i < m_mask; ++i) m_slots[i] = NAME_NONE;
+            --m_mask;
+        }
+
+        ~NameTable(void) {
+            std::free(m_strings);
+            std::free(m_lengths);
+            std::free(m_hashes);
+            std::free(m_slots);
+        }
+
+        /*
+         * Returns the id of a string, adding it if it's new. Returns
+         * `NAME_NONE` if the table or arena is full, or if a different string
+         * already has the same hash.
+         */
+        auto intern(char const *const name, usize const length) -> u32 {
+            u64 const hash = hash_name(name, length);
+            usize slot = _slot(hash);
+            u32 const found = m_slots[slot];
+            if (found != NAME_NONE) {
+                bool const same = m_lengths[found] == length && std::memcmp(m_strings[found], name, length) == 0;
+                return same ? found : NAME_NONE;
+            }
+            if (m_count == m_max_names) return NAME_NONE;
+
+            char *const text = reinterpret_cast<char *>(m_text.allocate(length + 1, 1));
+            if (text == nullptr) return NAME_NONE;
+            std::memcpy(text, name, length);
+            text[length] = '\0';
+
+            u32 const id = static_cast<u32>(m_count++);
+            m_strings[id] = text;
+            m_lengths[id] = static_cast<u32>(length);
+            m_hashes[id] = hash;
+            m_slots[slot] = id;
+            return id;
+        }
+
+        auto intern(char const *const name) -> u32 { return intern(name, std::strlen(name)); }
+
+        // The id of the string with a given `hash_name`, or `NAME_NONE`
+        auto find(u64 const hash) -> u32 { return m_slots[_slot(hash)]; }
+
+        // The id of an interned string, or `NAME_NONE`, without adding it
+        auto find(char const *const name) -> u32 { return find(hash_name(name)); }
+
+        // The interned text of an id, null terminated
+        auto str(u32 const id) -> char const* { return m_strings[id]; }
+        auto length(u32 const id) -> usize { return m_lengths[id]; }
+        auto hash(u32 const id) -> u64 { return m_hashes[id]; }
+
+        // Number of strings interned, and one past the largest id
+        auto count(void) -> usize { return m_count; }
+
+    private:
+        // The slot holding `hash`, or the empty slot where it would go
+        auto _slot(u64 const hash) -> usize {
+            usize slot = static_cast<usize>(hash) & m_mask;
+            for (;;) {
+                u32 const id = m_slots[slot];
+                if (id == NAME_NONE || m_hashes[id] == hash) return slot;
+                slot = (slot + 1) & m_mask;
+            }
+        }
+
+        FrameArena m_text;
+        usize m_max_names;
+        usize m_count;
+
+        // Per id, indexed by id
+        char const **m_strings;
+        u32 *m_lengths;
+        u64 *m_hashes;
+
+        // Ids by hash, linearly probed, `NAME_NONE` where empty
+        u32 *m_slots;
+        usize m_mask;
+    };
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef LJOBS_HPP
+#define LJOBS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include "ldata.h"
+
+namespace llib {
+    // Most worker threads a job pool will start
+    constexpr usize LJOBS_MAX_WORKERS = 64;
+
+    /*
+     * The job pool, a fixed set of worker threads for splitting one loop
+     * across cores.
+     *
+     * Work is handed out as task indices from an atomic counter, and the
+     * calling thread takes tasks too, so `parallel_for` with no workers simply
+     * runs every task in place. Tasks are passed as a function pointer and a
+     * context pointer, so starting a loop never allocates.
+     */
+    struct JobPool {
+        JobPool(JobPool const&) = delete;
+        JobPool operator=(JobPool&) = delete;
+
+        /*
+         * Starts `workers` threads, zero meaning one per hardware thread
+         * besides the caller.
+         */
+        JobPool(usize const workers = 0) {
+            usize count = workers;
+            if (count == 0) {
+                usize const hardware = std::thread::hardware_concurrency();
+                count = hardware > 1 ? hardware - 1 : 0;
+            }
+            if (count > LJOBS_MAX_WORKERS) count = LJOBS_MAX_WORKERS;
+
+            m_worker_count = count;
+            m_generation = 0;
+            m_stopping = false;
+            m_run = nullptr;
+            m_context = nullptr;
+            m_task_count = 0;
+            m_next_task.store(0);
+            m_busy.store(0);
+
+            for (usize i = 0; i < m_worker_count; ++i)
+                m_workers[i] = std::thread([this] { _work(); });
+        }
+
+        /*
+         * Stops and joins every worker.
+         */
+        ~JobPool(void) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+                ++m_generation;
+            }
+            m_wake.notify_all();
+            for (usize i = 0; i < m_worker_count; ++i) m_workers[i].join();
+        }
+
+        /*
+         * Runs `fn(usize task)` for every task in [0, `tasks`), returning once
+         * all of them are done.
+         */
+        template <class F> void parallel_for(usize const tasks, F &&fn) {
+            if (tasks == 0) return;
+            if (m_worker_count == 0 || tasks == 1) {
+                for (usize t = 0; t < tasks; ++t) fn(t);
+                return;
+            }
+
+            using Fn = std::remove_reference_t<F>;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_run = [](ptr const context, usize const task) { (*reinterpret_cast<Fn *>(context))(task); };
+                m_context = const_cast<ptr>(reinterpret_cast<void const *>(&fn));
+                m_task_count = tasks;
+                m_next_task.store(0);
+                m_busy.store(m_worker_count);
+                ++m_generation;
+            }
+            m_wake.notify_all();
+
+            _drain();
+
+            // Wait for workers still finishing their last task.
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return m_busy.load() == 0; });
+        }
+
+        // Threads that run tasks, including the caller
+        auto thread_count(void) -> usize { return m_worker_count + 1; }
+
+    private:
+        void _work(void) {
+            u64 seen = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wake.wait(lock, [&] { return m_generation != seen; });
+                    seen = m_generation;
+                    if (m_stopping) return;
+                }
+
+                _drain();
+
+                if (m_busy.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_done.notify_one();
+                }
+            }
+        }
+
+        // Takes tasks until there are none left
+        void _drain(void) {
+            for (;;) {
+                usize const task = m_next_task.fetch_add(1);
+                if (task >= m_task_count) return;
+                m_run(m_context, task);
+            }
+        }
+
+        std::thread m_workers[LJOBS_MAX_WORKERS];
+        usize m_worker_count;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        u64 m_generation;
+        bool m_stopping;
+
+        // The loop being run
+        void (*m_run)(ptr context, usize task);
+        ptr m_context;
+        usize m_task_count;
+        std::atomic<usize> m_next_task;
+        std::atomic<usize> m_busy;
+    };
+}
+
+#endif
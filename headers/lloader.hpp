@@ -0,0 +1,529 @@
+#ifndef LLOADER_HPP
+#define LLOADER_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "ldata.h"
+#include "lassets.hpp"
+#include "lpool.hpp"
+
+namespace llib {
+    // Most blocking I/O workers the fallback backend will start
+    constexpr usize LLOADER_MAX_WORKERS = 16;
+
+    // Slots in each block of the loader's slot pool
+    constexpr usize LLOADER_SLOTS_PER_BLOCK = 64;
+
+    // Opcodes asked about when probing io_uring, every value an opcode can take
+    constexpr usize LLOADER_PROBE_OPS = 256;
+
+    /*
+     * Which loads go first. Queued loads are handed to the backend highest
+     * class first, so a burst of background streaming never delays a load
+     * the game is waiting on.
+     */
+    enum LoadPriority : u8 {
+        // Needed this frame, the game is waiting on it
+        LOAD_CRITICAL,
+        // Needed soon, such as the next area's assets
+        LOAD_NORMAL,
+        // Speculative, such as prefetching a level
+        LOAD_BACKGROUND,
+        LOAD_PRIORITIES
+    };
+
+    enum LoadState : u8 {
+        // Waiting on the game thread to be handed to the backend
+        LOAD_QUEUED,
+        // With the backend
+        LOAD_READING,
+        LOAD_DONE,
+        LOAD_FAILED
+    };
+
+    // A load and the buffer it reads into
+    struct LoadSlot {
+        u8 *data;
+        usize size;
+        // Bytes read so far
+        usize done;
+        u64 offset;
+        int fd;
+        // The errno of a failed load, `ENODATA` if the file ended early
+        i32 error;
+        // Left to the caller, such as an asset hash
+        u64 user;
+        u8 priority;
+        u8 state;
+
+        // Result of the last read, set by the backend
+        isize result;
+
+        // Next slot in whichever queue holds it
+        LoadSlot *next;
+    };
+
+    /*
+     * The asynchronous loader, reading byte ranges of files into buffers off
+     * the game thread.
+     *
+     * Loads are read through io_uring when the kernel allows it and supports
+     * its read opcode, with a thread that waits on the completion ring, and
+     * otherwise through a pool of workers calling `pread`. The game thread queues loads with `request`,
+     * hands queued loads to the backend by priority with `pump`, keeping at
+     * most `max_in_flight` with it, and collects finished loads with `poll`.
+     * Finished loads come back through a lock-free stack that the game thread
+     * empties in one exchange, so neither backend ever takes a lock the game
+     * thread waits on.
+     *
+     * Slots come from a pool allocator and buffers are allocated to size;
+     * both stay the caller's until `release`.
+     */
+    struct AsyncLoader {
+        AsyncLoader(void) = delete;
+        AsyncLoader(AsyncLoader const&) = delete;
+        AsyncLoader operator=(AsyncLoader&) = delete;
+
+        /*
+         * - max_slots is the most loads queued, reading or unreleased at once
+         * - max_in_flight is the most loads with the backend at once
+         * - workers is the number of fallback threads, used only without
+         *   io_uring
+         * - use_uring can turn io_uring off to force the fallback
+         */
+        AsyncLoader(usize const max_slots, usize const max_in_flight, usize const workers, bool const use_uring = true):
+            m_slots(LLOADER_SLOTS_PER_BLOCK, (max_slots + LLOADER_SLOTS_PER_BLOCK - 1) / LLOADER_SLOTS_PER_BLOCK)
+        {
+            m_max_slots = max_slots;
+            m_slot_count = 0;
+            m_max_in_flight = max_in_flight > 0 ? max_in_flight : 1;
+            m_in_flight = 0;
+            m_queued = 0;
+            for (usize p = 0; p < LOAD_PRIORITIES; ++p) {
+                m_pending_head[p] = nullptr;
+                m_pending_tail[p] = nullptr;
+            }
+            m_finished.store(nullptr);
+
+            m_ring_fd = -1;
+            m_stopping = false;
+            m_work_head = nullptr;
+            m_work_tail = nullptr;
+            m_worker_count = 0;
+
+            if (use_uring && _ring_setup()) {
+                m_workers[0] = std::thread([this] { _reap_loop(); });
+                return;
+            }
+
+            m_worker_count = workers > 0 ? workers : 1;
+            if (m_worker_count > LLOADER_MAX_WORKERS) m_worker_count = LLOADER_MAX_WORKERS;
+            for (usize i = 0; i < m_worker_count; ++i)
+                m_workers[i] = std::thread([this] { _work_loop(); });
+        }
+
+        /*
+         * Waits for loads with the backend, dropping them, then stops it.
+         * Queued loads are dropped too.
+         */
+        ~AsyncLoader(void) {
+            while (m_in_flight > 0) {
+                poll([this](LoadSlot &slot) { release(&slot); });
+                std::this_thread::yield();
+            }
+
+            if (m_ring_fd >= 0) {
+                // A no-op with no slot tells the reaper to stop. If the ring
+                // won't take even that, the reaper is left waiting on it, so
+                // the ring stays mapped.
+                if (_ring_submit(nullptr)) {
+                    m_workers[0].join();
+                    _ring_teardown();
+                } else {
+                    m_workers[0].detach();
+                }
+            } else {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_stopping = true;
+                }
+                m_wake.notify_all();
+                for (usize i = 0; i < m_worker_count; ++i) m_workers[i].join();
+            }
+
+            for (usize p = 0; p < LOAD_PRIORITIES; ++p)
+                for (LoadSlot *s = m_pending_head[p]; s != nullptr; s = s->next) std::free(s->data);
+        }
+
+        // Whether loads go through io_uring rather than the worker pool
+        auto using_uring(void) -> bool { return m_ring_fd >= 0; }
+
+        /*
+         * Queues a load of `size` bytes at `offset` in `fd`. Returns
+         * `nullptr` if every slot is taken or the buffer can't be allocated.
+         * `fd` must stay open until the load is polled.
+         */
+        auto request(int const fd, u64 const offset, usize const size, LoadPriority const priority, u64 const user) -> LoadSlot* {
+            if (m_slot_count == m_max_slots) return nullptr;
+            LoadSlot *const s = m_slots.allocate();
+            if (s == nullptr) return nullptr;
+            u8 *const data = reinterpret_cast<u8 *>(std::malloc(size > 0 ? size : 1));
+            if (data == nullptr) {
+                m_slots.deallocate(s);
+                return nullptr;
+            }
+
+            *s = { data, size, 0, offset, fd, 0, user, priority, LOAD_QUEUED, 0, nullptr };
+            ++m_slot_count;
+            _enqueue(s, false);
+            return s;
+        }
+
+        // Queues a load of an asset pack entry's payload from the pack's file
+        auto request(int const fd, AssetEntry const& entry, LoadPriority const priority) -> LoadSlot* {
+            return request(fd, entry.offset, static_cast<usize>(entry.size), priority, entry.hash);
+        }
+
+        /*
+         * Hands queued loads to the backend, most urgent first, until
+         * `max_in_flight` are with it. Returns how many were handed over.
+         */
+        auto pump(void) -> usize {
+            usize submitted = 0;
+            for (usize p = 0; p < LOAD_PRIORITIES && m_in_flight < m_max_in_flight; ++p) {
+                while (m_pending_head[p] != nullptr && m_in_flight < m_max_in_flight) {
+                    LoadSlot *const s = m_pending_head[p];
+                    m_pending_head[p] = s->next;
+                    if (m_pending_head[p] == nullptr) m_pending_tail[p] = nullptr;
+                    --m_queued;
+
+                    s->state = LOAD_READING;
+                    s->next = nullptr;
+                    ++m_in_flight;
+                    ++submitted;
+                    if (m_ring_fd >= 0) _ring_submit(s);
+                    else _work_push(s);
+                }
+            }
+            if (submitted > 0 && m_ring_fd >= 0) _ring_enter(submitted);
+            return submitted;
+        }
+
+        /*
+         * Collects loads the backend has finished and calls `fn(LoadSlot&)`
+         * for each one that is done or failed, in the order they finished.
+         * Short reads are queued again for the rest, ahead of their class.
+         * Returns how many were passed to `fn`.
+         */
+        template <class F> auto poll(F &&fn) -> usize {
+            LoadSlot *s = m_finished.exchange(nullptr, std::memory_order_acquire);
+
+            // The stack comes out newest first
+            LoadSlot *ordered = nullptr;
+            while (s != nullptr) {
+                LoadSlot *const next = s->next;
+                s->next = ordered;
+                ordered = s;
+                s = next;
+            }
+
+            usize count = 0;
+            while (ordered != nullptr) {
+                LoadSlot *const slot = ordered;
+                ordered = ordered->next;
+                slot->next = nullptr;
+                --m_in_flight;
+
+                if (slot->result < 0) {
+                    slot->state = LOAD_FAILED;
+                    slot->error = static_cast<i32>(-slot->result);
+                } else if (slot->result == 0 && slot->done < slot->size) {
+                    slot->state = LOAD_FAILED;
+                    slot->error = ENODATA;
+                } else if (slot->done < slot->size) {
+                    _enqueue(slot, true);
+                    continue;
+                } else {
+                    slot->state = LOAD_DONE;
+                }
+                fn(*slot);
+                ++count;
+            }
+            return count;
+        }
+
+        // Frees a polled slot and its buffer
+        void release(LoadSlot *const slot) {
+            std::free(slot->data);
+            m_slots.deallocate(slot);
+            --m_slot_count;
+        }
+
+        // Loads queued or with the backend
+        auto pending(void) -> usize { return m_queued + m_in_flight; }
+
+    private:
+        void _enqueue(LoadSlot *const s, bool const front) {
+            s->state = LOAD_QUEUED;
+            ++m_queued;
+            if (front) {
+                s->next = m_pending_head[s->priority];
+                m_pending_head[s->priority] = s;
+                if (m_pending_tail[s->priority] == nullptr) m_pending_tail[s->priority] = s;
+                return;
+            }
+            s->next = nullptr;
+            if (m_pending_tail[s->priority] != nullptr) m_pending_tail[s->priority]->next = s;
+            else m_pending_head[s->priority] = s;
+            m_pending_tail[s->priority] = s;
+        }
+
+        // Hands a finished read to the game thread, from any thread
+        void _finish(LoadSlot *const s, isize const result) {
+            s->result = result;
+            if (result > 0) s->done += static_cast<usize>(result);
+            LoadSlot *head = m_finished.load(std::memory_order_relaxed);
+            do s->next = head;
+            while (!m_finished.compare_exchange_weak(head, s, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        /*
+         * io_uring, through the raw system calls. The game thread is the only
+         * producer on the submission ring and the reaper thread the only
+         * consumer on the completion ring, so each ring index has a single
+         * writer. A ring that can't read, on kernels before `IORING_OP_READ`,
+         * is closed again so the worker pool is used instead.
+         */
+        auto _ring_setup(void) -> bool {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            // Room for every load in flight plus the stop no-op
+            u32 const entries = static_cast<u32>(m_max_in_flight + 1);
+            int const fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0) return false;
+
+            m_sq_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+            m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool const single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single) m_sq_size = m_cq_size = m_sq_size > m_cq_size ? m_sq_size : m_cq_size;
+
+            ptr const sq = ::mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            ptr const cq = single || sq == MAP_FAILED ? sq
+                : ::mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            m_sqe_size = params.sq_entries * sizeof(io_uring_sqe);
+            ptr const sqes = cq == MAP_FAILED ? MAP_FAILED
+                : ::mmap(nullptr, m_sqe_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+            if (sqes == MAP_FAILED) {
+                if (cq != MAP_FAILED && cq != sq) ::munmap(cq, m_cq_size);
+                if (sq != MAP_FAILED) ::munmap(sq, m_sq_size);
+                ::close(fd);
+                return false;
+            }
+
+            u8 *const sq_base = reinterpret_cast<u8 *>(sq);
+            u8 *const cq_base = reinterpret_cast<u8 *>(cq);
+            m_sq_ring = sq;
+            m_cq_ring = cq;
+            m_sq_head = reinterpret_cast<u32 *>(sq_base + params.sq_off.head);
+            m_sq_tail = reinterpret_cast<u32 *>(sq_base + params.sq_off.tail);
+            m_sq_mask = *reinterpret_cast<u32 *>(sq_base + params.sq_off.ring_mask);
+            m_sq_array = reinterpret_cast<u32 *>(sq_base + params.sq_off.array);
+            m_cq_head = reinterpret_cast<u32 *>(cq_base + params.cq_off.head);
+            m_cq_tail = reinterpret_cast<u32 *>(cq_base + params.cq_off.tail);
+            m_cq_mask = *reinterpret_cast<u32 *>(cq_base + params.cq_off.ring_mask);
+            m_cqes = reinterpret_cast<io_uring_cqe *>(cq_base + params.cq_off.cqes);
+            m_sqes = reinterpret_cast<io_uring_sqe *>(sqes);
+            m_ring_fd = fd;
+
+            if (!_ring_can_read()) {
+                _ring_teardown();
+                m_ring_fd = -1;
+                return false;
+            }
+            return true;
+        }
+
+        // Asks the kernel whether the ring supports `IORING_OP_READ`
+        auto _ring_can_read(void) -> bool {
+            alignas(io_uring_probe) u8 memory[sizeof(io_uring_probe) + LLOADER_PROBE_OPS * sizeof(io_uring_probe_op)];
+            std::memset(memory, 0, sizeof(memory));
+            io_uring_probe *const probe = reinterpret_cast<io_uring_probe *>(memory);
+
+            // Kernels without the probe are older than the read opcode too
+            long const result = ::syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_PROBE, probe, LLOADER_PROBE_OPS);
+            if (result < 0 || probe->last_op < IORING_OP_READ || probe->ops_len <= IORING_OP_READ) return false;
+            return (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+        }
+
+        void _ring_teardown(void) {
+            ::munmap(m_sqes, m_sqe_size);
+            if (m_cq_ring != m_sq_ring) ::munmap(m_cq_ring, m_cq_size);
+            ::munmap(m_sq_ring, m_sq_size);
+            ::close(m_ring_fd);
+        }
+
+        /*
+         * Fills the next submission entry, a read of `s` or a no-op for
+         * `nullptr`. The no-op is submitted straight away, returning false if
+         * the ring wouldn't take it.
+         */
+        auto _ring_submit(LoadSlot *const s) -> bool {
+            u32 const tail = *m_sq_tail;
+            u32 const index = tail & m_sq_mask;
+            io_uring_sqe &sqe = m_sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            if (s != nullptr) {
+                sqe.opcode = IORING_OP_READ;
+                sqe.fd = s->fd;
+                sqe.off = s->offset + s->done;
+                sqe.addr = reinterpret_cast<u64>(s->data + s->done);
+                sqe.len = static_cast<u32>(s->size - s->done);
+            } else {
+                sqe.opcode = IORING_OP_NOP;
+            }
+            sqe.user_data = reinterpret_cast<u64>(s);
+            m_sq_array[index] = index;
+            std::atomic_ref<u32>(*m_sq_tail).store(tail + 1, std::memory_order_release);
+            return s != nullptr || _ring_enter(1);
+        }
+
+        /*
+         * Submits the last `count` filled entries. Entries the kernel refuses
+         * are taken back off the ring and their loads finish failed with the
+         * error, so they don't stay counted as in flight. Returns false if any
+         * were refused.
+         */
+        auto _ring_enter(usize count) -> bool {
+            while (count > 0) {
+                long const taken = ::syscall(__NR_io_uring_enter, m_ring_fd, static_cast<u32>(count), 0u, 0u, nullptr, 0);
+                if (taken > 0) {
+                    count -= static_cast<usize>(taken) < count ? static_cast<usize>(taken) : count;
+                    continue;
+                }
+
+                // Busy while the reaper drains the completion ring
+                if (taken < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) {
+                    if (errno != EINTR) std::this_thread::yield();
+                    continue;
+                }
+
+                i32 const error = taken < 0 ? errno : EIO;
+                u32 const head = std::atomic_ref<u32>(*m_sq_head).load(std::memory_order_acquire);
+                u32 const tail = *m_sq_tail;
+                for (u32 i = head; i != tail; ++i) {
+                    LoadSlot *const s = reinterpret_cast<LoadSlot *>(m_sqes[m_sq_array[i & m_sq_mask]].user_data);
+                    if (s != nullptr) _finish(s, -error);
+                }
+                std::atomic_ref<u32>(*m_sq_tail).store(head, std::memory_order_release);
+                return false;
+            }
+            return true;
+        }
+
+        void _reap_loop(void) {
+            for (;;) {
+                u32 const head = *m_cq_head;
+                if (head == std::atomic_ref<u32>(*m_cq_tail).load(std::memory_order_acquire)) {
+                    ::syscall(__NR_io_uring_enter, m_ring_fd, 0u, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+                    continue;
+                }
+
+                io_uring_cqe const& cqe = m_cqes[head & m_cq_mask];
+                LoadSlot *const s = reinterpret_cast<LoadSlot *>(cqe.user_data);
+                isize const result = cqe.res;
+                std::atomic_ref<u32>(*m_cq_head).store(head + 1, std::memory_order_release);
+
+                if (s == nullptr) return;
+                _finish(s, result);
+            }
+        }
+
+        // The blocking fallback
+        void _work_push(LoadSlot *const s) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_work_tail != nullptr) m_work_tail->next = s;
+                else m_work_head = s;
+                m_work_tail = s;
+            }
+            m_wake.notify_one();
+        }
+
+        void _work_loop(void) {
+            for (;;) {
+                LoadSlot *s;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wake.wait(lock, [this] { return m_work_head != nullptr || m_stopping; });
+                    if (m_work_head == nullptr) return;
+                    s = m_work_head;
+                    m_work_head = s->next;
+                    if (m_work_head == nullptr) m_work_tail = nullptr;
+                }
+
+                isize result = 0;
+                usize done = 0;
+                while (s->done + done < s->size) {
+                    result = ::pread(s->fd, s->data + s->done + done, s->size - s->done - done, static_cast<off_t>(s->offset + s->done + done));
+                    if (result < 0 && errno == EINTR) continue;
+                    if (result <= 0) break;
+                    done += static_cast<usize>(result);
+                }
+                // Report the whole read, or the error that cut it short
+                _finish(s, result < 0 ? -errno : static_cast<isize>(done));
+            }
+        }
+
+        PoolAllocator<LoadSlot> m_slots;
+        usize m_max_slots;
+        usize m_slot_count;
+
+        // Game thread only
+        usize m_max_in_flight;
+        usize m_in_flight;
+        usize m_queued;
+        LoadSlot *m_pending_head[LOAD_PRIORITIES];
+        LoadSlot *m_pending_tail[LOAD_PRIORITIES];
+
+        // Finished loads, pushed by the backend and taken by `poll`
+        std::atomic<LoadSlot *> m_finished;
+
+        int m_ring_fd;
+        ptr m_sq_ring;
+        ptr m_cq_ring;
+        usize m_sq_size;
+        usize m_cq_size;
+        usize m_sqe_size;
+        u32 *m_sq_head;
+        u32 *m_sq_tail;
+        u32 m_sq_mask;
+        u32 *m_sq_array;
+        u32 *m_cq_head;
+        u32 *m_cq_tail;
+        u32 m_cq_mask;
+        io_uring_cqe *m_cqes;
+        io_uring_sqe *m_sqes;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        LoadSlot *m_work_head;
+        LoadSlot *m_work_tail;
+        bool m_stopping;
+
+        // The reaper thread with io_uring, otherwise the workers
+        std::thread m_workers[LLOADER_MAX_WORKERS];
+        usize m_worker_count;
+    };
+}
+
+#endif
@@ -0,0 +1,396 @@
+#ifndef LMATH_HPP
+#define LMATH_HPP
+
+#include <bit>
+#include <cmath>
+#include "ldata.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define LMATH_AVX 1
+#endif
+
+/*
+ * 2D math: `vec2` and `mat2x3`, rotation by complex multiply, and fast
+ * approximate trig and `rsqrt` in scalar and 8 wide forms.
+ *
+ * The 8 wide types use AVX2 and FMA when the build enables them
+ * (`-mavx2 -mfma` or `-march=native`), and otherwise plain 8 lane loops the
+ * compiler vectorises as it can, so the same code builds everywhere.
+ *
+ * Error bounds of the approximations, measured against `double` precision
+ * over the stated range:
+ *
+ * | function      | range              | max error            |
+ * |---------------|--------------------|----------------------|
+ * | `fast_sin`    | abs(x) <= 8192     | 1.5e-7 absolute      |
+ * | `fast_cos`    | abs(x) <= 8192     | 1.5e-7 absolute      |
+ * | `fast_atan2`  | every finite input | 2e-6 radians         |
+ * | `fast_rsqrt`  | normal x > 0       | 5e-7 relative        |
+ *
+ * `fast_atan2` ignores the sign of zero, so `fast_atan2(-0, -1)` is PI.
+ *
+ * Trig error grows with abs(x) beyond that, as the range reduction loses
+ * bits, so wrap long running angles instead of letting them climb.
+ */
+namespace llib {
+    constexpr f32 PI = 3.14159265358979323846f;
+    constexpr f32 TAU = 6.28318530717958647692f;
+    constexpr f32 HALF_PI = 1.57079632679489661923f;
+
+    /*        Vectors        */
+
+    // A 2D vector, which doubles as a complex number for rotations
+    struct vec2 {
+        f32 x, y;
+    };
+
+    constexpr auto operator+(vec2 const a, vec2 const b) -> vec2 { return { a.x + b.x, a.y + b.y }; }
+    constexpr auto operator-(vec2 const a, vec2 const b) -> vec2 { return { a.x - b.x, a.y - b.y }; }
+    constexpr auto operator-(vec2 const a) -> vec2 { return { -a.x, -a.y }; }
+    constexpr auto operator*(vec2 const a, f32 const s) -> vec2 { return { a.x * s, a.y * s }; }
+    constexpr auto operator*(f32 const s, vec2 const a) -> vec2 { return { a.x * s, a.y * s }; }
+    constexpr auto operator/(vec2 const a, f32 const s) -> vec2 { return { a.x / s, a.y / s }; }
+    constexpr auto operator+=(vec2 &a, vec2 const b) -> vec2& { a.x += b.x; a.y += b.y; return a; }
+    constexpr auto operator-=(vec2 &a, vec2 const b) -> vec2& { a.x -= b.x; a.y -= b.y; return a; }
+    constexpr auto operator*=(vec2 &a, f32 const s) -> vec2& { a.x *= s; a.y *= s; return a; }
+    constexpr auto operator==(vec2 const a, vec2 const b) -> bool { return a.x == b.x && a.y == b.y; }
+
+    constexpr auto dot(vec2 const a, vec2 const b) -> f32 { return a.x * b.x + a.y * b.y; }
+
+    // Z of the 3D cross product, positive when `b` is anticlockwise of `a`
+    constexpr auto cross(vec2 const a, vec2 const b) -> f32 { return a.x * b.y - a.y * b.x; }
+
+    // `a` turned a quarter anticlockwise
+    constexpr auto perp(vec2 const a) -> vec2 { return { -a.y, a.x }; }
+
+    constexpr auto lerp(vec2 const a, vec2 const b, f32 const t) -> vec2 { return a + (b - a) * t; }
+    constexpr auto length_sq(vec2 const a) -> f32 { return dot(a, a); }
+    inline auto length(vec2 const a) -> f32 { return std::sqrt(dot(a, a)); }
+
+    /*        Rotation       */
+
+    // Complex product, composing two rotations or rotating `a` by unit `b`
+    constexpr auto cmul(vec2 const a, vec2 const b) -> vec2 {
+        return { a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x };
+    }
+
+    // Complex conjugate, the inverse of a unit rotation
+    constexpr auto cconj(vec2 const a) -> vec2 { return { a.x, -a.y }; }
+
+    // Rotates `v` by the unit complex number `r`
+    constexpr auto rotate(vec2 const v, vec2 const r) -> vec2 { return cmul(v, r); }
+
+    /*     Affine 2x3 matrix    */
+
+    /*
+     * An affine transform, a 2x2 linear part and a translation:
+     *
+     * ```
+     * | a  b  tx |
+     * | c  d  ty |
+     * ```
+     */
+    struct mat2x3 {
+        f32 a, b, tx;
+        f32 c, d, ty;
+
+        static constexpr auto identity(void) -> mat2x3 { return { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f }; }
+        static constexpr auto translation(vec2 const t) -> mat2x3 { return { 1.0f, 0.0f, t.x, 0.0f, 1.0f, t.y }; }
+        static constexpr auto scaling(vec2 const s) -> mat2x3 { return { s.x, 0.0f, 0.0f, 0.0f, s.y, 0.0f }; }
+
+        // Rotation by the unit complex number `r`
+        static constexpr auto rotation(vec2 const r) -> mat2x3 { return { r.x, -r.y, 0.0f, r.y, r.x, 0.0f }; }
+
+        // Scales, then rotates by unit `r`, then translates
+        static constexpr auto transform(vec2 const t, vec2 const r, vec2 const s) -> mat2x3 {
+            return { r.x * s.x, -r.y * s.y, t.x, r.y * s.x, r.x * s.y, t.y };
+        }
+    };
+
+    // Composes `m` after `n`, so the result applies `n` first
+    constexpr auto operator*(mat2x3 const& m, mat2x3 const& n) -> mat2x3 {
+        return {
+            m.a * n.a + m.b * n.c, m.a * n.b + m.b * n.d, m.a * n.tx + m.b * n.ty + m.tx,
+            m.c * n.a + m.d * n.c, m.c * n.b + m.d * n.d, m.c * n.tx + m.d * n.ty + m.ty
+        };
+    }
+
+    constexpr auto transform_point(mat2x3 const& m, vec2 const p) -> vec2 {
+        return { m.a * p.x + m.b * p.y + m.tx, m.c * p.x + m.d * p.y + m.ty };
+    }
+
+    // Transforms a direction, ignoring the translation
+    constexpr auto transform_vector(mat2x3 const& m, vec2 const v) -> vec2 {
+        return { m.a * v.x + m.b * v.y, m.c * v.x + m.d * v.y };
+    }
+
+    // Inverse of an invertible transform
+    constexpr auto inverse(mat2x3 const& m) -> mat2x3 {
+        f32 const inv = 1.0f / (m.a * m.d - m.b * m.c);
+        f32 const a = m.d * inv, b = -m.b * inv, c = -m.c * inv, d = m.a * inv;
+        return { a, b, -(a * m.tx + b * m.ty), c, d, -(c * m.tx + d * m.ty) };
+    }
+
+    /*      8 wide floats     */
+
+#if defined(LMATH_AVX)
+    // Eight floats in one AVX register
+    struct f32x8 {
+        __m256 v;
+
+        f32x8(void) = default;
+        f32x8(__m256 const value): v(value) {}
+        f32x8(f32 const value): v(_mm256_set1_ps(value)) {}
+
+        static auto load(f32 const *const p) -> f32x8 { return _mm256_loadu_ps(p); }
+        void store(f32 *const p) const { _mm256_storeu_ps(p, v); }
+    };
+
+    // Eight lane mask from a comparison
+    struct mask8 {
+        __m256 v;
+    };
+
+    inline auto operator+(f32x8 const a, f32x8 const b) -> f32x8 { return _mm256_add_ps(a.v, b.v); }
+    inline auto operator-(f32x8 const a, f32x8 const b) -> f32x8 { return _mm256_sub_ps(a.v, b.v); }
+    inline auto operator*(f32x8 const a, f32x8 const b) -> f32x8 { return _mm256_mul_ps(a.v, b.v); }
+    inline auto operator/(f32x8 const a, f32x8 const b) -> f32x8 { return _mm256_div_ps(a.v, b.v); }
+    inline auto operator-(f32x8 const a) -> f32x8 { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+    inline auto operator<(f32x8 const a, f32x8 const b) -> mask8 { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+    inline auto operator>(f32x8 const a, f32x8 const b) -> mask8 { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+    inline auto operator==(f32x8 const a, f32x8 const b) -> mask8 { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+    inline auto operator&(mask8 const a, mask8 const b) -> mask8 { return { _mm256_and_ps(a.v, b.v) }; }
+    inline auto operator|(mask8 const a, mask8 const b) -> mask8 { return { _mm256_or_ps(a.v, b.v) }; }
+
+    // a * b + c
+    inline auto fmadd(f32x8 const a, f32x8 const b, f32x8 const c) -> f32x8 { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+    inline auto select(mask8 const m, f32x8 const a, f32x8 const b) -> f32x8 { return _mm256_blendv_ps(b.v, a.v, m.v); }
+    inline auto abs(f32x8 const a) -> f32x8 { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+    inline auto min(f32x8 const a, f32x8 const b) -> f32x8 { return _mm256_min_ps(a.v, b.v); }
+    inline auto max(f32x8 const a, f32x8 const b) -> f32x8 { return _mm256_max_ps(a.v, b.v); }
+    inline auto floor(f32x8 const a) -> f32x8 { return _mm256_floor_ps(a.v); }
+    inline auto sqrt(f32x8 const a) -> f32x8 { return _mm256_sqrt_ps(a.v); }
+#else
+    // Floor for abs(a) < 2^31 by truncating, as `std::floor` is a library
+    // call without SSE4.1
+    inline auto _floor_small(f32 const a) -> f32 {
+        f32 const t = static_cast<f32>(static_cast<i32>(a));
+        return t - static_cast<f32>(t > a);
+    }
+
+    // Eight floats, in lanes the compiler can vectorise
+    struct f32x8 {
+        f32 v[8];
+
+        f32x8(void) = default;
+        f32x8(f32 const value) { for (usize i = 0; i < 8; ++i) v[i] = value; }
+
+        static auto load(f32 const *const p) -> f32x8 {
+            f32x8 r;
+            for (usize i = 0; i < 8; ++i) r.v[i] = p[i];
+            return r;
+        }
+        void store(f32 *const p) const { for (usize i = 0; i < 8; ++i) p[i] = v[i]; }
+    };
+
+    // Eight lane mask from a comparison
+    struct mask8 {
+        u32 v[8];
+    };
+
+#define LMATH_LANES(type, expr) type r; for (usize i = 0; i < 8; ++i) r.v[i] = (expr); return r;
+
+    inline auto operator+(f32x8 const a, f32x8 const b) -> f32x8 { LMATH_LANES(f32x8, a.v[i] + b.v[i]) }
+    inline auto operator-(f32x8 const a, f32x8 const b) -> f32x8 { LMATH_LANES(f32x8, a.v[i] - b.v[i]) }
+    inline auto operator*(f32x8 const a, f32x8 const b) -> f32x8 { LMATH_LANES(f32x8, a.v[i] * b.v[i]) }
+    inline auto operator/(f32x8 const a, f32x8 const b) -> f32x8 { LMATH_LANES(f32x8, a.v[i] / b.v[i]) }
+    inline auto operator-(f32x8 const a) -> f32x8 { LMATH_LANES(f32x8, -a.v[i]) }
+    inline auto operator<(f32x8 const a, f32x8 const b) -> mask8 { LMATH_LANES(mask8, 0u - static_cast<u32>(a.v[i] < b.v[i])) }
+    inline auto operator>(f32x8 const a, f32x8 const b) -> mask8 { LMATH_LANES(mask8, 0u - static_cast<u32>(a.v[i] > b.v[i])) }
+    inline auto operator==(f32x8 const a, f32x8 const b) -> mask8 { LMATH_LANES(mask8, 0u - static_cast<u32>(a.v[i] == b.v[i])) }
+    inline auto operator&(mask8 const a, mask8 const b) -> mask8 { LMATH_LANES(mask8, a.v[i] & b.v[i]) }
+    inline auto operator|(mask8 const a, mask8 const b) -> mask8 { LMATH_LANES(mask8, a.v[i] | b.v[i]) }
+
+    // a * b + c
+    inline auto fmadd(f32x8 const a, f32x8 const b, f32x8 const c) -> f32x8 { LMATH_LANES(f32x8, a.v[i] * b.v[i] + c.v[i]) }
+    inline auto select(mask8 const m, f32x8 const a, f32x8 const b) -> f32x8 { LMATH_LANES(f32x8, std::bit_cast<f32>((std::bit_cast<u32>(a.v[i]) & m.v[i]) | (std::bit_cast<u32>(b.v[i]) & ~m.v[i]))) }
+    inline auto abs(f32x8 const a) -> f32x8 { LMATH_LANES(f32x8, std::fabs(a.v[i])) }
+    inline auto min(f32x8 const a, f32x8 const b) -> f32x8 { LMATH_LANES(f32x8, a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+    inline auto max(f32x8 const a, f32x8 const b) -> f32x8 { LMATH_LANES(f32x8, a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+    inline auto floor(f32x8 const a) -> f32x8 { LMATH_LANES(f32x8, _floor_small(a.v[i])) }
+    inline auto sqrt(f32x8 const a) -> f32x8 { LMATH_LANES(f32x8, std::sqrt(a.v[i])) }
+
+#undef LMATH_LANES
+#endif
+
+    // Scalar forms of the lane helpers, so kernels can be written once
+    inline auto fmadd(f32 const a, f32 const b, f32 const c) -> f32 { return a * b + c; }
+
+    // Picks by mask rather than branching, as quadrants and octants of
+    // arbitrary angles are unpredictable
+    inline auto select(bool const m, f32 const a, f32 const b) -> f32 {
+        u32 const mask = 0u - static_cast<u32>(m);
+        return std::bit_cast<f32>((std::bit_cast<u32>(a) & mask) | (std::bit_cast<u32>(b) & ~mask));
+    }
+
+    inline auto abs(f32 const a) -> f32 { return std::fabs(a); }
+    inline auto min(f32 const a, f32 const b) -> f32 { return a < b ? a : b; }
+    inline auto max(f32 const a, f32 const b) -> f32 { return a > b ? a : b; }
+#if defined(LMATH_AVX)
+    inline auto floor(f32 const a) -> f32 { return std::floor(a); }
+#else
+    inline auto floor(f32 const a) -> f32 { return _floor_small(a); }
+#endif
+
+    /*   Fast approximations   */
+
+    /*
+     * Sine and cosine of `x` together. The angle is reduced to a quarter turn
+     * in three steps so the reduction stays exact for large angles, then both
+     * polynomials are evaluated and swapped and negated by quadrant without
+     * branching.
+     */
+    template <class F> void fast_sincos(F const x, F &s, F &c) {
+        F const q = floor(x * F(2.0f / PI) + F(0.5f));
+        F r = fmadd(q, F(-1.5703125f), x);
+        r = fmadd(q, F(-4.837512969970703125e-4f), r);
+        r = fmadd(q, F(-7.54978995489188216e-8f), r);
+
+        F const r2 = r * r;
+        F const ps = fmadd(fmadd(fmadd(r2, F(-1.9515295891e-4f), F(8.3321608736e-3f)), r2, F(-1.6666654611e-1f)), r2 * r, r);
+        F const pc = fmadd(fmadd(fmadd(fmadd(r2, F(2.443315711809948e-5f), F(-1.388731625493765e-3f)), r2, F(4.166664568298827e-2f)), r2, F(-0.5f)), r2, F(1.0f));
+
+        // Quadrant 0 to 3
+        F const k = q - F(4.0f) * floor(q * F(0.25f));
+        auto const odd = (k == F(1.0f)) | (k == F(3.0f));
+        F const sin_r = select(odd, pc, ps);
+        F const cos_r = select(odd, ps, pc);
+        s = select(k > F(1.5f), -sin_r, sin_r);
+        c = select((k == F(1.0f)) | (k == F(2.0f)), -cos_r, cos_r);
+    }
+
+    template <class F> auto fast_sin(F const x) -> F { F s, c; fast_sincos(x, s, c); return s; }
+    template <class F> auto fast_cos(F const x) -> F { F s, c; fast_sincos(x, s, c); return c; }
+
+    /*
+     * Angle of (`x`, `y`) in [-PI, PI], with `fast_atan2(0, 0)` being 0.
+     * The ratio of the smaller to the larger coordinate goes through a
+     * minimax polynomial for atan on [0, 1], then is unfolded by octant.
+     */
+    template <class F> auto fast_atan2(F const y, F const x) -> F {
+        F const ax = abs(x), ay = abs(y);
+        F const hi = max(ax, ay), lo = min(ax, ay);
+        F const t = select(hi > F(0.0f), lo / hi, F(0.0f));
+
+        F const t2 = t * t;
+        F p = fmadd(t2, F(-0.01172120f), F(0.05265332f));
+        p = fmadd(p, t2, F(-0.11643287f));
+        p = fmadd(p, t2, F(0.19354346f));
+        p = fmadd(p, t2, F(-0.33262347f));
+        p = fmadd(p, t2, F(0.99997726f));
+        F a = p * t;
+
+        a = select(ay > ax, F(HALF_PI) - a, a);
+        a = select(x < F(0.0f), F(PI) - a, a);
+        return select(y < F(0.0f), -a, a);
+    }
+
+
+    /*
+     * Approximate `1 / sqrt(x)`: the hardware estimate refined by one Newton
+     * step.
+     */
+    inline auto fast_rsqrt(f32 const x) -> f32 {
+#if defined(__SSE__)
+        f32 const e = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+        f32 const e = 1.0f / std::sqrt(x);
+#endif
+        return e * (1.5f - 0.5f * x * e * e);
+    }
+
+    inline auto fast_rsqrt(f32x8 const x) -> f32x8 {
+#if defined(LMATH_AVX)
+        f32x8 const e = _mm256_rsqrt_ps(x.v);
+        return e * fmadd(f32x8(-0.5f) * x, e * e, f32x8(1.5f));
+#else
+        f32x8 r;
+        for (usize i = 0; i < 8; ++i) r.v[i] = fast_rsqrt(x.v[i]);
+        return r;
+#endif
+    }
+
+    // `a` scaled to unit length, or zero for a zero vector
+    inline auto normalize(vec2 const a) -> vec2 {
+        f32 const l2 = dot(a, a);
+        return l2 > 0.0f ? a * fast_rsqrt(l2) : vec2{ 0.0f, 0.0f };
+    }
+
+    // Unit complex number rotating by `angle` radians
+    inline auto from_angle(f32 const angle) -> vec2 {
+        vec2 r;
+        fast_sincos(angle, r.y, r.x);
+        return r;
+    }
+
+    /*      8 wide vectors     */
+
+    // Eight 2D vectors as two lanes of coordinates
+    struct vec2x8 {
+        f32x8 x, y;
+
+        vec2x8(void) = default;
+        vec2x8(f32x8 const x_, f32x8 const y_): x(x_), y(y_) {}
+        vec2x8(vec2 const a): x(a.x), y(a.y) {}
+
+        // Loads from separate x and y arrays, like the SoA pools use
+        static auto load(f32 const *const xs, f32 const *const ys) -> vec2x8 {
+            return { f32x8::load(xs), f32x8::load(ys) };
+        }
+        void store(f32 *const xs, f32 *const ys) const { x.store(xs); y.store(ys); }
+    };
+
+    inline auto operator+(vec2x8 const a, vec2x8 const b) -> vec2x8 { return { a.x + b.x, a.y + b.y }; }
+    inline auto operator-(vec2x8 const a, vec2x8 const b) -> vec2x8 { return { a.x - b.x, a.y - b.y }; }
+    inline auto operator*(vec2x8 const a, f32x8 const s) -> vec2x8 { return { a.x * s, a.y * s }; }
+    inline auto dot(vec2x8 const a, vec2x8 const b) -> f32x8 { return fmadd(a.x, b.x, a.y * b.y); }
+    inline auto cross(vec2x8 const a, vec2x8 const b) -> f32x8 { return fmadd(a.x, b.y, -(a.y * b.x)); }
+    inline auto length_sq(vec2x8 const a) -> f32x8 { return dot(a, a); }
+
+    // `a + b * s`, the integration step
+    inline auto fmadd(vec2x8 const a, vec2x8 const b, f32x8 const s) -> vec2x8 {
+        return { fmadd(b.x, s, a.x), fmadd(b.y, s, a.y) };
+    }
+
+    inline auto cmul(vec2x8 const a, vec2x8 const b) -> vec2x8 {
+        return { fmadd(a.x, b.x, -(a.y * b.y)), fmadd(a.x, b.y, a.y * b.x) };
+    }
+
+    inline auto rotate(vec2x8 const v, vec2x8 const r) -> vec2x8 { return cmul(v, r); }
+
+    // Unit vectors, with zero vectors left as zero
+    inline auto normalize(vec2x8 const a) -> vec2x8 {
+        f32x8 const l2 = dot(a, a);
+        f32x8 const s = select(l2 > f32x8(0.0f), fast_rsqrt(l2), f32x8(0.0f));
+        return a * s;
+    }
+
+    inline auto from_angle(f32x8 const angle) -> vec2x8 {
+        vec2x8 r;
+        fast_sincos(angle, r.y, r.x);
+        return r;
+    }
+
+    inline auto transform_point(mat2x3 const& m, vec2x8 const p) -> vec2x8 {
+        return {
+            fmadd(f32x8(m.a), p.x, fmadd(f32x8(m.b), p.y, f32x8(m.tx))),
+            fmadd(f32x8(m.c), p.x, fmadd(f32x8(m.d), p.y, f32x8(m.ty)))
+        };
+    }
+}
+
+#endif
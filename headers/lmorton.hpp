@@ -0,0 +1,229 @@
+#ifndef LMORTON_HPP
+#define LMORTON_HPP
+
+#include <cstdlib>
+#include "ldata.h"
+#include "ljobs.hpp"
+#include "lradix.hpp"
+#include "lsplit.hpp"
+
+namespace llib {
+    // Bits in a Morton key of two 16 bit coordinates
+    constexpr usize MORTON_KEY_BITS = 32;
+
+    // Spreads the low 16 bits of `x` out so there's a zero between each bit
+    constexpr auto morton_spread(u32 x) -> u32 {
+        x &= 0xffff;
+        x = (x | (x << 8)) & 0x00ff00ff;
+        x = (x | (x << 4)) & 0x0f0f0f0f;
+        x = (x | (x << 2)) & 0x33333333;
+        x = (x | (x << 1)) & 0x55555555;
+        return x;
+    }
+
+    /*
+     * Interleaves two 16 bit cell coordinates into a Z-order key, so cells that
+     * are close in space mostly get keys that are close in value.
+     */
+    constexpr auto morton_encode(u32 const x, u32 const y) -> u32 {
+        return morton_spread(x) | (morton_spread(y) << 1);
+    }
+
+    enum MortonPhase : u8 {
+        MORTON_IDLE,
+        MORTON_KEYS,
+        MORTON_SORT,
+        MORTON_APPLY
+    };
+
+    /*
+     * The Morton sorter, periodically reordering a split pool so entities that
+     * are neighbours in space are neighbours in memory.
+     *
+     * A re-sort can be spread over frames with `step`: keys are computed a
+     * budget at a time, then the keys are radix sorted two passes per frame, and
+     * finally the pool is permuted in a single frame so nothing ever reads a
+     * half moved pool. Keys can be a few frames stale by then, which only makes
+     * the order slightly less tight. If an entry is created or destroyed part
+     * way through the sort starts again.
+     *
+     * `position(Hot const&, f32 &x, f32 &y)` tells the sorter where an entry is.
+     */
+    template <class Hot, class Cold, usize N = 1024> struct MortonSorter {
+        MortonSorter(void) = delete;
+        MortonSorter(MortonSorter const&) = delete;
+        MortonSorter operator=(MortonSorter&) = delete;
+
+        /*
+         * - capacity is the most entries the sorted pool will hold
+         * - jobs runs the radix passes in parallel, or `nullptr`
+         */
+        MortonSorter(usize const capacity, JobPool *const jobs) {
+            m_capacity = capacity;
+            m_jobs = jobs;
+            m_phase = MORTON_IDLE;
+            m_origin_x = 0.0f;
+            m_origin_y = 0.0f;
+            m_inv_cell = 1.0f;
+            m_sorts = 0;
+            m_skipped = 0;
+            m_restarts = 0;
+
+            m_keys = reinterpret_cast<u32 *>(std::malloc(capacity * sizeof(u32)));
+            m_keys_tmp = reinterpret_cast<u32 *>(std::malloc(capacity * sizeof(u32)));
+            m_order = reinterpret_cast<u32 *>(std::malloc(capacity * sizeof(u32)));
+            m_order_tmp = reinterpret_cast<u32 *>(std::malloc(capacity * sizeof(u32)));
+            m_hot_scratch = reinterpret_cast<Hot *>(std::malloc(capacity * sizeof(Hot)));
+            m_cold_scratch = reinterpret_cast<Cold *>(std::malloc(capacity * sizeof(Cold)));
+            m_counts = reinterpret_cast<RadixCounts *>(std::malloc(sizeof(RadixCounts)));
+
+            // Without scratch space no pool is ever sorted
+            bool const ok = m_keys != nullptr && m_keys_tmp != nullptr
+                && m_order != nullptr && m_order_tmp != nullptr
+                && m_hot_scratch != nullptr && m_cold_scratch != nullptr && m_counts != nullptr;
+            if (!ok) m_capacity = 0;
+        }
+
+        ~MortonSorter(void) {
+            std::free(m_keys);
+            std::free(m_keys_tmp);
+            std::free(m_order);
+            std::free(m_order_tmp);
+            std::free(m_hot_scratch);
+            std::free(m_cold_scratch);
+            std::free(m_counts);
+        }
+
+        /*
+         * Sets the grid positions are quantised to: 65536 cells of `cell_size`
+         * each way from (`origin_x`, `origin_y`), clamped at the edges.
+         */
+        void configure(f32 const origin_x, f32 const origin_y, f32 const cell_size) {
+            m_origin_x = origin_x;
+            m_origin_y = origin_y;
+            m_inv_cell = 1.0f / cell_size;
+        }
+
+        /*
+         * Does one frame's share of a re-sort, computing at most `key_budget`
+         * keys. Starts a new re-sort if none is running.
+         *
+         * Returns true on the frame the pool is reordered.
+         */
+        template <class P> auto step(SplitPool<Hot, Cold, N> &pool, P &&position, usize const key_budget) -> bool {
+            if (m_phase != MORTON_IDLE && pool.version() != m_version) {
+                ++m_restarts;
+                m_phase = MORTON_IDLE;
+            }
+
+            switch (m_phase) {
+            case MORTON_IDLE:
+                m_count = pool.count() < m_capacity ? pool.count() : m_capacity;
+                if (m_capacity == 0 || m_count != pool.count()) return false;
+                m_version = pool.version();
+                m_cursor = 0;
+                m_pass = 0;
+                m_phase = MORTON_KEYS;
+                [[fallthrough]];
+
+            case MORTON_KEYS: {
+                usize const end = m_cursor + key_budget < m_count ? m_cursor + key_budget : m_count;
+                for (usize i = m_cursor; i < end; ++i) {
+                    f32 x, y;
+                    position(static_cast<Hot const&>(*pool.hot_at(i)), x, y);
+                    m_keys[i] = morton_encode(_quantise(x, m_origin_x), _quantise(y, m_origin_y));
+                    m_order[i] = static_cast<u32>(i);
+                }
+                m_cursor = end;
+                if (m_cursor == m_count) m_phase = MORTON_SORT;
+                return false;
+            }
+
+            case MORTON_SORT:
+                // Two passes per step so the sorted result lands back in the
+                // main arrays every frame.
+                radix_sort_pass(m_keys, m_order, m_keys_tmp, m_order_tmp, m_count, m_pass * LRADIX_BITS, *m_counts, m_jobs);
+                radix_sort_pass(m_keys_tmp, m_order_tmp, m_keys, m_order, m_count, (m_pass + 1) * LRADIX_BITS, *m_counts, m_jobs);
+                m_pass += 2;
+                if (m_pass * LRADIX_BITS >= MORTON_KEY_BITS) m_phase = MORTON_APPLY;
+                return false;
+
+            case MORTON_APPLY:
+                m_phase = MORTON_IDLE;
+                return _apply(pool);
+            }
+
+            return false;
+        }
+
+        /*
+         * Re-sorts the pool all at once.
+         */
+        template <class P> void sort(SplitPool<Hot, Cold, N> &pool, P &&position) {
+            m_phase = MORTON_IDLE;
+            while (!step(pool, position, m_capacity) && m_phase != MORTON_IDLE) {}
+        }
+
+        // Re-sorts that reordered the pool
+        auto sorts(void) -> usize { return m_sorts; }
+
+        // Re-sorts that found the pool already in order
+        auto skipped(void) -> usize { return m_skipped; }
+
+        // Re-sorts started over because the pool changed
+        auto restarts(void) -> usize { return m_restarts; }
+
+    private:
+        auto _apply(SplitPool<Hot, Cold, N> &pool) -> bool {
+            // A pool that's still in order doesn't need moving.
+            bool identity = true;
+            for (usize i = 0; i < m_count && identity; ++i) identity = m_order[i] == i;
+            if (identity) {
+                ++m_skipped;
+                return false;
+            }
+
+            // The keys are finished with, so their scratch holds the handles.
+            pool.permute(m_order, m_hot_scratch, m_cold_scratch, m_keys_tmp);
+            ++m_sorts;
+            return true;
+        }
+
+        auto _quantise(f32 const v, f32 const origin) -> u32 {
+            f32 const cell = (v - origin) * m_inv_cell;
+            return cell <= 0.0f ? 0 : (cell >= 65535.0f ? 65535 : static_cast<u32>(cell));
+        }
+
+        JobPool *m_jobs;
+        usize m_capacity;
+
+        MortonPhase m_phase;
+        u64 m_version;
+        usize m_count;
+        usize m_cursor;
+        usize m_pass;
+
+        f32 m_origin_x;
+        f32 m_origin_y;
+        f32 m_inv_cell;
+
+        // Keys and packed positions being sorted, with their scratch
+        u32 *m_keys;
+        u32 *m_keys_tmp;
+        u32 *m_order;
+        u32 *m_order_tmp;
+
+        // Scratch for permuting the pool
+        Hot *m_hot_scratch;
+        Cold *m_cold_scratch;
+
+        // Bucket counts for the radix passes
+        RadixCounts *m_counts;
+
+        usize m_sorts;
+        usize m_skipped;
+        usize m_restarts;
+    };
+}
+
+#endif
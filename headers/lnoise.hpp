@@ -0,0 +1,309 @@
+#ifndef LNOISE_HPP
+#define LNOISE_HPP
+
+#include <bit>
+#include <cmath>
+#include "ldata.h"
+#include "lmath.hpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define LNOISE_AVX2 1
+#endif
+
+/*
+ * Simplex noise in 2D and 3D, with fractal sums (fBm) and domain warping on
+ * top, for procedural terrain.
+ *
+ * Every function has a scalar form and an `f32x8` form evaluating 8 points
+ * at once. The 8 wide simplex kernels use AVX2 when the build enables it and
+ * otherwise run the scalar kernel per lane. Both forms hash lattice points
+ * the same way, so they agree to within float rounding.
+ *
+ * Noise is roughly in [-1, 1], and fBm and warped noise are normalised to
+ * the same range.
+ */
+namespace llib {
+    // Skew and unskew factors of the 2D and 3D simplex grids
+    constexpr f32 NOISE_F2 = 0.36602540378443864676f;
+    constexpr f32 NOISE_G2 = 0.21132486540518711775f;
+    constexpr f32 NOISE_F3 = 1.0f / 3.0f;
+    constexpr f32 NOISE_G3 = 1.0f / 6.0f;
+
+    // Settings for fractal and warped noise
+    struct NoiseParams {
+        u32 seed;
+        // Frequency of the first octave, in cycles per unit
+        f32 frequency;
+        u32 octaves;
+        // Frequency multiplier per octave
+        f32 lacunarity;
+        // Amplitude multiplier per octave
+        f32 gain;
+        // How far warped noise displaces its sample point
+        f32 warp;
+    };
+
+    // Hashes a lattice point, every bit depending on every input bit
+    constexpr auto noise_hash(i32 const i, i32 const j, i32 const k, u32 const seed) -> u32 {
+        u32 h = seed ^ (static_cast<u32>(i) * 0x8da6b343u) ^ (static_cast<u32>(j) * 0xd8163841u) ^ (static_cast<u32>(k) * 0xcb1ab31fu);
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        h *= 0x297a2d39u;
+        h ^= h >> 15;
+        return h;
+    }
+
+    // Flips the sign of `v` when `bit` of `h` is set, without branching
+    inline auto _noise_negate_if(u32 const h, u32 const bit, f32 const v) -> f32 {
+        return std::bit_cast<f32>(std::bit_cast<u32>(v) ^ ((h & bit) << (31 - __builtin_ctz(bit))));
+    }
+
+    // Dot product with one of 8 gradients picked by `h`
+    inline auto _noise_grad2(u32 const h, f32 const x, f32 const y) -> f32 {
+        bool const low = (h & 7) < 4;
+        f32 const u = select(low, x, y), v = select(low, y, x);
+        return _noise_negate_if(h, 1, u) + _noise_negate_if(h, 2, 2.0f * v);
+    }
+
+    // Dot product with one of 12 gradients, with 4 repeated, picked by `h`
+    inline auto _noise_grad3(u32 const h, f32 const x, f32 const y, f32 const z) -> f32 {
+        u32 const g = h & 15;
+        f32 const u = select(g < 8, x, y);
+        f32 const v = select(g < 4, y, select(g == 12 || g == 14, x, z));
+        return _noise_negate_if(g, 1, u) + _noise_negate_if(g, 2, v);
+    }
+
+    /*
+     * 2D simplex noise at (`x`, `y`).
+     */
+    inline auto simplex2(f32 const x, f32 const y, u32 const seed) -> f32 {
+        f32 const s = (x + y) * NOISE_F2;
+        f32 const fi = floor(x + s), fj = floor(y + s);
+        f32 const t = (fi + fj) * NOISE_G2;
+        f32 const x0 = x - (fi - t), y0 = y - (fj - t);
+        i32 const i = static_cast<i32>(fi), j = static_cast<i32>(fj);
+
+        // The lower or upper triangle of the skewed square
+        i32 const i1 = x0 > y0, j1 = 1 - i1;
+
+        f32 const x1 = x0 - static_cast<f32>(i1) + NOISE_G2, y1 = y0 - static_cast<f32>(j1) + NOISE_G2;
+        f32 const x2 = x0 - 1.0f + 2.0f * NOISE_G2, y2 = y0 - 1.0f + 2.0f * NOISE_G2;
+
+        auto const corner = [&](f32 const cx, f32 const cy, i32 const ci, i32 const cj) {
+            f32 t0 = 0.5f - cx * cx - cy * cy;
+            t0 = max(t0, 0.0f);
+            t0 *= t0;
+            return t0 * t0 * _noise_grad2(noise_hash(ci, cj, 0, seed), cx, cy);
+        };
+
+        return 40.0f * (corner(x0, y0, i, j) + corner(x1, y1, i + i1, j + j1) + corner(x2, y2, i + 1, j + 1));
+    }
+
+    /*
+     * 3D simplex noise at (`x`, `y`, `z`), for animated 2D noise or slices
+     * through a volume.
+     */
+    inline auto simplex3(f32 const x, f32 const y, f32 const z, u32 const seed) -> f32 {
+        f32 const s = (x + y + z) * NOISE_F3;
+        f32 const fi = floor(x + s), fj = floor(y + s), fk = floor(z + s);
+        f32 const t = (fi + fj + fk) * NOISE_G3;
+        f32 const x0 = x - (fi - t), y0 = y - (fj - t), z0 = z - (fk - t);
+        i32 const i = static_cast<i32>(fi), j = static_cast<i32>(fj), k = static_cast<i32>(fk);
+
+        // Corners of the tetrahedron, ranked by the largest offsets
+        i32 const i1 = x0 >= y0 && x0 >= z0, j1 = y0 > x0 && y0 >= z0, k1 = z0 > x0 && z0 > y0;
+        i32 const i2 = x0 >= y0 || x0 >= z0, j2 = y0 > x0 || y0 >= z0, k2 = !(x0 >= z0 && y0 >= z0);
+
+        auto const corner = [&](f32 const cx, f32 const cy, f32 const cz, i32 const ci, i32 const cj, i32 const ck) {
+            f32 t0 = 0.6f - cx * cx - cy * cy - cz * cz;
+            t0 = max(t0, 0.0f);
+            t0 *= t0;
+            return t0 * t0 * _noise_grad3(noise_hash(ci, cj, ck, seed), cx, cy, cz);
+        };
+
+        return 32.0f * (
+            corner(x0, y0, z0, i, j, k)
+            + corner(x0 - i1 + NOISE_G3, y0 - j1 + NOISE_G3, z0 - k1 + NOISE_G3, i + i1, j + j1, k + k1)
+            + corner(x0 - i2 + 2.0f * NOISE_G3, y0 - j2 + 2.0f * NOISE_G3, z0 - k2 + 2.0f * NOISE_G3, i + i2, j + j2, k + k2)
+            + corner(x0 - 1.0f + 3.0f * NOISE_G3, y0 - 1.0f + 3.0f * NOISE_G3, z0 - 1.0f + 3.0f * NOISE_G3, i + 1, j + 1, k + 1)
+        );
+    }
+
+#if defined(LNOISE_AVX2)
+    inline auto _noise_hash8(__m256i const i, __m256i const j, __m256i const k, __m256i const seed) -> __m256i {
+        __m256i h = _mm256_xor_si256(seed, _mm256_mullo_epi32(i, _mm256_set1_epi32(static_cast<i32>(0x8da6b343u))));
+        h = _mm256_xor_si256(h, _mm256_mullo_epi32(j, _mm256_set1_epi32(static_cast<i32>(0xd8163841u))));
+        h = _mm256_xor_si256(h, _mm256_mullo_epi32(k, _mm256_set1_epi32(static_cast<i32>(0xcb1ab31fu))));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x2c1b3c6d));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 12));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x297a2d39));
+        return _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+    }
+
+    // Flips the sign of `v` in lanes where `bit` of `h` is set
+    inline auto _noise_negate_if(__m256i const h, i32 const bit, __m256 const v) -> __m256 {
+        __m256i const sign = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(bit)), 31 - __builtin_ctz(static_cast<u32>(bit)));
+        return _mm256_xor_ps(v, _mm256_castsi256_ps(sign));
+    }
+
+    // Lanes where `a` is below the constant `b`, as a float mask
+    inline auto _noise_below(__m256i const a, i32 const b) -> __m256 {
+        return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(b), a));
+    }
+
+    inline auto _noise_grad2_8(__m256i const h, __m256 const x, __m256 const y) -> __m256 {
+        __m256 const low = _noise_below(_mm256_and_si256(h, _mm256_set1_epi32(7)), 4);
+        __m256 const u = _mm256_blendv_ps(y, x, low);
+        __m256 const v = _mm256_blendv_ps(x, y, low);
+        return _mm256_add_ps(_noise_negate_if(h, 1, u), _noise_negate_if(h, 2, _mm256_add_ps(v, v)));
+    }
+
+    inline auto _noise_grad3_8(__m256i const h, __m256 const x, __m256 const y, __m256 const z) -> __m256 {
+        __m256i const g = _mm256_and_si256(h, _mm256_set1_epi32(15));
+        __m256 const u = _mm256_blendv_ps(y, x, _noise_below(g, 8));
+        __m256 const x_case = _mm256_castsi256_ps(_mm256_or_si256(
+            _mm256_cmpeq_epi32(g, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(g, _mm256_set1_epi32(14))));
+        __m256 const v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, x_case), y, _noise_below(g, 4));
+        return _mm256_add_ps(_noise_negate_if(g, 1, u), _noise_negate_if(g, 2, v));
+    }
+
+    // (max(t - x^2 - y^2 - z^2, 0))^4
+    inline auto _noise_falloff(__m256 const t, __m256 const x, __m256 const y, __m256 const z) -> __m256 {
+        __m256 r = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(t, _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+        r = _mm256_max_ps(r, _mm256_setzero_ps());
+        r = _mm256_mul_ps(r, r);
+        return _mm256_mul_ps(r, r);
+    }
+#endif
+
+    // 2D simplex noise at 8 points
+    inline auto simplex2(f32x8 const x, f32x8 const y, u32 const seed) -> f32x8 {
+#if defined(LNOISE_AVX2)
+        __m256 const s = _mm256_mul_ps(_mm256_add_ps(x.v, y.v), _mm256_set1_ps(NOISE_F2));
+        __m256 const fi = _mm256_floor_ps(_mm256_add_ps(x.v, s)), fj = _mm256_floor_ps(_mm256_add_ps(y.v, s));
+        __m256 const t = _mm256_mul_ps(_mm256_add_ps(fi, fj), _mm256_set1_ps(NOISE_G2));
+        __m256 const x0 = _mm256_sub_ps(x.v, _mm256_sub_ps(fi, t)), y0 = _mm256_sub_ps(y.v, _mm256_sub_ps(fj, t));
+        __m256i const i = _mm256_cvttps_epi32(fi), j = _mm256_cvttps_epi32(fj);
+
+        __m256 const upper = _mm256_cmp_ps(x0, y0, _CMP_GT_OQ);
+        __m256 const one = _mm256_set1_ps(1.0f), g2 = _mm256_set1_ps(NOISE_G2);
+        __m256 const fi1 = _mm256_and_ps(upper, one), fj1 = _mm256_andnot_ps(upper, one);
+        __m256i const i1 = _mm256_cvttps_epi32(fi1), j1 = _mm256_cvttps_epi32(fj1);
+
+        __m256 const x1 = _mm256_add_ps(_mm256_sub_ps(x0, fi1), g2), y1 = _mm256_add_ps(_mm256_sub_ps(y0, fj1), g2);
+        __m256 const x2 = _mm256_add_ps(_mm256_sub_ps(x0, one), _mm256_add_ps(g2, g2));
+        __m256 const y2 = _mm256_add_ps(_mm256_sub_ps(y0, one), _mm256_add_ps(g2, g2));
+
+        __m256i const seeds = _mm256_set1_epi32(static_cast<i32>(seed)), zero = _mm256_setzero_si256(), ione = _mm256_set1_epi32(1);
+        __m256 const half = _mm256_set1_ps(0.5f), fzero = _mm256_setzero_ps();
+        __m256 const n0 = _mm256_mul_ps(_noise_falloff(half, x0, y0, fzero), _noise_grad2_8(_noise_hash8(i, j, zero, seeds), x0, y0));
+        __m256 const n1 = _mm256_mul_ps(_noise_falloff(half, x1, y1, fzero),
+            _noise_grad2_8(_noise_hash8(_mm256_add_epi32(i, i1), _mm256_add_epi32(j, j1), zero, seeds), x1, y1));
+        __m256 const n2 = _mm256_mul_ps(_noise_falloff(half, x2, y2, fzero),
+            _noise_grad2_8(_noise_hash8(_mm256_add_epi32(i, ione), _mm256_add_epi32(j, ione), zero, seeds), x2, y2));
+        return _mm256_mul_ps(_mm256_set1_ps(40.0f), _mm256_add_ps(_mm256_add_ps(n0, n1), n2));
+#else
+        f32x8 r;
+        for (usize l = 0; l < 8; ++l) r.v[l] = simplex2(x.v[l], y.v[l], seed);
+        return r;
+#endif
+    }
+
+    // 3D simplex noise at 8 points
+    inline auto simplex3(f32x8 const x, f32x8 const y, f32x8 const z, u32 const seed) -> f32x8 {
+#if defined(LNOISE_AVX2)
+        __m256 const s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x.v, y.v), z.v), _mm256_set1_ps(NOISE_F3));
+        __m256 const fi = _mm256_floor_ps(_mm256_add_ps(x.v, s));
+        __m256 const fj = _mm256_floor_ps(_mm256_add_ps(y.v, s));
+        __m256 const fk = _mm256_floor_ps(_mm256_add_ps(z.v, s));
+        __m256 const t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(fi, fj), fk), _mm256_set1_ps(NOISE_G3));
+        __m256 const x0 = _mm256_sub_ps(x.v, _mm256_sub_ps(fi, t));
+        __m256 const y0 = _mm256_sub_ps(y.v, _mm256_sub_ps(fj, t));
+        __m256 const z0 = _mm256_sub_ps(z.v, _mm256_sub_ps(fk, t));
+        __m256i const i = _mm256_cvttps_epi32(fi), j = _mm256_cvttps_epi32(fj), k = _mm256_cvttps_epi32(fk);
+
+        __m256 const x_ge_y = _mm256_cmp_ps(x0, y0, _CMP_GE_OQ), x_ge_z = _mm256_cmp_ps(x0, z0, _CMP_GE_OQ);
+        __m256 const y_gt_x = _mm256_cmp_ps(y0, x0, _CMP_GT_OQ), y_ge_z = _mm256_cmp_ps(y0, z0, _CMP_GE_OQ);
+        __m256 const z_gt_x = _mm256_cmp_ps(z0, x0, _CMP_GT_OQ), z_gt_y = _mm256_cmp_ps(z0, y0, _CMP_GT_OQ);
+        __m256 const one = _mm256_set1_ps(1.0f);
+        __m256 const fi1 = _mm256_and_ps(_mm256_and_ps(x_ge_y, x_ge_z), one);
+        __m256 const fj1 = _mm256_and_ps(_mm256_and_ps(y_gt_x, y_ge_z), one);
+        __m256 const fk1 = _mm256_and_ps(_mm256_and_ps(z_gt_x, z_gt_y), one);
+        __m256 const fi2 = _mm256_and_ps(_mm256_or_ps(x_ge_y, x_ge_z), one);
+        __m256 const fj2 = _mm256_and_ps(_mm256_or_ps(y_gt_x, y_ge_z), one);
+        __m256 const fk2 = _mm256_andnot_ps(_mm256_and_ps(x_ge_z, y_ge_z), one);
+
+        __m256 const g = _mm256_set1_ps(NOISE_G3), g2 = _mm256_set1_ps(2.0f * NOISE_G3), g3 = _mm256_set1_ps(3.0f * NOISE_G3 - 1.0f);
+        __m256i const seeds = _mm256_set1_epi32(static_cast<i32>(seed)), ione = _mm256_set1_epi32(1);
+        __m256 const limit = _mm256_set1_ps(0.6f);
+
+        __m256 const x1 = _mm256_add_ps(_mm256_sub_ps(x0, fi1), g), y1 = _mm256_add_ps(_mm256_sub_ps(y0, fj1), g), z1 = _mm256_add_ps(_mm256_sub_ps(z0, fk1), g);
+        __m256 const x2 = _mm256_add_ps(_mm256_sub_ps(x0, fi2), g2), y2 = _mm256_add_ps(_mm256_sub_ps(y0, fj2), g2), z2 = _mm256_add_ps(_mm256_sub_ps(z0, fk2), g2);
+        __m256 const x3 = _mm256_add_ps(x0, g3), y3 = _mm256_add_ps(y0, g3), z3 = _mm256_add_ps(z0, g3);
+
+        __m256 const n0 = _mm256_mul_ps(_noise_falloff(limit, x0, y0, z0), _noise_grad3_8(_noise_hash8(i, j, k, seeds), x0, y0, z0));
+        __m256 const n1 = _mm256_mul_ps(_noise_falloff(limit, x1, y1, z1), _noise_grad3_8(_noise_hash8(
+            _mm256_add_epi32(i, _mm256_cvttps_epi32(fi1)), _mm256_add_epi32(j, _mm256_cvttps_epi32(fj1)),
+            _mm256_add_epi32(k, _mm256_cvttps_epi32(fk1)), seeds), x1, y1, z1));
+        __m256 const n2 = _mm256_mul_ps(_noise_falloff(limit, x2, y2, z2), _noise_grad3_8(_noise_hash8(
+            _mm256_add_epi32(i, _mm256_cvttps_epi32(fi2)), _mm256_add_epi32(j, _mm256_cvttps_epi32(fj2)),
+            _mm256_add_epi32(k, _mm256_cvttps_epi32(fk2)), seeds), x2, y2, z2));
+        __m256 const n3 = _mm256_mul_ps(_noise_falloff(limit, x3, y3, z3), _noise_grad3_8(_noise_hash8(
+            _mm256_add_epi32(i, ione), _mm256_add_epi32(j, ione), _mm256_add_epi32(k, ione), seeds), x3, y3, z3));
+        return _mm256_mul_ps(_mm256_set1_ps(32.0f), _mm256_add_ps(_mm256_add_ps(n0, n1), _mm256_add_ps(n2, n3)));
+#else
+        f32x8 r;
+        for (usize l = 0; l < 8; ++l) r.v[l] = simplex3(x.v[l], y.v[l], z.v[l], seed);
+        return r;
+#endif
+    }
+
+    /*
+     * Fractal 2D noise: `octaves` layers of simplex noise, each at
+     * `lacunarity` times the frequency and `gain` times the amplitude of the
+     * last, with its own seed.
+     */
+    template <class F> auto fbm2(F const x, F const y, NoiseParams const& params) -> F {
+        F sum = F(0.0f);
+        f32 amplitude = 1.0f, frequency = params.frequency, total = 0.0f;
+        for (u32 o = 0; o < params.octaves; ++o) {
+            sum = sum + simplex2(x * F(frequency), y * F(frequency), params.seed + o * 0x9e3779b9u) * F(amplitude);
+            total += amplitude;
+            amplitude *= params.gain;
+            frequency *= params.lacunarity;
+        }
+        return sum * F(1.0f / total);
+    }
+
+    // Fractal 3D noise, as `fbm2`
+    template <class F> auto fbm3(F const x, F const y, F const z, NoiseParams const& params) -> F {
+        F sum = F(0.0f);
+        f32 amplitude = 1.0f, frequency = params.frequency, total = 0.0f;
+        for (u32 o = 0; o < params.octaves; ++o) {
+            sum = sum + simplex3(x * F(frequency), y * F(frequency), z * F(frequency), params.seed + o * 0x9e3779b9u) * F(amplitude);
+            total += amplitude;
+            amplitude *= params.gain;
+            frequency *= params.lacunarity;
+        }
+        return sum * F(1.0f / total);
+    }
+
+    /*
+     * Domain warped 2D noise: two fBm fields displace the point by up to
+     * `warp` units before the final fBm is sampled, bending straight
+     * features into swirls and tunnels.
+     */
+    template <class F> auto warp2(F const x, F const y, NoiseParams const& params) -> F {
+        NoiseParams offset = params;
+        offset.seed = params.seed ^ 0x5bd1e995u;
+        F const qx = fbm2(x, y, offset);
+        offset.seed = params.seed ^ 0x1b873593u;
+        F const qy = fbm2(x, y, offset);
+        return fbm2(x + qx * F(params.warp), y + qy * F(params.warp), params);
+    }
+}
+
+#endif
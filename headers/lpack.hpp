@@ -0,0 +1,174 @@
+#ifndef LPACK_HPP
+#define LPACK_HPP
+
+#include <cstring>
+#include "ldata.h"
+
+namespace llib {
+    // Shortest match worth encoding
+    constexpr usize LPACK_MIN_MATCH = 4;
+
+    // Furthest back a match can reach
+    constexpr usize LPACK_MAX_OFFSET = 65535;
+
+    // Bits of the 4 byte hash used to find earlier matches
+    constexpr usize LPACK_HASH_BITS = 12;
+
+    /*
+     * Most bytes `pack` can write for `n` bytes of input, when nothing
+     * matches.
+     */
+    constexpr auto pack_bound(usize const n) -> usize { return n + n / 255 + 16; }
+
+    // Writes the part of a length that doesn't fit in its token nibble
+    inline auto _pack_length(u8 *out, usize length) -> u8* {
+        while (length >= 255) {
+            *out++ = 255;
+            length -= 255;
+        }
+        *out++ = static_cast<u8>(length);
+        return out;
+    }
+
+    inline auto _pack_hash(u8 const *const p) -> u32 {
+        u32 v;
+        std::memcpy(&v, p, sizeof(v));
+        return (v * 2654435761u) >> (32 - LPACK_HASH_BITS);
+    }
+
+    /*
+     * Compresses `n` bytes from `src` into `dst`, which must hold
+     * `pack_bound(n)` bytes, returning the packed size.
+     *
+     * The stream is a list of sequences, each a token byte holding the
+     * literal count and match length in its two nibbles, any longer lengths
+     * as runs of 255, the literals, and a 16 bit offset back to the match.
+     * The last sequence is literals only.
+     *
+     * Matches are searched one byte back, which turns runs into matches, at
+     * the three spots touching this one on the row above when `stride` is a
+     * grid's row length, and at the last position with the same 4 bytes. The
+     * longest wins. Grids of a few materials, where edges shift by at most a
+     * cell from row to row, come down to a handful of long matches.
+     */
+    inline auto pack(u8 const *const src, usize const n, u8 *const dst, usize const stride = 0) -> usize {
+        u32 table[1 << LPACK_HASH_BITS];
+        std::memset(table, 0xff, sizeof(table));
+
+        u8 *out = dst;
+        usize literal = 0;
+        usize i = 0;
+
+        while (i + LPACK_MIN_MATCH <= n) {
+            usize const limit = n - i;
+            usize best_length = 0, best_offset = 0;
+
+            auto const consider = [&](usize const offset) {
+                if (offset == 0 || offset > i || offset > LPACK_MAX_OFFSET) return;
+                u8 const *const a = src + i, *const b = src + i - offset;
+                usize length = 0;
+                while (length < limit && a[length] == b[length]) ++length;
+                if (length > best_length) {
+                    best_length = length;
+                    best_offset = offset;
+                }
+            };
+
+            consider(1);
+            if (stride > 1) {
+                consider(stride - 1);
+                consider(stride);
+                consider(stride + 1);
+            }
+            u32 const h = _pack_hash(src + i);
+            if (table[h] != ~0u) consider(i - table[h]);
+            table[h] = static_cast<u32>(i);
+
+            if (best_length < LPACK_MIN_MATCH) {
+                ++i;
+                continue;
+            }
+
+            // Literals since the last match, then the match
+            usize const literals = i - literal;
+            usize const extra = best_length - LPACK_MIN_MATCH;
+            u8 *const token = out++;
+            *token = static_cast<u8>((literals < 15 ? literals : 15) << 4 | (extra < 15 ? extra : 15));
+            if (literals >= 15) out = _pack_length(out, literals - 15);
+            std::memcpy(out, src + literal, literals);
+            out += literals;
+            *out++ = static_cast<u8>(best_offset);
+            *out++ = static_cast<u8>(best_offset >> 8);
+            if (extra >= 15) out = _pack_length(out, extra - 15);
+
+            i += best_length;
+            literal = i;
+        }
+
+        usize const literals = n - literal;
+        *out++ = static_cast<u8>((literals < 15 ? literals : 15) << 4);
+        if (literals >= 15) out = _pack_length(out, literals - 15);
+        std::memcpy(out, src + literal, literals);
+        out += literals;
+
+        return static_cast<usize>(out - dst);
+    }
+
+    /*
+     * Decompresses `size` bytes of `pack` output from `src` into `dst`,
+     * returning false unless it is well formed and makes exactly `n` bytes.
+     */
+    inline auto unpack(u8 const *const src, usize const size, u8 *const dst, usize const n) -> bool {
+        u8 const *in = src;
+        u8 const *const in_end = src + size;
+        u8 *out = dst;
+        u8 *const out_end = dst + n;
+
+        auto const length = [&](usize value) -> usize {
+            if (value != 15) return value;
+            u8 b;
+            do {
+                if (in == in_end) return ~usize(0);
+                b = *in++;
+                value += b;
+            } while (b == 255);
+            return value;
+        };
+
+        while (in < in_end) {
+            u8 const token = *in++;
+
+            usize const literals = length(token >> 4);
+            if (literals > static_cast<usize>(in_end - in) || literals > static_cast<usize>(out_end - out)) return false;
+            std::memcpy(out, in, literals);
+            in += literals;
+            out += literals;
+
+            // The last sequence ends at the end of the input
+            if (in == in_end) break;
+
+            if (in_end - in < 2) return false;
+            usize const offset = static_cast<usize>(in[0]) | static_cast<usize>(in[1]) << 8;
+            in += 2;
+            usize const extra = length(token & 15);
+            if (extra == ~usize(0)) return false;
+            usize const match = extra + LPACK_MIN_MATCH;
+            if (offset == 0 || offset > static_cast<usize>(out - dst) || match > static_cast<usize>(out_end - out)) return false;
+
+            u8 const *from = out - offset;
+            if (offset == 1) {
+                std::memset(out, *from, match);
+            } else if (offset >= match) {
+                std::memcpy(out, from, match);
+            } else {
+                // Overlapping, repeat the last `offset` bytes
+                for (usize k = 0; k < match; ++k) out[k] = from[k];
+            }
+            out += match;
+        }
+
+        return out == out_end;
+    }
+}
+
+#endif
@@ -43,6 +43,7 @@ namespace llib {
      */
     template <class T> struct PoolAllocator {   
         PoolAllocator(void) = delete;
+        PoolAllocator(PoolAllocator const&) = delete;
         PoolAllocator operator=(PoolAllocator&) = delete;
         
         /*
@@ -100,6 +101,9 @@ namespace llib {
                     "Allocating Block: %p\n",
                     (void *)m_alloc
                 );
+
+                // The max number of blocks is reached, leave it to the mutator code.
+                if (m_alloc == nullptr) return nullptr;
             }
 
             // The return value is the current position of the allocation pointer:
@@ -182,8 +186,11 @@ namespace llib {
             return block_begin; 
         }
 
-        // Size of a chunk (in bytes)
-        usize const m_chunk_size = sizeof(T);
+        // Size of a chunk (in bytes), at least big enough for the free list
+        // pointer and rounded up so every chunk's pointer stays aligned.
+        usize const m_chunk_size =
+            ((sizeof(T) > sizeof(Chunk) ? sizeof(T) : sizeof(Chunk)) + alignof(Chunk) - 1)
+            & ~(alignof(Chunk) - 1);
 
         // Num chunks per larger block.
         usize m_chunks_per_block;
@@ -0,0 +1,199 @@
+#ifndef LRADIX_HPP
+#define LRADIX_HPP
+
+#include <cstring>
+#include "larena.hpp"
+#include "ldata.h"
+#include "ljobs.hpp"
+
+namespace llib {
+    // Bits sorted per pass
+    constexpr usize LRADIX_BITS = 8;
+
+    // Buckets per pass
+    constexpr usize LRADIX_BUCKETS = 1 << LRADIX_BITS;
+
+    // Most tiles a pass is split into for parallel counting and scattering
+    constexpr usize LRADIX_MAX_TILES = 32;
+
+    // Fewest items per tile, below this a pass isn't worth splitting
+    constexpr usize LRADIX_MIN_TILE = 16384;
+
+    /*
+     * Every tile's bucket counts for a pass, 64 KiB on a 64 bit target, so
+     * it's part of the caller's scratch rather than the stack.
+     */
+    struct RadixCounts {
+        usize counts[LRADIX_MAX_TILES][LRADIX_BUCKETS];
+    };
+
+    /*
+     * One stable pass of an LSD radix sort, moving `n` keys and their values
+     * from the input arrays to the output arrays ordered by the 8 bits of key
+     * starting at `shift`. `values_in` may be `nullptr` to move keys only.
+     *
+     * With a job pool the input is split into tiles: every tile counts its
+     * buckets in parallel, the counts are turned into per tile offsets, and
+     * every tile scatters its items in parallel. Tiles keep their order, so
+     * the pass stays stable. `jobs` may be `nullptr` to run on the caller.
+     * `shift` must be less than the width of `K`, and `scratch` holds the
+     * counts.
+     *
+     * With `skip_uniform`, a pass where every key has the same digit writes
+     * nothing and returns false, as the output would equal the input.
+     */
+    template <class K> auto radix_sort_pass(
+        K const *const keys_in, u32 const *const values_in,
+        K *const keys_out, u32 *const values_out,
+        usize const n, usize const shift,
+        RadixCounts &scratch, JobPool *const jobs, bool const skip_uniform = false
+    ) -> bool {
+        usize tiles = jobs == nullptr ? 1 : jobs->thread_count();
+        if (tiles > LRADIX_MAX_TILES) tiles = LRADIX_MAX_TILES;
+        if (tiles > 1 && n / tiles < LRADIX_MIN_TILE) tiles = n / LRADIX_MIN_TILE > 1 ? n / LRADIX_MIN_TILE : 1;
+        usize const tile_size = (n + tiles - 1) / tiles;
+
+        auto &counts = scratch.counts;
+
+        auto const count = [&](usize const t) {
+            usize *const c = counts[t];
+            std::memset(c, 0, sizeof(counts[t]));
+            usize const end = (t + 1) * tile_size < n ? (t + 1) * tile_size : n;
+            for (usize i = t * tile_size; i < end; ++i)
+                ++c[(keys_in[i] >> shift) & (LRADIX_BUCKETS - 1)];
+        };
+
+        // Bucket by bucket, then tile by tile, so each tile writes after the
+        // earlier tiles' items with the same digit.
+        auto const offsets = [&] {
+            usize total = 0;
+            for (usize b = 0; b < LRADIX_BUCKETS; ++b) {
+                for (usize t = 0; t < tiles; ++t) {
+                    usize const c = counts[t][b];
+                    counts[t][b] = total;
+                    total += c;
+                }
+            }
+        };
+
+        // Whether one bucket holds every key
+        auto const uniform = [&] {
+            for (usize b = 0; b < LRADIX_BUCKETS; ++b) {
+                usize total = 0;
+                for (usize t = 0; t < tiles; ++t) total += counts[t][b];
+                if (total != 0) return total == n;
+            }
+            return true;
+        };
+
+        auto const scatter = [&](usize const t) {
+            usize *const c = counts[t];
+            usize const end = (t + 1) * tile_size < n ? (t + 1) * tile_size : n;
+            if (values_in == nullptr) {
+                for (usize i = t * tile_size; i < end; ++i)
+                    keys_out[c[(keys_in[i] >> shift) & (LRADIX_BUCKETS - 1)]++] = keys_in[i];
+            } else {
+                for (usize i = t * tile_size; i < end; ++i) {
+                    usize const o = c[(keys_in[i] >> shift) & (LRADIX_BUCKETS - 1)]++;
+                    keys_out[o] = keys_in[i];
+                    values_out[o] = values_in[i];
+                }
+            }
+        };
+
+        if (tiles == 1) count(0);
+        else jobs->parallel_for(tiles, count);
+
+        if (skip_uniform && uniform()) return false;
+        offsets();
+
+        if (tiles == 1) scatter(0);
+        else jobs->parallel_for(tiles, scatter);
+        return true;
+    }
+
+    /*
+     * Sorts `n` keys with a `u32` value each, such as an index, by the low
+     * `key_bits` bits of the key. Keys may be 32 or 64 bit unsigned integers.
+     *
+     * `keys_tmp` and `values_tmp` are scratch arrays of `n` items. The result
+     * always ends up back in `keys` and `values`. Passes where every key has
+     * the same digit, like the high bytes of small keys, are skipped.
+     *
+     * Returns false, leaving the arrays untouched, if `key_bits` is wider
+     * than the key.
+     */
+    template <class K> auto radix_sort_pairs(
+        K *const keys, u32 *const values,
+        K *const keys_tmp, u32 *const values_tmp,
+        usize const n, usize const key_bits,
+        RadixCounts &counts, JobPool *const jobs
+    ) -> bool {
+        if (key_bits > sizeof(K) * 8) return false;
+        usize const passes = (key_bits + LRADIX_BITS - 1) / LRADIX_BITS;
+
+        K *from_k = keys, *to_k = keys_tmp;
+        u32 *from_v = values, *to_v = values_tmp;
+        for (usize p = 0; p < passes; ++p) {
+            if (!radix_sort_pass(from_k, from_v, to_k, to_v, n, p * LRADIX_BITS, counts, jobs, true)) continue;
+            K *const k = from_k; from_k = to_k; to_k = k;
+            u32 *const v = from_v; from_v = to_v; to_v = v;
+        }
+
+        // An odd number of passes leaves the result in the scratch arrays.
+        if (from_k != keys) {
+            std::memcpy(keys, from_k, n * sizeof(K));
+            if (values != nullptr) std::memcpy(values, from_v, n * sizeof(u32));
+        }
+        return true;
+    }
+
+    /*
+     * Sorts `n` keys by the low `key_bits` bits, with `keys_tmp` and `counts`
+     * as scratch. Returns false if `key_bits` is wider than the key.
+     */
+    template <class K> auto radix_sort_keys(
+        K *const keys, K *const keys_tmp,
+        usize const n, usize const key_bits,
+        RadixCounts &counts, JobPool *const jobs
+    ) -> bool {
+        return radix_sort_pairs<K>(keys, nullptr, keys_tmp, nullptr, n, key_bits, counts, jobs);
+    }
+
+    /*
+     * Sorts keys and values like `radix_sort_pairs`, taking the scratch from
+     * `arena`. Returns false, leaving the arrays untouched, if the arena can't
+     * fit the scratch or `key_bits` is wider than the key.
+     */
+    template <class K> auto radix_sort_pairs(
+        K *const keys, u32 *const values, usize const n,
+        FrameArena &arena, JobPool *const jobs,
+        usize const key_bits = sizeof(K) * 8
+    ) -> bool {
+        if (key_bits > sizeof(K) * 8) return false;
+        K *const keys_tmp = arena.allocate_array<K>(n);
+        u32 *const values_tmp = arena.allocate_array<u32>(n);
+        RadixCounts *const counts = arena.allocate_array<RadixCounts>(1);
+        if (keys_tmp == nullptr || values_tmp == nullptr || counts == nullptr) return false;
+        return radix_sort_pairs(keys, values, keys_tmp, values_tmp, n, key_bits, *counts, jobs);
+    }
+
+    /*
+     * Sorts keys like `radix_sort_keys`, taking the scratch from `arena`.
+     * Returns false, leaving the keys untouched, if the arena can't fit the
+     * scratch or `key_bits` is wider than the key.
+     */
+    template <class K> auto radix_sort_keys(
+        K *const keys, usize const n,
+        FrameArena &arena, JobPool *const jobs,
+        usize const key_bits = sizeof(K) * 8
+    ) -> bool {
+        if (key_bits > sizeof(K) * 8) return false;
+        K *const keys_tmp = arena.allocate_array<K>(n);
+        RadixCounts *const counts = arena.allocate_array<RadixCounts>(1);
+        if (keys_tmp == nullptr || counts == nullptr) return false;
+        return radix_sort_keys(keys, keys_tmp, n, key_bits, *counts, jobs);
+    }
+}
+
+#endif
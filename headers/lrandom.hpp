@@ -0,0 +1,323 @@
+#ifndef LRANDOM_HPP
+#define LRANDOM_HPP
+
+#include <cstring>
+#include "ldata.h"
+#include "lmath.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LRANDOM_AVX2 1
+#endif
+
+namespace llib {
+    // Values written per step of a batch generator
+    constexpr usize LRANDOM_BATCH = 8;
+
+    // Expands a seed into well mixed state words
+    constexpr auto splitmix64(u64 &state) -> u64 {
+        u64 z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // Top 24 bits of `v` as a float in [0, 1)
+    constexpr auto u32_to_unit(u32 const v) -> f32 { return static_cast<f32>(v >> 8) * (1.0f / 16777216.0f); }
+
+    /*
+     * The xoshiro256+ generator, fast with a 2^256 - 1 period.
+     *
+     * Its lowest bits are weaker than the rest, which doesn't matter for
+     * floats or gameplay rolls but rules it out for statistics. `split` hands
+     * out non overlapping streams of 2^128 values, one per thread or system,
+     * so results don't depend on how work is scheduled.
+     */
+    struct Xoshiro256 {
+        u64 s[4];
+
+        constexpr Xoshiro256(u64 seed = 0) {
+            for (usize i = 0; i < 4; ++i) s[i] = splitmix64(seed);
+        }
+
+        constexpr auto next(void) -> u64 {
+            u64 const result = s[0] + s[3];
+            u64 const t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = (s[3] << 45) | (s[3] >> 19);
+            return result;
+        }
+
+        // The high half, the better bits
+        constexpr auto next_u32(void) -> u32 { return static_cast<u32>(next() >> 32); }
+        constexpr auto next_f32(void) -> f32 { return u32_to_unit(next_u32()); }
+
+        // Integer in [0, `bound`), by multiply and shift rather than modulo
+        constexpr auto next_below(u32 const bound) -> u32 {
+            return static_cast<u32>((static_cast<u64>(next_u32()) * bound) >> 32);
+        }
+
+        // Skips ahead 2^128 values
+        constexpr void jump(void) { _jump(JUMP); }
+
+        // Skips ahead 2^192 values
+        constexpr void long_jump(void) { _jump(LONG_JUMP); }
+
+        /*
+         * Returns a generator for the next 2^128 values and skips this one past
+         * them.
+         */
+        constexpr auto split(void) -> Xoshiro256 {
+            Xoshiro256 child = *this;
+            jump();
+            return child;
+        }
+
+    private:
+        static constexpr u64 JUMP[4] = {
+            0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull
+        };
+        static constexpr u64 LONG_JUMP[4] = {
+            0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull, 0x77710069854ee241ull, 0x39109bb02acbe635ull
+        };
+
+        constexpr void _jump(u64 const (&polynomial)[4]) {
+            u64 t[4] = { 0, 0, 0, 0 };
+            for (usize i = 0; i < 4; ++i) {
+                for (usize b = 0; b < 64; ++b) {
+                    if (polynomial[i] & (u64(1) << b)) {
+                        for (usize k = 0; k < 4; ++k) t[k] ^= s[k];
+                    }
+                    next();
+                }
+            }
+            for (usize k = 0; k < 4; ++k) s[k] = t[k];
+        }
+    };
+
+    /*
+     * The PCG32 generator, 64 bits of state with 2^63 selectable streams.
+     *
+     * Slower than xoshiro256+ but it can seek to any position in O(log n),
+     * so a replay can jump straight to the numbers frame `n` used.
+     */
+    struct Pcg32 {
+        u64 state;
+        u64 inc;
+
+        constexpr Pcg32(u64 const seed = 0, u64 const stream = 0): state(0), inc((stream << 1) | 1) {
+            next_u32();
+            state += seed;
+            next_u32();
+        }
+
+        constexpr auto next_u32(void) -> u32 {
+            u64 const old = state;
+            state = old * MULTIPLIER + inc;
+            u32 const shifted = static_cast<u32>(((old >> 18) ^ old) >> 27);
+            u32 const rot = static_cast<u32>(old >> 59);
+            return (shifted >> rot) | (shifted << ((0u - rot) & 31));
+        }
+
+        constexpr auto next_f32(void) -> f32 { return u32_to_unit(next_u32()); }
+
+        constexpr auto next_below(u32 const bound) -> u32 {
+            return static_cast<u32>((static_cast<u64>(next_u32()) * bound) >> 32);
+        }
+
+        /*
+         * Moves `delta` values ahead, or behind when it wraps, by composing
+         * the LCG step with itself.
+         */
+        constexpr void advance(u64 delta) {
+            u64 mult = MULTIPLIER, plus = inc;
+            u64 acc_mult = 1, acc_plus = 0;
+            while (delta > 0) {
+                if (delta & 1) {
+                    acc_mult *= mult;
+                    acc_plus = acc_plus * mult + plus;
+                }
+                plus = (mult + 1) * plus;
+                mult *= mult;
+                delta >>= 1;
+            }
+            state = acc_mult * state + acc_plus;
+        }
+
+        /*
+         * Returns a generator on a different stream, seeded from this one.
+         */
+        constexpr auto split(void) -> Pcg32 {
+            u64 const seed = (static_cast<u64>(next_u32()) << 32) | next_u32();
+            u64 const stream = (static_cast<u64>(next_u32()) << 32) | next_u32();
+            return Pcg32(seed, stream);
+        }
+
+    private:
+        static constexpr u64 MULTIPLIER = 6364136223846793005ull;
+    };
+
+    /*
+     * Eight xoshiro256+ generators run side by side, filling arrays 8 values
+     * at a time with AVX2 when the build enables it. Each step takes one
+     * value from every lane and keeps only its high half, as the low bits
+     * are the weak ones, and the scalar path steps the lanes in the same
+     * order, so the output is identical either way.
+     *
+     * Every fill uses whole steps, so a fill of `n` moves the generator by
+     * `ceil(n / 8)` steps and any extra values are dropped.
+     */
+    struct RandomBatch {
+        // Lanes seeded from `seed`, a `split` apart
+        RandomBatch(u64 const seed = 0) {
+            Xoshiro256 source(seed);
+            _take_lanes(source);
+        }
+
+        // Lanes split off `source`
+        RandomBatch(Xoshiro256 &source) { _take_lanes(source); }
+
+        // Fills `out` with `n` random `u32`s
+        void fill_u32(u32 *const out, usize const n) {
+            usize i = 0;
+            _run(n / LRANDOM_BATCH, [&](u32 const *const v) {
+                std::memcpy(out + i, v, LRANDOM_BATCH * sizeof(u32));
+                i += LRANDOM_BATCH;
+            });
+            _tail(out + i, n - i);
+        }
+
+        // Fills `out` with `n` floats in [0, 1)
+        void fill_f32(f32 *const out, usize const n) {
+            usize i = 0;
+            _run(n / LRANDOM_BATCH, [&](u32 const *const v) {
+                for (usize k = 0; k < LRANDOM_BATCH; ++k) out[i + k] = u32_to_unit(v[k]);
+                i += LRANDOM_BATCH;
+            });
+            if (i < n) {
+                u32 v[LRANDOM_BATCH];
+                _tail(v, n - i);
+                for (usize k = 0; i + k < n; ++k) out[i + k] = u32_to_unit(v[k]);
+            }
+        }
+
+        /*
+         * Fills `x` and `y` with `n` points spread evenly over the unit disc,
+         * such as spread patterns and particle velocities. Radius comes from
+         * the square root of one value and angle from another, so there are
+         * no rejected samples to branch on.
+         */
+        void fill_disc(f32 *const x, f32 *const y, usize const n) {
+            usize const points = (n + LRANDOM_BATCH - 1) / LRANDOM_BATCH;
+            alignas(32) f32 r[LRANDOM_BATCH] = {}, a[LRANDOM_BATCH] = {};
+            usize i = 0, step = 0;
+
+            // Steps alternate between radii and angles.
+            _run(points * 2, [&](u32 const *const v) {
+                if ((step++ & 1) == 0) {
+                    for (usize k = 0; k < LRANDOM_BATCH; ++k) r[k] = u32_to_unit(v[k]);
+                    return;
+                }
+                for (usize k = 0; k < LRANDOM_BATCH; ++k) a[k] = u32_to_unit(v[k]) * TAU;
+
+                vec2x8 const p = from_angle(f32x8::load(a)) * sqrt(f32x8::load(r));
+                if (i + LRANDOM_BATCH <= n) {
+                    p.store(x + i, y + i);
+                } else {
+                    f32 px[LRANDOM_BATCH], py[LRANDOM_BATCH];
+                    p.store(px, py);
+                    for (usize k = 0; i + k < n; ++k) {
+                        x[i + k] = px[k];
+                        y[i + k] = py[k];
+                    }
+                }
+                i += LRANDOM_BATCH;
+            });
+        }
+
+    private:
+        void _take_lanes(Xoshiro256 &source) {
+            for (usize l = 0; l < LRANDOM_BATCH; ++l) {
+                Xoshiro256 const lane = source.split();
+                for (usize k = 0; k < 4; ++k) m_s[k][l] = lane.s[k];
+            }
+        }
+
+        // Runs `steps` steps, passing each step's 8 values to `fn`
+        template <class F> void _run(usize const steps, F &&fn) {
+#if defined(LRANDOM_AVX2)
+            // Lanes 0 to 3 step in `a`, lanes 4 to 7 in `b`.
+            __m256i a[4], b[4];
+            for (usize k = 0; k < 4; ++k) {
+                a[k] = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(m_s[k]));
+                b[k] = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(m_s[k] + 4));
+            }
+            alignas(32) u32 v[LRANDOM_BATCH];
+            for (usize step = 0; step < steps; ++step) {
+                // Odd 32 bit words are the high halves, which the shuffle
+                // gathers as lanes 0 1 4 5 2 3 6 7 and the permute puts in order.
+                __m256 const va = _mm256_castsi256_ps(_mm256_add_epi64(a[0], a[3]));
+                __m256 const vb = _mm256_castsi256_ps(_mm256_add_epi64(b[0], b[3]));
+                __m256i const high = _mm256_castps_si256(_mm256_shuffle_ps(va, vb, _MM_SHUFFLE(3, 1, 3, 1)));
+                _mm256_store_si256(reinterpret_cast<__m256i *>(v), _mm256_permute4x64_epi64(high, _MM_SHUFFLE(3, 1, 2, 0)));
+                _step(a);
+                _step(b);
+                fn(static_cast<u32 const *>(v));
+            }
+            for (usize k = 0; k < 4; ++k) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(m_s[k]), a[k]);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(m_s[k] + 4), b[k]);
+            }
+#else
+            // Work on a local copy, as writes through `fn` could alias the state.
+            u64 s[4][LRANDOM_BATCH];
+            std::memcpy(s, m_s, sizeof(s));
+            for (usize step = 0; step < steps; ++step) {
+                u32 high[LRANDOM_BATCH];
+                for (usize l = 0; l < LRANDOM_BATCH; ++l) {
+                    high[l] = static_cast<u32>((s[0][l] + s[3][l]) >> 32);
+                    u64 const t = s[1][l] << 17;
+                    s[2][l] ^= s[0][l];
+                    s[3][l] ^= s[1][l];
+                    s[1][l] ^= s[2][l];
+                    s[0][l] ^= s[3][l];
+                    s[2][l] ^= t;
+                    s[3][l] = (s[3][l] << 45) | (s[3][l] >> 19);
+                }
+                fn(static_cast<u32 const *>(high));
+            }
+            std::memcpy(m_s, s, sizeof(s));
+#endif
+        }
+
+#if defined(LRANDOM_AVX2)
+        // Advances four lanes by one step
+        static void _step(__m256i (&s)[4]) {
+            __m256i const t = _mm256_slli_epi64(s[1], 17);
+            s[2] = _mm256_xor_si256(s[2], s[0]);
+            s[3] = _mm256_xor_si256(s[3], s[1]);
+            s[1] = _mm256_xor_si256(s[1], s[2]);
+            s[0] = _mm256_xor_si256(s[0], s[3]);
+            s[2] = _mm256_xor_si256(s[2], t);
+            s[3] = _mm256_or_si256(_mm256_slli_epi64(s[3], 45), _mm256_srli_epi64(s[3], 19));
+        }
+#endif
+
+        // Writes the first `n` values of one step, if `n` isn't zero
+        void _tail(u32 *const out, usize const n) {
+            if (n == 0) return;
+            _run(1, [&](u32 const *const v) {
+                for (usize k = 0; k < n; ++k) out[k] = v[k];
+            });
+        }
+
+        // State word `k` of lane `l`, laid out so each word loads as a vector
+        u64 m_s[4][LRANDOM_BATCH];
+    };
+}
+
+#endif
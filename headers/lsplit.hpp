@@ -0,0 +1,263 @@
+#ifndef LSPLIT_HPP
+#define LSPLIT_HPP
+
+#include <cstdlib>
+#include <type_traits>
+#include "ldata.h"
+#include "lpool.hpp"
+
+namespace llib {
+    // Marks a handle that doesn't refer to an entry
+    constexpr u32 SPLIT_NONE = ~0u;
+
+    /*
+     * A handle to a split pool entry. The generation changes every time an
+     * index is reused, so handles to destroyed entries are recognised as
+     * stale.
+     */
+    struct SplitHandle {
+        u32 index;
+        u32 generation;
+    };
+
+    // A block of hot data, `N` entries back to back
+    template <class Hot, usize N> struct SplitHotBlock {
+        Hot items[N];
+    };
+
+    // A block of cold data, with the handle of each entry for removals
+    template <class Cold, usize N> struct SplitColdBlock {
+        Cold items[N];
+        u32 handles[N];
+    };
+
+    /*
+     * The split pool, storing each entry as a small hot part and a larger cold
+     * part in two parallel pools that share one index.
+     *
+     * Per frame passes only read the hot blocks, so with a 16 to 32 byte hot
+     * part two to four entries fit in every cache line the pass loads, instead
+     * of one entry dragging its name, loot table and spawn data along with it.
+     * Entries are kept packed, the last entry filling any hole, so a pass is a
+     * straight walk over full blocks. Handles stay valid across removals,
+     * and a handle to a destroyed entry is rejected rather than reaching
+     * whatever took its place.
+     *
+     * ```c++
+     * struct Hot { f32 x, y, vx, vy; };
+     * struct Cold { char name[32]; u32 loot_table; f32 spawn_x, spawn_y; };
+     * llib::SplitPool<Hot, Cold> enemies(64);
+     * llib::SplitHandle const handle = enemies.create(Hot{ ... }, Cold{ ... });
+     * enemies.each_hot([](usize n, Hot *hot) { ... });
+     * ```
+     */
+    template <class Hot, class Cold, usize N = 1024> struct SplitPool {
+        static_assert(std::is_trivially_copyable_v<Hot>, "Hot data must be trivially copyable");
+        static_assert(std::is_trivially_copyable_v<Cold>, "Cold data must be trivially copyable");
+
+        SplitPool(void) = delete;
+        SplitPool(SplitPool const&) = delete;
+        SplitPool operator=(SplitPool&) = delete;
+
+        /*
+         * - max_blocks is the number of blocks in each of the two pools, so
+         *   the pool holds up to `max_blocks * N` entries
+         */
+        SplitPool(usize const max_blocks):
+            m_hot_pool(1, max_blocks),
+            m_cold_pool(1, max_blocks)
+        {
+            m_max_blocks = max_blocks;
+            m_block_count = 0;
+            m_count = 0;
+            m_hot = reinterpret_cast<SplitHotBlock<Hot, N> **>(std::calloc(max_blocks, sizeof(ptr)));
+            m_cold = reinterpret_cast<SplitColdBlock<Cold, N> **>(std::calloc(max_blocks, sizeof(ptr)));
+
+            // Every handle starts free, chained through the sparse array.
+            usize const capacity = max_blocks * N;
+            m_sparse = reinterpret_cast<u32 *>(std::malloc(capacity * sizeof(u32)));
+            m_generation = reinterpret_cast<u32 *>(std::calloc(capacity, sizeof(u32)));
+            m_capacity = m_sparse != nullptr && m_generation != nullptr ? capacity : 0;
+            for (usize i = 0; i < m_capacity; ++i)
+                m_sparse[i] = i + 1 < m_capacity ? static_cast<u32>(i + 1) : SPLIT_NONE;
+            m_free = m_capacity > 0 ? 0 : SPLIT_NONE;
+        }
+
+        ~SplitPool(void) {
+            std::free(m_hot);
+            std::free(m_cold);
+            std::free(m_sparse);
+            std::free(m_generation);
+        }
+
+        /*
+         * Adds an entry, returning its handle, or one with index `SPLIT_NONE`
+         * if the pool is full.
+         */
+        auto create(Hot const& hot, Cold const& cold) -> SplitHandle {
+            if (m_free == SPLIT_NONE) return SplitHandle{ SPLIT_NONE, 0 };
+
+            if (m_count == m_block_count * N) {
+                if (m_block_count >= m_max_blocks) return SplitHandle{ SPLIT_NONE, 0 };
+                SplitHotBlock<Hot, N> *const hot_block = m_hot_pool.allocate();
+                if (hot_block == nullptr) return SplitHandle{ SPLIT_NONE, 0 };
+                SplitColdBlock<Cold, N> *const cold_block = m_cold_pool.allocate();
+                if (cold_block == nullptr) {
+                    m_hot_pool.deallocate(hot_block);
+                    return SplitHandle{ SPLIT_NONE, 0 };
+                }
+                m_hot[m_block_count] = hot_block;
+                m_cold[m_block_count] = cold_block;
+                ++m_block_count;
+            }
+
+            u32 const handle = m_free;
+            m_free = m_sparse[handle];
+            ++m_version;
+
+            usize const i = m_count++;
+            m_sparse[handle] = static_cast<u32>(i);
+            m_hot[i / N]->items[i % N] = hot;
+            m_cold[i / N]->items[i % N] = cold;
+            m_cold[i / N]->handles[i % N] = handle;
+            return SplitHandle{ handle, m_generation[handle] };
+        }
+
+        /*
+         * Removes an entry, moving the last entry into its place. Returns
+         * false, changing nothing, if the handle is stale.
+         */
+        auto destroy(SplitHandle const entry) -> bool {
+            if (!alive(entry)) return false;
+            u32 const handle = entry.index;
+            usize const i = m_sparse[handle];
+            usize const last = --m_count;
+            ++m_version;
+
+            if (i != last) {
+                m_hot[i / N]->items[i % N] = m_hot[last / N]->items[last % N];
+                m_cold[i / N]->items[i % N] = m_cold[last / N]->items[last % N];
+                u32 const moved = m_cold[last / N]->handles[last % N];
+                m_cold[i / N]->handles[i % N] = moved;
+                m_sparse[moved] = static_cast<u32>(i);
+            }
+
+            m_sparse[handle] = m_free;
+            m_free = handle;
+            ++m_generation[handle];
+
+            // Hand an emptied last block back to both pools.
+            if (m_count <= (m_block_count - 1) * N) {
+                --m_block_count;
+                m_hot_pool.deallocate(m_hot[m_block_count]);
+                m_cold_pool.deallocate(m_cold[m_block_count]);
+            }
+            return true;
+        }
+
+        /*
+         * Whether a handle still refers to a live entry. A free index's
+         * sparse entry is a free list link, so it must also point at a
+         * packed entry that points back.
+         */
+        auto alive(SplitHandle const entry) -> bool {
+            if (entry.index >= m_capacity || m_generation[entry.index] != entry.generation) return false;
+            usize const i = m_sparse[entry.index];
+            return i < m_count && m_cold[i / N]->handles[i % N] == entry.index;
+        }
+
+        // Hot part of an entry, or `nullptr` if the handle is stale
+        auto hot(SplitHandle const entry) -> Hot* {
+            if (!alive(entry)) return nullptr;
+            usize const i = m_sparse[entry.index];
+            return &m_hot[i / N]->items[i % N];
+        }
+
+        // Cold part of an entry, or `nullptr` if the handle is stale
+        auto cold(SplitHandle const entry) -> Cold* {
+            if (!alive(entry)) return nullptr;
+            usize const i = m_sparse[entry.index];
+            return &m_cold[i / N]->items[i % N];
+        }
+
+        // Hot part of the entry at packed position `i`
+        auto hot_at(usize const i) -> Hot* { return &m_hot[i / N]->items[i % N]; }
+
+        // Handle of the entry at packed position `i`
+        auto handle_at(usize const i) -> SplitHandle {
+            u32 const handle = m_cold[i / N]->handles[i % N];
+            return SplitHandle{ handle, m_generation[handle] };
+        }
+
+        /*
+         * Calls `fn(usize n, Hot *items)` for each block of hot data.
+         */
+        template <class F> void each_hot(F &&fn) {
+            for (usize b = 0; b * N < m_count; ++b)
+                fn(m_count - b * N < N ? m_count - b * N : N, m_hot[b]->items);
+        }
+
+        /*
+         * Calls `fn(usize n, Hot *hot, Cold *cold)` for each block, for the
+         * rare passes that need both halves.
+         */
+        template <class F> void each(F &&fn) {
+            for (usize b = 0; b * N < m_count; ++b)
+                fn(m_count - b * N < N ? m_count - b * N : N, m_hot[b]->items, m_cold[b]->items);
+        }
+
+        /*
+         * Reorders every entry so the entry at packed position `order[j]`
+         * moves to position `j`, keeping handles valid.
+         *
+         * `hot_scratch`, `cold_scratch` and `handle_scratch` must each hold
+         * `count()` items.
+         */
+        void permute(
+            u32 const *const order,
+            Hot *const hot_scratch, Cold *const cold_scratch, u32 *const handle_scratch
+        ) {
+            for (usize j = 0; j < m_count; ++j) {
+                usize const i = order[j];
+                hot_scratch[j] = m_hot[i / N]->items[i % N];
+                cold_scratch[j] = m_cold[i / N]->items[i % N];
+                handle_scratch[j] = m_cold[i / N]->handles[i % N];
+            }
+
+            for (usize j = 0; j < m_count; ++j) {
+                m_hot[j / N]->items[j % N] = hot_scratch[j];
+                m_cold[j / N]->items[j % N] = cold_scratch[j];
+                m_cold[j / N]->handles[j % N] = handle_scratch[j];
+                m_sparse[handle_scratch[j]] = static_cast<u32>(j);
+            }
+        }
+
+        // Number of entries
+        auto count(void) -> usize { return m_count; }
+
+        // Changes every time an entry is created or destroyed
+        auto version(void) -> u64 { return m_version; }
+
+    private:
+        // One block per chunk, so each pool is a source of whole blocks
+        PoolAllocator<SplitHotBlock<Hot, N>> m_hot_pool;
+        PoolAllocator<SplitColdBlock<Cold, N>> m_cold_pool;
+
+        // Blocks in use, in packed order
+        SplitHotBlock<Hot, N> **m_hot;
+        SplitColdBlock<Cold, N> **m_cold;
+        usize m_block_count;
+        usize m_max_blocks;
+
+        // Packed position of each live handle, or the next free handle
+        u32 *m_sparse;
+        // Bumped each time a handle's entry is destroyed
+        u32 *m_generation;
+        usize m_capacity;
+        u32 m_free;
+        usize m_count;
+        u64 m_version = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef LVECTOR_HPP
+#define LVECTOR_HPP
+
+#include <cstring>
+#include <type_traits>
+#include "ldata.h"
+#include "lpool.hpp"
+
+namespace llib {
+    /*
+     * Whether a `T` can be moved to a new address with `memcpy`, leaving the
+     * old bytes to be forgotten rather than destroyed. True for trivially
+     * copyable types, and specialised for containers that hold no pointers to
+     * themselves.
+     */
+    template <class T> struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+    template <class T> constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+    /*
+     * Moves `n` objects from `from` to `to`, which must not overlap. Only for
+     * trivially relocatable types, where it's a single `memcpy`.
+     */
+    template <class T> void relocate(T *const to, T *const from, usize const n) {
+        static_assert(is_trivially_relocatable_v<T>, "relocate needs a trivially relocatable type");
+        std::memcpy(static_cast<void *>(to), static_cast<void const *>(from), n * sizeof(T));
+    }
+
+    /*
+     * A vector of at most `N` items stored inline, which never allocates.
+     *
+     * Items must be trivially copyable, which makes the vector trivially
+     * copyable too, so arrays of them can be copied and compacted in bulk.
+     */
+    template <class T, usize N> struct StaticVector {
+        static_assert(std::is_trivially_copyable_v<T>, "StaticVector items must be trivially copyable");
+
+        StaticVector(void): m_size(0) {}
+
+        // Appends an item, returning false if the vector is full
+        auto push_back(T const& item) -> bool {
+            if (m_size == N) return false;
+            std::memcpy(static_cast<void *>(&m_items[m_size * sizeof(T)]), &item, sizeof(T));
+            ++m_size;
+            return true;
+        }
+
+        void pop_back(void) { --m_size; }
+
+        // Removes item `i` by moving the last item into its place
+        void erase_swap(usize const i) {
+            data()[i] = data()[m_size - 1];
+            --m_size;
+        }
+
+        // Removes item `i`, keeping the order of the rest
+        void erase(usize const i) {
+            std::memmove(static_cast<void *>(data() + i), data() + i + 1, (m_size - i - 1) * sizeof(T));
+            --m_size;
+        }
+
+        void clear(void) { m_size = 0; }
+
+        auto operator[](usize const i) -> T& { return data()[i]; }
+        auto back(void) -> T& { return data()[m_size - 1]; }
+        auto data(void) -> T* { return reinterpret_cast<T *>(m_items); }
+        auto begin(void) -> T* { return data(); }
+        auto end(void) -> T* { return data() + m_size; }
+
+        auto size(void) -> usize { return m_size; }
+        auto empty(void) -> bool { return m_size == 0; }
+        auto full(void) -> bool { return m_size == N; }
+        static constexpr auto capacity(void) -> usize { return N; }
+
+    private:
+        alignas(T) u8 m_items[N * sizeof(T)];
+        u32 m_size;
+    };
+
+    // The buffer a small vector spills into, one chunk of a pool allocator
+    template <class T, usize S> struct SmallSpill {
+        alignas(T) u8 items[S * sizeof(T)];
+    };
+
+    /*
+     * A vector of up to `N` items stored inline, spilling into a buffer of
+     * up to `S` items from a pool allocator shared by many vectors.
+     *
+     * Lists that are usually short, like per entity buffs or hit lists, stay
+     * inline and cost no allocation, and the few that grow take a fixed size
+     * chunk from the pool rather than the heap. Without a pool, or when the
+     * pool is out of blocks, the vector stays at `N` and `push_back` fails.
+     *
+     * The vector never points into itself, finding its inline items by
+     * address each time, so it's trivially relocatable: an array of them can
+     * be compacted with `memcpy` and the spilled buffers go along with them.
+     */
+    template <class T, usize N, usize S = N * 4> struct SmallVector {
+        static_assert(std::is_trivially_copyable_v<T>, "SmallVector items must be trivially copyable");
+        static_assert(S > N, "SmallVector spill buffers must be larger than the inline storage");
+
+        using Spill = SmallSpill<T, S>;
+
+        SmallVector(void) = delete;
+        SmallVector(SmallVector const&) = delete;
+        SmallVector operator=(SmallVector&) = delete;
+
+        /*
+         * - pool provides spill buffers, or `nullptr` to never spill
+         */
+        SmallVector(PoolAllocator<Spill> *const pool): m_spill(nullptr), m_pool(pool), m_size(0) {}
+
+        // Gives any spill buffer back to the pool
+        ~SmallVector(void) {
+            if (m_spill != nullptr) m_pool->deallocate(m_spill);
+        }
+
+        /*
+         * Appends an item, spilling to the pool when the inline storage is
+         * full. Returns false if there's no room and no buffer to be had.
+         */
+        auto push_back(T const& item) -> bool {
+            if (m_size == N && m_spill == nullptr && !_spill()) return false;
+            if (m_size == S) return false;
+            std::memcpy(static_cast<void *>(data() + m_size), &item, sizeof(T));
+            ++m_size;
+            return true;
+        }
+
+        void pop_back(void) { --m_size; }
+
+        // Removes item `i` by moving the last item into its place
+        void erase_swap(usize const i) {
+            T *const items = data();
+            items[i] = items[m_size - 1];
+            --m_size;
+        }
+
+        // Removes item `i`, keeping the order of the rest
+        void erase(usize const i) {
+            T *const items = data();
+            std::memmove(static_cast<void *>(items + i), items + i + 1, (m_size - i - 1) * sizeof(T));
+            --m_size;
+        }
+
+        // Removes every item, giving any spill buffer back
+        void clear(void) {
+            m_size = 0;
+            shrink();
+        }
+
+        /*
+         * Moves the items back inline and gives the spill buffer back, if
+         * they fit.
+         */
+        void shrink(void) {
+            if (m_spill == nullptr || m_size > N) return;
+            std::memcpy(m_inline, m_spill->items, m_size * sizeof(T));
+            m_pool->deallocate(m_spill);
+            m_spill = nullptr;
+        }
+
+        auto operator[](usize const i) -> T& { return data()[i]; }
+        auto back(void) -> T& { return data()[m_size - 1]; }
+        auto data(void) -> T* { return reinterpret_cast<T *>(m_spill != nullptr ? m_spill->items : m_inline); }
+        auto begin(void) -> T* { return data(); }
+        auto end(void) -> T* { return data() + m_size; }
+
+        auto size(void) -> usize { return m_size; }
+        auto empty(void) -> bool { return m_size == 0; }
+        auto capacity(void) -> usize { return m_spill != nullptr ? S : N; }
+
+        // Whether the items live in a pool buffer
+        auto spilled(void) -> bool { return m_spill != nullptr; }
+
+    private:
+        auto _spill(void) -> bool {
+            if (m_pool == nullptr) return false;
+            Spill *const spill = m_pool->allocate();
+            if (spill == nullptr) return false;
+            std::memcpy(spill->items, m_inline, m_size * sizeof(T));
+            m_spill = spill;
+            return true;
+        }
+
+        alignas(T) u8 m_inline[N * sizeof(T)];
+        Spill *m_spill;
+        PoolAllocator<Spill> *m_pool;
+        u32 m_size;
+    };
+
+    template <class T, usize N, usize S> struct is_trivially_relocatable<SmallVector<T, N, S>> : std::true_type {};
+}
+
+#endif
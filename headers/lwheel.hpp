@@ -0,0 +1,210 @@
+#ifndef LWHEEL_HPP
+#define LWHEEL_HPP
+
+#include <cstddef>
+#include "ldata.h"
+#include "lpool.hpp"
+
+namespace llib {
+    // Bits of the tick count covered by each level of the wheel
+    constexpr usize LWHEEL_BITS = 8;
+
+    // Slots per level
+    constexpr usize LWHEEL_SLOTS = 1 << LWHEEL_BITS;
+
+    // Levels, together covering delays of up to 2^32 ticks
+    constexpr usize LWHEEL_LEVELS = 4;
+
+    // Owning systems timers can be handed back to
+    constexpr usize LWHEEL_MAX_OWNERS = 16;
+
+    // Expirations gathered per owner before they are handed over
+    constexpr usize LWHEEL_BATCH = 256;
+
+    /*
+     * A scheduled timer, living in one slot's list until it fires or is
+     * cancelled.
+     *
+     * `pprev` points at whatever points to this node, either the slot's head or
+     * the previous node's `next`, so a node can unlink itself without knowing
+     * which slot it is in.
+     */
+    struct TimerNode {
+        TimerNode *next;
+        TimerNode **pprev;
+
+        // Tick the timer fires on
+        u64 expires;
+
+        // Value handed back to the owner, such as an object index or handle
+        u64 payload;
+
+        // System the timer belongs to
+        u32 owner;
+    };
+
+    /*
+     * The hierarchical timing wheel.
+     *
+     * Level 0 has one slot per tick for the next 256 ticks, level 1 one slot
+     * per 256 ticks, and so on. Scheduling and cancelling are O(1) list
+     * operations. Each tick only the current level 0 slot is visited, and
+     * every 256 ticks one slot of the level above is spread back down, so
+     * objects that aren't expiring are never looked at.
+     *
+     * Timer nodes come from a pool allocator. Expired timers are grouped by
+     * owner and handed over in batches rather than one call per timer.
+     */
+    struct TimingWheel {
+        TimingWheel(void) = delete;
+        TimingWheel(TimingWheel const&) = delete;
+        TimingWheel operator=(TimingWheel&) = delete;
+
+        /*
+         * - nodes_per_block is the number of timers in each pool block
+         * - max_blocks is the number of blocks the timer pool may use
+         */
+        TimingWheel(usize const nodes_per_block, usize const max_blocks):
+            m_nodes(nodes_per_block, max_blocks)
+        {
+            m_now = 0;
+            m_pending = 0;
+            for (usize l = 0; l < LWHEEL_LEVELS; ++l)
+                for (usize s = 0; s < LWHEEL_SLOTS; ++s)
+                    m_slots[l][s] = nullptr;
+            for (usize o = 0; o < LWHEEL_MAX_OWNERS; ++o) m_batch_size[o] = 0;
+        }
+
+        /*
+         * Schedules a timer `delay` ticks from now, at least one.
+         *
+         * Returns the timer's node, used to cancel it, or `nullptr` if the
+         * timer pool is full or the owner is out of range.
+         */
+        auto schedule(u64 const delay, u32 const owner, u64 const payload) -> TimerNode* {
+            if (owner >= LWHEEL_MAX_OWNERS) return nullptr;
+
+            TimerNode *const node = m_nodes.allocate();
+            if (node == nullptr) return nullptr;
+
+            u64 const max_delay = (u64(1) << (LWHEEL_BITS * LWHEEL_LEVELS)) - 1;
+            u64 const clamped = delay == 0 ? 1 : (delay > max_delay ? max_delay : delay);
+
+            node->expires = m_now + clamped;
+            node->payload = payload;
+            node->owner = owner;
+            _link(node);
+            ++m_pending;
+            return node;
+        }
+
+        /*
+         * Cancels a timer that hasn't fired yet.
+         */
+        void cancel(TimerNode *const node) {
+            _unlink(node);
+            m_nodes.deallocate(node);
+            --m_pending;
+        }
+
+        /*
+         * Advances one tick, calling
+         * `deliver(u32 owner, u64 const *payloads, usize n)` for every batch
+         * of timers that fire on it.
+         *
+         * Returns the number of timers fired.
+         */
+        template <class F> auto advance(F &&deliver) -> usize {
+            ++m_now;
+
+            // Every time a level wraps, spread the next slot of the level
+            // above back down.
+            for (usize l = 1; l < LWHEEL_LEVELS; ++l) {
+                if ((m_now & ((u64(1) << (LWHEEL_BITS * l)) - 1)) != 0) break;
+                _cascade(l, (m_now >> (LWHEEL_BITS * l)) & (LWHEEL_SLOTS - 1));
+            }
+
+            TimerNode *node = m_slots[0][m_now & (LWHEEL_SLOTS - 1)];
+            m_slots[0][m_now & (LWHEEL_SLOTS - 1)] = nullptr;
+
+            usize fired = 0;
+            while (node != nullptr) {
+                TimerNode *const next = node->next;
+                u32 const owner = node->owner;
+
+                m_batch[owner][m_batch_size[owner]++] = node->payload;
+                if (m_batch_size[owner] == LWHEEL_BATCH) {
+                    deliver(owner, static_cast<u64 const *>(m_batch[owner]), LWHEEL_BATCH);
+                    m_batch_size[owner] = 0;
+                }
+
+                m_nodes.deallocate(node);
+                ++fired;
+                node = next;
+            }
+
+            for (u32 o = 0; o < LWHEEL_MAX_OWNERS; ++o) {
+                if (m_batch_size[o] == 0) continue;
+                deliver(o, static_cast<u64 const *>(m_batch[o]), m_batch_size[o]);
+                m_batch_size[o] = 0;
+            }
+
+            m_pending -= fired;
+            return fired;
+        }
+
+        // Current tick
+        auto now(void) -> u64 { return m_now; }
+
+        // Timers scheduled and not yet fired or cancelled
+        auto pending(void) -> usize { return m_pending; }
+
+    private:
+        // Puts a node in the slot for its expiry, relative to the current tick
+        void _link(TimerNode *const node) {
+            u64 const delta = node->expires - m_now;
+            usize level = 0;
+            while (level + 1 < LWHEEL_LEVELS && delta >= (u64(1) << (LWHEEL_BITS * (level + 1)))) ++level;
+
+            usize const slot = (node->expires >> (LWHEEL_BITS * level)) & (LWHEEL_SLOTS - 1);
+            TimerNode **const head = &m_slots[level][slot];
+
+            node->next = *head;
+            node->pprev = head;
+            if (*head != nullptr) (*head)->pprev = &node->next;
+            *head = node;
+        }
+
+        void _unlink(TimerNode *const node) {
+            *node->pprev = node->next;
+            if (node->next != nullptr) node->next->pprev = node->pprev;
+        }
+
+        // Re-links every node in a slot, moving them to lower levels
+        void _cascade(usize const level, usize const slot) {
+            TimerNode *node = m_slots[level][slot];
+            m_slots[level][slot] = nullptr;
+
+            while (node != nullptr) {
+                TimerNode *const next = node->next;
+                _link(node);
+                node = next;
+            }
+        }
+
+        // Allocator for timer nodes
+        PoolAllocator<TimerNode> m_nodes;
+
+        // Heads of each slot's list of timers
+        TimerNode *m_slots[LWHEEL_LEVELS][LWHEEL_SLOTS];
+
+        // Expired payloads waiting to be handed to each owner
+        u64 m_batch[LWHEEL_MAX_OWNERS][LWHEEL_BATCH];
+        usize m_batch_size[LWHEEL_MAX_OWNERS];
+
+        u64 m_now;
+        usize m_pending;
+    };
+}
+
+#endif
@@ -0,0 +1,349 @@
+#ifndef AI_HPP
+#define AI_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include "../headers/ldata.h"
+#include "enemy.hpp"
+#include "projectile.hpp"
+#include "weapon.hpp"
+
+namespace game {
+    // Most actions an archetype can choose between
+    constexpr usize AI_MAX_ACTIONS = 8;
+
+    // Most considerations scoring a single action
+    constexpr usize AI_MAX_CONSIDERATIONS = 4;
+
+    // What an enemy knows about the world, each normalised to [0, 1]
+    enum AiInput : u8 {
+        // Distance to the player as a fraction of the sense range
+        AI_INPUT_DISTANCE,
+        // Health as a fraction of the archetype's max health
+        AI_INPUT_HEALTH,
+        // 1 when the weapon is ready to fire, otherwise 0
+        AI_INPUT_READY,
+        AI_INPUT_COUNT
+    };
+
+    // How an input is mapped to a score
+    enum AiCurve : u8 {
+        // slope * (x - shift) + offset
+        AI_CURVE_LINEAR,
+        // slope * (x - shift)^2 + offset
+        AI_CURVE_QUADRATIC,
+        // A smooth step centred on `shift` with steepness `slope`, plus offset
+        AI_CURVE_SIGMOID
+    };
+
+    enum AiActionKind : u8 {
+        AI_ACTION_IDLE,
+        AI_ACTION_CHASE,
+        AI_ACTION_FLEE,
+        AI_ACTION_STRAFE,
+        AI_ACTION_SHOOT
+    };
+
+    struct AiConsideration {
+        AiInput input;
+        AiCurve curve;
+        f32 slope;
+        f32 shift;
+        f32 offset;
+    };
+
+    struct AiAction {
+        AiActionKind kind;
+        u8 consideration_count;
+        f32 weight;
+        AiConsideration considerations[AI_MAX_CONSIDERATIONS];
+    };
+
+    /*
+     * Everything shared by enemies of one type: stats, the actions they choose
+     * between and the weapon they fire.
+     */
+    struct Archetype {
+        f32 speed;
+        f32 max_health;
+        f32 sense_range;
+        f32 fire_interval;
+        WeaponProgram const *weapon;
+        u8 action_count;
+        AiAction actions[AI_MAX_ACTIONS];
+    };
+
+    /*
+     * Whether an archetype fits the fixed size tables, which matters once
+     * archetypes come from data: at most `AI_MAX_ACTIONS` actions of at most
+     * `AI_MAX_CONSIDERATIONS` considerations, each reading a real input.
+     */
+    inline auto archetype_valid(Archetype const& archetype) -> bool {
+        if (archetype.action_count > AI_MAX_ACTIONS) return false;
+        for (u8 a = 0; a < archetype.action_count; ++a) {
+            AiAction const& action = archetype.actions[a];
+            if (action.consideration_count > AI_MAX_CONSIDERATIONS) return false;
+            for (u8 c = 0; c < action.consideration_count; ++c)
+                if (action.considerations[c].input >= AI_INPUT_COUNT) return false;
+        }
+        return true;
+    }
+
+    /*
+     * The utility AI system.
+     *
+     * A whole enemy batch is thought about at once. Inputs are gathered into
+     * flat arrays, every action is scored for every enemy with one branch free
+     * loop per consideration, the best action is picked per enemy, and enemies
+     * are then grouped by action so each action runs once over its group. The
+     * only branches are per archetype and per action, never per enemy, so the
+     * cost grows with the number of archetypes rather than enemy types mixed
+     * through one list.
+     */
+    struct UtilityAi {
+        UtilityAi(void) = delete;
+        UtilityAi(UtilityAi const&) = delete;
+        UtilityAi operator=(UtilityAi&) = delete;
+
+        /*
+         * Allocates scratch space for thinking about `capacity` enemies at a
+         * time. If the allocation fails `update` does nothing.
+         */
+        UtilityAi(usize const capacity) {
+            m_memory = std::calloc(capacity, bytes_per_enemy);
+            m_capacity = m_memory != nullptr ? capacity : 0;
+
+            f32 *f = reinterpret_cast<f32 *>(m_memory);
+            for (usize i = 0; i < AI_INPUT_COUNT; ++i, f += m_capacity) m_inputs[i] = f;
+            m_dir_x = f; f += m_capacity;
+            m_dir_y = f; f += m_capacity;
+            m_score = f; f += m_capacity;
+            m_best_score = f; f += m_capacity;
+            m_order = reinterpret_cast<u32 *>(f);
+        }
+
+        ~UtilityAi(void) {
+            std::free(m_memory);
+        }
+
+        /*
+         * Thinks for and moves every enemy in `batch` by `dt` seconds.
+         *
+         * Enemies that shoot fire `archetype.weapon` into `projectiles`.
+         * Batches larger than the scratch capacity are thought about a
+         * capacity sized slice at a time. An archetype that isn't
+         * `archetype_valid` is rejected and the batch left as it is.
+         */
+        void update(
+            EnemyBatch &batch,
+            Archetype const& archetype,
+            f32 const player_x, f32 const player_y,
+            f32 const dt,
+            ProjectilePool &projectiles,
+            WeaponInterpreter &interpreter
+        ) {
+            if (m_capacity == 0 || !archetype_valid(archetype)) return;
+            for (usize first = 0; first < batch.count(); first += m_capacity) {
+                usize const left = batch.count() - first;
+                usize const n = left < m_capacity ? left : m_capacity;
+                _gather_inputs(batch, archetype, player_x, player_y, first, n);
+                _choose_actions(batch, archetype, first, n);
+                _run_actions(batch, archetype, first, n, projectiles, interpreter);
+            }
+
+            for (usize i = 0; i < batch.count(); ++i) {
+                batch.x[i] += batch.vx[i] * dt;
+                batch.y[i] += batch.vy[i] * dt;
+                batch.cooldown[i] -= dt;
+            }
+        }
+
+        // Bytes of scratch space used per enemy
+        static constexpr usize bytes_per_enemy =
+            (AI_INPUT_COUNT + 4) * sizeof(f32) + sizeof(u32);
+
+    private:
+        // Each pass works on the `n` enemies from `first`, with scratch
+        // arrays indexed from zero
+        void _gather_inputs(
+            EnemyBatch &batch,
+            Archetype const& archetype,
+            f32 const player_x, f32 const player_y,
+            usize const first, usize const n
+        ) {
+            f32 const inv_range = 1.0f / archetype.sense_range;
+            f32 const inv_health = 1.0f / archetype.max_health;
+            f32 *const distance = m_inputs[AI_INPUT_DISTANCE];
+            f32 *const health = m_inputs[AI_INPUT_HEALTH];
+            f32 *const ready = m_inputs[AI_INPUT_READY];
+
+            f32 const *const x = batch.x + first;
+            f32 const *const y = batch.y + first;
+            f32 const *const hp = batch.health + first;
+            f32 const *const cooldown = batch.cooldown + first;
+
+            for (usize i = 0; i < n; ++i) {
+                f32 const dx = player_x - x[i];
+                f32 const dy = player_y - y[i];
+                f32 const length = std::sqrt(dx * dx + dy * dy) + 1e-6f;
+                f32 const d = length * inv_range;
+                distance[i] = d < 1.0f ? d : 1.0f;
+                health[i] = hp[i] * inv_health;
+                ready[i] = cooldown[i] <= 0.0f ? 1.0f : 0.0f;
+                m_dir_x[i] = dx / length;
+                m_dir_y[i] = dy / length;
+            }
+        }
+
+        void _choose_actions(EnemyBatch &batch, Archetype const& archetype, usize const first, usize const n) {
+            u8 *const chosen = batch.action + first;
+            for (usize i = 0; i < n; ++i) {
+                m_best_score[i] = -1.0f;
+                chosen[i] = 0;
+            }
+
+            for (u8 a = 0; a < archetype.action_count; ++a) {
+                AiAction const& action = archetype.actions[a];
+
+                for (usize i = 0; i < n; ++i) m_score[i] = action.weight;
+
+                // The curve is the same for every enemy, so switch once and run
+                // a straight loop the compiler can vectorise.
+                for (u8 c = 0; c < action.consideration_count; ++c) {
+                    AiConsideration const& con = action.considerations[c];
+                    f32 const *const input = m_inputs[con.input];
+                    f32 const slope = con.slope, shift = con.shift, offset = con.offset;
+
+                    switch (con.curve) {
+                    case AI_CURVE_LINEAR:
+                        for (usize i = 0; i < n; ++i)
+                            m_score[i] *= _saturate(slope * (input[i] - shift) + offset);
+                        break;
+                    case AI_CURVE_QUADRATIC:
+                        for (usize i = 0; i < n; ++i) {
+                            f32 const t = input[i] - shift;
+                            m_score[i] *= _saturate(slope * t * t + offset);
+                        }
+                        break;
+                    case AI_CURVE_SIGMOID:
+                        for (usize i = 0; i < n; ++i) {
+                            f32 const t = slope * (input[i] - shift);
+                            m_score[i] *= _saturate(0.5f + 0.5f * t / (1.0f + std::fabs(t)) + offset);
+                        }
+                        break;
+                    }
+                }
+
+                for (usize i = 0; i < n; ++i) {
+                    bool const better = m_score[i] > m_best_score[i];
+                    m_best_score[i] = better ? m_score[i] : m_best_score[i];
+                    chosen[i] = better ? a : chosen[i];
+                }
+            }
+        }
+
+        void _run_actions(
+            EnemyBatch &batch,
+            Archetype const& archetype,
+            usize const first, usize const n,
+            ProjectilePool &projectiles,
+            WeaponInterpreter &interpreter
+        ) {
+            u8 const *const chosen = batch.action + first;
+
+            // Counting sort enemy indices by chosen action.
+            u32 starts[AI_MAX_ACTIONS + 1] = {};
+            for (usize i = 0; i < n; ++i) ++starts[chosen[i] + 1];
+            for (usize a = 0; a < AI_MAX_ACTIONS; ++a) starts[a + 1] += starts[a];
+
+            u32 cursor[AI_MAX_ACTIONS];
+            for (usize a = 0; a < AI_MAX_ACTIONS; ++a) cursor[a] = starts[a];
+            for (usize i = 0; i < n; ++i) m_order[cursor[chosen[i]]++] = static_cast<u32>(i);
+
+            f32 const speed = archetype.speed;
+            f32 *const x = batch.x + first;
+            f32 *const y = batch.y + first;
+            f32 *const vx = batch.vx + first;
+            f32 *const vy = batch.vy + first;
+            f32 *const cooldown = batch.cooldown + first;
+            u32 *const volley = batch.volley + first;
+
+            for (u8 a = 0; a < archetype.action_count; ++a) {
+                u32 const *const group = m_order + starts[a];
+                usize const group_size = starts[a + 1] - starts[a];
+
+                switch (archetype.actions[a].kind) {
+                case AI_ACTION_IDLE:
+                    for (usize g = 0; g < group_size; ++g) {
+                        u32 const i = group[g];
+                        vx[i] *= 0.9f;
+                        vy[i] *= 0.9f;
+                    }
+                    break;
+                case AI_ACTION_CHASE:
+                    for (usize g = 0; g < group_size; ++g) {
+                        u32 const i = group[g];
+                        vx[i] = m_dir_x[i] * speed;
+                        vy[i] = m_dir_y[i] * speed;
+                    }
+                    break;
+                case AI_ACTION_FLEE:
+                    for (usize g = 0; g < group_size; ++g) {
+                        u32 const i = group[g];
+                        vx[i] = -m_dir_x[i] * speed;
+                        vy[i] = -m_dir_y[i] * speed;
+                    }
+                    break;
+                case AI_ACTION_STRAFE:
+                    for (usize g = 0; g < group_size; ++g) {
+                        u32 const i = group[g];
+                        vx[i] = -m_dir_y[i] * speed;
+                        vy[i] = m_dir_x[i] * speed;
+                    }
+                    break;
+                case AI_ACTION_SHOOT:
+                    for (usize g = 0; g < group_size; ++g) {
+                        u32 const i = group[g];
+                        vx[i] *= 0.5f;
+                        vy[i] *= 0.5f;
+                        if (archetype.weapon == nullptr || cooldown[i] > 0.0f) continue;
+                        interpreter.fire(
+                            *archetype.weapon, projectiles,
+                            x[i], y[i],
+                            m_dir_x[i], m_dir_y[i],
+                            volley[i]++
+                        );
+                        cooldown[i] = archetype.fire_interval;
+                    }
+                    break;
+                }
+            }
+        }
+
+        static auto _saturate(f32 const x) -> f32 {
+            return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+        }
+
+        // Most enemies a single update can think for
+        usize m_capacity;
+
+        // Normalised inputs, one array per `AiInput`
+        f32 *m_inputs[AI_INPUT_COUNT];
+
+        // Unit direction from each enemy to the player
+        f32 *m_dir_x;
+        f32 *m_dir_y;
+
+        // Score of the action being evaluated and the best score so far
+        f32 *m_score;
+        f32 *m_best_score;
+
+        // Enemy indices grouped by chosen action
+        u32 *m_order;
+
+        // Single allocation holding every scratch array
+        ptr m_memory;
+    };
+}
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef AILOD_HPP
+#define AILOD_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "../headers/ldata.h"
+
+namespace game {
+    // Most update frequency tiers a scheduler can have
+    constexpr usize AI_LOD_MAX_TIERS = 8;
+
+    // The last update frame of an entity that has never been scheduled
+    constexpr i64 AI_LOD_NEVER = INT64_MIN;
+
+    /*
+     * An update frequency tier.
+     *
+     * Entities closer than `max_distance` (and further than the previous tier)
+     * think once every `period` frames, spending at most `budget_us`
+     * microseconds per frame. A budget of zero means unlimited.
+     */
+    struct AiTier {
+        f32 max_distance;
+        u32 period;
+        f32 budget_us;
+    };
+
+    // What a tier did in the last frame
+    struct AiTierStats {
+        // Entities currently in the tier
+        usize entities;
+        // Entities updated
+        usize updates;
+        // Entities that were due but pushed to a later frame by the budget
+        usize deferred;
+        // Time spent updating
+        f32 cost_us;
+        // Running average cost of a single update
+        f32 cost_per_update_us;
+    };
+
+    /*
+     * The AI level of detail scheduler.
+     *
+     * Each frame entities are sorted into tiers by distance to the player, with
+     * visible entities always in the first tier. The scheduler remembers the
+     * frame each entity last thought on, and an entity is due once its tier's
+     * `period` frames have passed since then, so moving between tiers never
+     * loses its place. New entities start staggered across the period, so a
+     * tier's cost is spread evenly instead of spiking every `period` frames.
+     * The per tier budget caps how many due entities run when updates are
+     * slow, taking the longest waiting first, and the rest stay due.
+     *
+     * The schedule is kept per entity index, so removing an entity by moving
+     * the last one into its slot must be mirrored with `kill`.
+     *
+     * Every updated entity is told how much time passed since it last thought,
+     * so slower tiers still move at the right speed.
+     */
+    struct AiLodScheduler {
+        AiLodScheduler(void) = delete;
+        AiLodScheduler(AiLodScheduler const&) = delete;
+        AiLodScheduler operator=(AiLodScheduler&) = delete;
+
+        /*
+         * Initialises the scheduler's tiers and scratch space.
+         *
+         * - tiers are ordered by increasing `max_distance`; entities beyond the
+         *   last tier use the last tier
+         * - capacity is the most entities that can be scheduled
+         */
+        AiLodScheduler(AiTier const *const tiers, usize const tier_count, usize const capacity) {
+            m_tier_count = tier_count < AI_LOD_MAX_TIERS ? tier_count : AI_LOD_MAX_TIERS;
+            m_capacity = capacity;
+            m_count = 0;
+            m_frame = 0;
+            m_full_rate_updates = 0;
+            m_scheduled_updates = 0;
+
+            for (usize t = 0; t < m_tier_count; ++t) {
+                m_tiers[t] = tiers[t];
+                if (m_tiers[t].period == 0) m_tiers[t].period = 1;
+                m_stats[t] = AiTierStats{};
+            }
+
+            // No entities are assigned until the first `assign`
+            for (usize t = 0; t <= AI_LOD_MAX_TIERS; ++t) m_tier_start[t] = 0;
+
+            m_memory = std::calloc(capacity, bytes_per_entity);
+            // Without scratch space nothing is scheduled
+            if (m_memory == nullptr) m_capacity = 0;
+            m_last_update = reinterpret_cast<i64 *>(m_memory);
+            m_order = reinterpret_cast<u32 *>(m_last_update + m_capacity);
+            m_due = m_order + m_capacity;
+            m_elapsed = reinterpret_cast<f32 *>(m_due + m_capacity);
+            m_tier = reinterpret_cast<u8 *>(m_elapsed + m_capacity);
+            for (usize i = 0; i < m_capacity; ++i) m_last_update[i] = AI_LOD_NEVER;
+        }
+
+        ~AiLodScheduler(void) {
+            std::free(m_memory);
+        }
+
+        /*
+         * Sorts entities into tiers by their distance to (`player_x`, `player_y`).
+         *
+         * `visible` may be `nullptr`; otherwise any entity with a non zero entry
+         * goes in the first tier. Call once per frame before `run`.
+         */
+        void assign(
+            f32 const *const x, f32 const *const y, u8 const *const visible,
+            usize const count,
+            f32 const player_x, f32 const player_y
+        ) {
+            m_count = count < m_capacity ? count : m_capacity;
+
+            f32 limits[AI_LOD_MAX_TIERS];
+            for (usize t = 0; t < m_tier_count; ++t)
+                limits[t] = m_tiers[t].max_distance * m_tiers[t].max_distance;
+
+            // Pick a tier per entity without branching on the distance.
+            for (usize i = 0; i < m_count; ++i) {
+                f32 const dx = x[i] - player_x;
+                f32 const dy = y[i] - player_y;
+                f32 const d2 = dx * dx + dy * dy;
+                u8 tier = 0;
+                for (usize t = 0; t + 1 < m_tier_count; ++t) tier += d2 > limits[t];
+                if (visible != nullptr && visible[i]) tier = 0;
+                m_tier[i] = tier;
+            }
+
+            // Counting sort entities into their tiers.
+            usize counts[AI_LOD_MAX_TIERS + 1] = {};
+            for (usize i = 0; i < m_count; ++i) ++counts[m_tier[i] + 1];
+            for (usize t = 0; t < m_tier_count; ++t) counts[t + 1] += counts[t];
+            for (usize t = 0; t <= m_tier_count; ++t) m_tier_start[t] = counts[t];
+            for (usize i = 0; i < m_count; ++i) m_order[counts[m_tier[i]]++] = static_cast<u32>(i);
+        }
+
+        /*
+         * Mirrors removing entity `i` by moving entity `last` into its slot,
+         * moving `last`'s schedule with it. Slot `last` is then free, and
+         * whatever is put there next is scheduled as a new entity.
+         */
+        void kill(usize const i, usize const last) {
+            if (last >= m_capacity) return;
+            if (i < m_capacity) m_last_update[i] = m_last_update[last];
+            m_last_update[last] = AI_LOD_NEVER;
+        }
+
+        /*
+         * Runs this frame's share of updates, calling
+         * `update(u32 const *ids, f32 const *elapsed, usize n)` once per tier
+         * with the entities due and the seconds since each last thought.
+         */
+        template <class F> void run(f32 const frame_dt, F &&update) {
+            ++m_frame;
+            m_full_rate_updates += m_count;
+
+            for (usize t = 0; t < m_tier_count; ++t) {
+                AiTier const& tier = m_tiers[t];
+                AiTierStats &stats = m_stats[t];
+                usize const start = m_tier_start[t];
+                usize const size = m_tier_start[t + 1] - start;
+
+                i64 const period = static_cast<i64>(tier.period);
+
+                stats.entities = size;
+                stats.updates = 0;
+                stats.deferred = 0;
+                stats.cost_us = 0.0f;
+                if (size == 0) continue;
+
+                // Gather the entities whose period has passed. New ones are
+                // staggered by index so they come due over the next period.
+                usize due = 0;
+                for (usize k = 0; k < size; ++k) {
+                    u32 const id = m_order[start + k];
+                    if (m_last_update[id] == AI_LOD_NEVER)
+                        m_last_update[id] = m_frame - period + static_cast<i64>(id % tier.period);
+                    if (m_frame - m_last_update[id] >= period) m_due[due++] = id;
+                }
+                if (due == 0) continue;
+
+                // Limit to what the budget affords.
+                usize allowed = due;
+                if (tier.budget_us > 0.0f && stats.cost_per_update_us > 0.0f) {
+                    f32 const affordable = tier.budget_us / stats.cost_per_update_us;
+                    if (affordable < static_cast<f32>(allowed))
+                        allowed = affordable < 1.0f ? 1 : static_cast<usize>(affordable);
+                }
+
+                // Over budget, the longest waiting go first and the rest stay due.
+                if (allowed < due) {
+                    i64 const *const last = m_last_update;
+                    std::nth_element(m_due, m_due + allowed, m_due + due, [last](u32 const a, u32 const b) {
+                        return last[a] < last[b];
+                    });
+                }
+
+                for (usize k = 0; k < allowed; ++k) {
+                    u32 const id = m_due[k];
+                    m_elapsed[k] = static_cast<f32>(m_frame - m_last_update[id]) * frame_dt;
+                    m_last_update[id] = m_frame;
+                }
+
+                auto const begin = std::chrono::steady_clock::now();
+                update(static_cast<u32 const *>(m_due), static_cast<f32 const *>(m_elapsed), allowed);
+                auto const end = std::chrono::steady_clock::now();
+
+                stats.updates = allowed;
+                stats.deferred = due - allowed;
+                stats.cost_us = std::chrono::duration<f32, std::micro>(end - begin).count();
+
+                // Smooth the per update cost so one slow frame doesn't starve a tier.
+                f32 const cost = stats.cost_us / static_cast<f32>(allowed);
+                stats.cost_per_update_us = stats.cost_per_update_us == 0.0f
+                    ? cost : 0.9f * stats.cost_per_update_us + 0.1f * cost;
+
+                m_scheduled_updates += allowed;
+            }
+        }
+
+        // What a tier did in the last frame
+        auto tier_stats(usize const tier) -> AiTierStats const& { return m_stats[tier]; }
+
+        // Number of tiers
+        auto tier_count(void) -> usize { return m_tier_count; }
+
+        // Updates that would have run had every entity thought every frame
+        auto full_rate_updates(void) -> u64 { return m_full_rate_updates; }
+
+        // Updates that actually ran
+        auto scheduled_updates(void) -> u64 { return m_scheduled_updates; }
+
+        /*
+         * Estimated microseconds saved so far, the skipped updates priced at the
+         * average cost of an update in the first tier.
+         */
+        auto saved_us(void) -> f64 {
+            f64 cost = 0.0;
+            for (usize t = 0; t < m_tier_count && cost == 0.0; ++t)
+                cost = m_stats[t].cost_per_update_us;
+            return static_cast<f64>(m_full_rate_updates - m_scheduled_updates) * cost;
+        }
+
+        // Bytes of scratch space used per entity
+        static constexpr usize bytes_per_entity =
+            sizeof(i64) + 2 * sizeof(u32) + sizeof(f32) + sizeof(u8);
+
+    private:
+        AiTier m_tiers[AI_LOD_MAX_TIERS];
+        AiTierStats m_stats[AI_LOD_MAX_TIERS];
+
+        // Offset of each tier's entities in `m_order`
+        usize m_tier_start[AI_LOD_MAX_TIERS + 1];
+
+        usize m_tier_count;
+        usize m_capacity;
+        usize m_count;
+        i64 m_frame;
+        u64 m_full_rate_updates;
+        u64 m_scheduled_updates;
+
+        // Frame each entity last thought on, or `AI_LOD_NEVER`
+        i64 *m_last_update;
+
+        // Entity ids sorted by tier
+        u32 *m_order;
+
+        // This tier's due entities and how long since each last thought
+        u32 *m_due;
+        f32 *m_elapsed;
+
+        // Tier of each entity
+        u8 *m_tier;
+
+        // Single allocation holding every scratch array
+        ptr m_memory;
+    };
+}
+
+#endif
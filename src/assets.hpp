@@ -0,0 +1,59 @@
+#ifndef ASSETS_HPP
+#define ASSETS_HPP
+
+#include <cstring>
+#include "../headers/ldata.h"
+#include "../headers/lassets.hpp"
+#include "weapon.hpp"
+
+namespace game {
+    // What an asset's payload holds, stored as its pack entry's type
+    enum AssetKind : u32 {
+        ASSET_RAW,
+        ASSET_SHAPE,
+        ASSET_ENEMY,
+        ASSET_WEAPON,
+        ASSET_AUDIO
+    };
+
+    // Picks an asset's kind from its file extension, raw if unknown
+    inline auto asset_kind_for(char const *const path) -> AssetKind {
+        char const *const dot = std::strrchr(path, '.');
+        if (dot == nullptr) return ASSET_RAW;
+        if (std::strcmp(dot, ".shape") == 0) return ASSET_SHAPE;
+        if (std::strcmp(dot, ".enemy") == 0) return ASSET_ENEMY;
+        if (std::strcmp(dot, ".weapon") == 0) return ASSET_WEAPON;
+        if (std::strcmp(dot, ".wav") == 0 || std::strcmp(dot, ".ogg") == 0) return ASSET_AUDIO;
+        return ASSET_RAW;
+    }
+
+    /*
+     * A weapon as stored in a pack, followed directly by `modifier_count`
+     * modifiers.
+     */
+    struct WeaponAsset {
+        f32 speed;
+        f32 damage;
+        f32 lifetime;
+        u32 modifier_count;
+    };
+
+    /*
+     * Points a weapon config at a weapon asset in place, without copying.
+     * Returns false if the asset isn't a weapon or is cut short.
+     */
+    inline auto weapon_from_asset(llib::AssetView const& view, WeaponConfig &out) -> bool {
+        if (view.data == nullptr || view.type != ASSET_WEAPON || view.size < sizeof(WeaponAsset)) return false;
+        WeaponAsset const& w = *reinterpret_cast<WeaponAsset const *>(view.data);
+        if ((view.size - sizeof(WeaponAsset)) / sizeof(WeaponModifier) < w.modifier_count) return false;
+
+        out.speed = w.speed;
+        out.damage = w.damage;
+        out.lifetime = w.lifetime;
+        out.modifiers = reinterpret_cast<WeaponModifier const *>(reinterpret_cast<u8 const *>(view.data) + sizeof(WeaponAsset));
+        out.modifier_count = w.modifier_count;
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef ENEMY_HPP
+#define ENEMY_HPP
+
+#include <cstdlib>
+#include "../headers/ldata.h"
+
+namespace game {
+    /*
+     * A batch of enemies that all share one archetype, laid out as a structure
+     * of arrays.
+     *
+     * Keeping every enemy of an archetype together means the AI and movement
+     * passes run over contiguous fields with no per enemy type checks. Like the
+     * projectile pool, live enemies are always the first `count()` entries.
+     */
+    struct EnemyBatch {
+        EnemyBatch(void) = delete;
+        EnemyBatch(EnemyBatch const&) = delete;
+        EnemyBatch operator=(EnemyBatch&) = delete;
+
+        /*
+         * Allocates every field array up front. If the allocation fails the
+         * batch's `capacity()` is zero.
+         *
+         * - archetype is the index of the archetype every enemy in the batch uses
+         * - capacity is the maximum number of live enemies
+         */
+        EnemyBatch(u32 const archetype, usize const capacity) {
+            this->archetype = archetype;
+            m_count = 0;
+            m_memory = std::calloc(capacity, bytes_per_enemy);
+            // Without memory the batch holds nothing and every reserve is empty
+            m_capacity = m_memory != nullptr ? capacity : 0;
+
+            f32 *const f = reinterpret_cast<f32 *>(m_memory);
+            x = f + 0 * m_capacity;
+            y = f + 1 * m_capacity;
+            vx = f + 2 * m_capacity;
+            vy = f + 3 * m_capacity;
+            health = f + 4 * m_capacity;
+            cooldown = f + 5 * m_capacity;
+            volley = reinterpret_cast<u32 *>(f + 6 * m_capacity);
+            action = reinterpret_cast<u8 *>(volley + m_capacity);
+        }
+
+        ~EnemyBatch(void) {
+            std::free(m_memory);
+        }
+
+        /*
+         * Reserves up to `n` contiguous enemy slots at the end of the live range.
+         *
+         * Returns the index of the first reserved slot and writes the number of
+         * slots actually reserved to `reserved`.
+         */
+        auto reserve(usize const n, usize &reserved) -> usize {
+            usize const first = m_count;
+            usize const free_slots = m_capacity - m_count;
+            reserved = n < free_slots ? n : free_slots;
+            m_count += reserved;
+            return first;
+        }
+
+        /*
+         * Removes an enemy by moving the last live enemy into its slot.
+         */
+        void kill(usize const i) {
+            usize const last = --m_count;
+            x[i] = x[last];
+            y[i] = y[last];
+            vx[i] = vx[last];
+            vy[i] = vy[last];
+            health[i] = health[last];
+            cooldown[i] = cooldown[last];
+            volley[i] = volley[last];
+            action[i] = action[last];
+        }
+
+        // Number of live enemies
+        auto count(void) -> usize { return m_count; }
+
+        // Maximum number of live enemies
+        auto capacity(void) -> usize { return m_capacity; }
+
+        // Index of the archetype shared by the batch
+        u32 archetype;
+
+        // Field arrays, valid for indices below `count()`
+        f32 *x;
+        f32 *y;
+        f32 *vx;
+        f32 *vy;
+        f32 *health;
+        f32 *cooldown;
+        u32 *volley;
+        u8 *action;
+
+        // Bytes used by a single enemy across all field arrays
+        static constexpr usize bytes_per_enemy = 6 * sizeof(f32) + sizeof(u32) + sizeof(u8);
+
+    private:
+        // Maximum number of live enemies
+        usize m_capacity;
+
+        // Number of live enemies
+        usize m_count;
+
+        // Single allocation holding every field array
+        ptr m_memory;
+    };
+}
+
+#endif
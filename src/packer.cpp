@@ -0,0 +1,48 @@
+#include "../headers/ldata.h"
+#include "../headers/lassets.hpp"
+#include "assets.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * Builds an asset pack from files: `packer out.pak file...`
+ *
+ * Each asset is named by its path exactly as given and typed by its
+ * extension, so the game looks it up with `hash_name` of the same path.
+ */
+auto main(int const argc, char **const argv) -> int {
+    if (argc < 3) {
+        (void)std::fprintf(stderr, "usage: %s out.pak file...\n", argv[0]);
+        return 1;
+    }
+
+    llib::AssetPackBuilder builder(static_cast<usize>(argc - 2));
+    for (int i = 2; i < argc; ++i) {
+        std::FILE *const file = std::fopen(argv[i], "rb");
+        if (file == nullptr) {
+            (void)std::fprintf(stderr, "can't open %s\n", argv[i]);
+            return 1;
+        }
+
+        (void)std::fseek(file, 0, SEEK_END);
+        long const size = std::ftell(file);
+        (void)std::fseek(file, 0, SEEK_SET);
+        u8 *const data = reinterpret_cast<u8 *>(std::malloc(size > 0 ? static_cast<usize>(size) : 1));
+        bool const read = size >= 0 && std::fread(data, 1, static_cast<usize>(size), file) == static_cast<usize>(size);
+        (void)std::fclose(file);
+
+        if (!read || !builder.add(argv[i], game::asset_kind_for(argv[i]), data, static_cast<usize>(size))) {
+            (void)std::fprintf(stderr, "can't read %s\n", argv[i]);
+            std::free(data);
+            return 1;
+        }
+        std::free(data);
+    }
+
+    if (!builder.write(argv[1])) {
+        (void)std::fprintf(stderr, "can't write %s, or two names share a hash\n", argv[1]);
+        return 1;
+    }
+    (void)std::printf("packed %zu assets into %s\n", builder.count(), argv[1]);
+    return 0;
+}
@@ -0,0 +1,167 @@
+#ifndef PROJECTILE_HPP
+#define PROJECTILE_HPP
+
+#include <cstdlib>
+#include <cstdio>
+#include "../headers/ldata.h"
+
+namespace game {
+    // Behaviour flags carried by every bullet
+    enum ProjectileFlags : u32 {
+        PROJECTILE_NONE   = 0,
+        PROJECTILE_HOMING = 1 << 0,
+        PROJECTILE_BOUNCE = 1 << 1
+    };
+
+    /*
+     * The projectile pool, a fixed capacity store of live bullets laid out as a
+     * structure of arrays.
+     *
+     * Bullet hell fire rates mean thousands of bullets are created and destroyed
+     * every second, so rather than a chunk per bullet the pool keeps each field
+     * in its own tightly packed array. Live bullets are always the first
+     * `count()` entries, so emitting a volley is reserving a contiguous range at
+     * the end and killing a bullet moves the last bullet into its slot.
+     */
+    struct ProjectilePool {
+        ProjectilePool(void) = delete;
+        ProjectilePool(ProjectilePool const&) = delete;
+        ProjectilePool operator=(ProjectilePool&) = delete;
+
+        /*
+         * Allocates every field array up front. If the allocation fails the
+         * pool's `capacity()` is zero.
+         *
+         * - capacity is the maximum number of live bullets
+         */
+        ProjectilePool(usize const capacity) {
+            m_count = 0;
+            m_memory = std::calloc(capacity, bytes_per_bullet);
+            // Without memory the pool holds nothing and every reserve is empty
+            m_capacity = m_memory != nullptr ? capacity : 0;
+
+            // Carve each field array out of the single allocation.
+            f32 *const f = reinterpret_cast<f32 *>(m_memory);
+            x = f + 0 * m_capacity;
+            y = f + 1 * m_capacity;
+            vx = f + 2 * m_capacity;
+            vy = f + 3 * m_capacity;
+            damage = f + 4 * m_capacity;
+            homing = f + 5 * m_capacity;
+            life = f + 6 * m_capacity;
+            flags = reinterpret_cast<u32 *>(f + 7 * m_capacity);
+            bounces = flags + m_capacity;
+        }
+
+        ~ProjectilePool(void) {
+            std::free(m_memory);
+        }
+
+        /*
+         * Reserves up to `n` contiguous bullet slots at the end of the live range.
+         *
+         * Returns the index of the first reserved slot and writes the number of
+         * slots actually reserved to `reserved`, which is less than `n` when the
+         * pool is close to full.
+         */
+        auto reserve(usize const n, usize &reserved) -> usize {
+            usize const first = m_count;
+            usize const free_slots = m_capacity - m_count;
+            reserved = n < free_slots ? n : free_slots;
+            m_count += reserved;
+            return first;
+        }
+
+        /*
+         * Removes a bullet by moving the last live bullet into its slot.
+         */
+        void kill(usize const i) {
+            usize const last = --m_count;
+            x[i] = x[last];
+            y[i] = y[last];
+            vx[i] = vx[last];
+            vy[i] = vy[last];
+            damage[i] = damage[last];
+            homing[i] = homing[last];
+            life[i] = life[last];
+            flags[i] = flags[last];
+            bounces[i] = bounces[last];
+        }
+
+        /*
+         * Advances every bullet by `dt` seconds.
+         *
+         * Homing bullets steer towards (`target_x`, `target_y`) and bouncing
+         * bullets reflect off the edges of the `width` by `height` arena while
+         * they have bounces left. Expired or escaped bullets are killed.
+         */
+        void update(
+            f32 const dt,
+            f32 const target_x, f32 const target_y,
+            f32 const width, f32 const height
+        ) {
+            // Integrate everything first as a straight vectorisable pass.
+            for (usize i = 0; i < m_count; ++i) {
+                x[i] += vx[i] * dt;
+                y[i] += vy[i] * dt;
+                life[i] -= dt;
+            }
+
+            // Then handle the rarer behaviours, walking backwards so kills
+            // don't skip the bullet moved into the freed slot.
+            for (usize i = m_count; i-- > 0;) {
+                if (flags[i] & PROJECTILE_HOMING) {
+                    f32 const turn = homing[i] * dt;
+                    vx[i] += (target_x - x[i]) * turn;
+                    vy[i] += (target_y - y[i]) * turn;
+                }
+
+                bool const outside =
+                    x[i] < 0.0f || x[i] > width || y[i] < 0.0f || y[i] > height;
+
+                if (outside && (flags[i] & PROJECTILE_BOUNCE) && bounces[i] > 0) {
+                    if (x[i] < 0.0f || x[i] > width) vx[i] = -vx[i];
+                    if (y[i] < 0.0f || y[i] > height) vy[i] = -vy[i];
+                    --bounces[i];
+                } else if (outside || life[i] <= 0.0f) {
+                    kill(i);
+                }
+            }
+        }
+
+        // Number of live bullets
+        auto count(void) -> usize { return m_count; }
+
+        // Maximum number of live bullets
+        auto capacity(void) -> usize { return m_capacity; }
+
+        // Removes every bullet
+        void clear(void) { m_count = 0; }
+
+        // Field arrays, valid for indices below `count()`
+        f32 *x;
+        f32 *y;
+        f32 *vx;
+        f32 *vy;
+        f32 *damage;
+        f32 *homing;
+        f32 *life;
+        u32 *flags;
+        u32 *bounces;
+
+        // Bytes used by a single bullet across all field arrays
+        static constexpr usize bytes_per_bullet = 7 * sizeof(f32) + 2 * sizeof(u32);
+
+    private:
+        // Maximum number of live bullets
+        usize m_capacity;
+
+        // Number of live bullets
+        usize m_count;
+
+        // Single allocation holding every field array
+        ptr m_memory;
+    };
+}
+
+#endif
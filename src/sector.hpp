@@ -0,0 +1,722 @@
+#ifndef SECTOR_HPP
+#define SECTOR_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "../headers/ldata.h"
+#include "../headers/lpack.hpp"
+#include "../headers/lpool.hpp"
+
+namespace game {
+    // Width and height of a sector in cells
+    constexpr usize SECTOR_CELLS = 64;
+
+    // Width and height of a cell in world units
+    constexpr f32 SECTOR_CELL_SIZE = 4.0f;
+
+    // Width and height of a sector in world units
+    constexpr f32 SECTOR_SIZE = SECTOR_CELLS * SECTOR_CELL_SIZE;
+
+    // Entity chunks in each block of a sector's pool allocator
+    constexpr usize SECTOR_ENTITIES_PER_BLOCK = 64;
+
+    // Blocks each sector's pool allocator may use
+    constexpr usize SECTOR_MAX_BLOCKS = 4;
+
+    // Most entities a single sector can hold
+    constexpr usize SECTOR_MAX_ENTITIES = SECTOR_ENTITIES_PER_BLOCK * SECTOR_MAX_BLOCKS;
+
+    // Entries a sector's live list starts with, doubling as it fills
+    constexpr u32 SECTOR_LIVE_MIN = 8;
+
+    // Frames a sector must stay at rest before it goes to sleep
+    constexpr u32 SECTOR_SLEEP_FRAMES = 30;
+
+    // Speed (squared) under which an entity counts as resting
+    constexpr f32 SECTOR_REST_SPEED2 = 0.01f;
+
+    // Marks a sector that is not in the awake list
+    constexpr u32 SECTOR_ASLEEP = ~0u;
+
+    // Marks a sector whose cells are packed rather than in a page
+    constexpr u32 SECTOR_COLD = ~0u;
+
+    // Cell pages in each block of the world's page pool
+    constexpr usize SECTOR_PAGES_PER_BLOCK = 64;
+
+    // Marks a missing entity handle
+    constexpr u32 SECTOR_NONE = ~0u;
+
+    enum Material : u8 {
+        MAT_EMPTY,
+        MAT_ROCK,
+        MAT_SAND
+    };
+
+    // A simulated object living in a sector
+    struct SectorEntity {
+        f32 x;
+        f32 y;
+        f32 vx;
+        f32 vy;
+
+        // Sector holding the entity and its slot in that sector's live list
+        u32 sector;
+        u32 slot;
+
+        // Index of the entity's record in the world
+        u32 handle;
+    };
+
+    /*
+     * A handle to an entity. Entities move between sector pools as they
+     * cross borders, so callers hold this rather than a pointer. The
+     * generation changes every time an index is reused, so handles to
+     * despawned entities are recognised as stale.
+     */
+    struct SectorHandle {
+        u32 index;
+        u32 generation;
+    };
+
+    // Where an entity currently lives, or the next free record
+    struct SectorRecord {
+        SectorEntity *entity;
+        u32 generation;
+        u32 next_free;
+    };
+
+    // A sector's cells while it is hot
+    struct SectorPage {
+        u8 cells[SECTOR_CELLS * SECTOR_CELLS];
+    };
+
+    /*
+     * A square region of the world.
+     *
+     * Every entity in the sector is allocated from the sector's own pool, so a
+     * sector's entities sit together in its blocks. The live list grows with
+     * the entities and is freed when the last one leaves, so an empty sector
+     * owns no blocks and no list at all.
+     *
+     * Cells are either hot, in a page from the world's page pool, or cold,
+     * packed with `llib::pack` into a buffer of just the packed size. A cold
+     * sector of nothing but empty cells holds no buffer at all.
+     */
+    struct Sector {
+        Sector(void) = delete;
+        Sector(Sector const&) = delete;
+        Sector operator=(Sector&) = delete;
+
+        Sector(u32 const index):
+            entities(SECTOR_ENTITIES_PER_BLOCK, SECTOR_MAX_BLOCKS),
+            index(index), live_count(0), active_cells(0), rest_frames(0),
+            awake_slot(SECTOR_ASLEEP), cells(nullptr), packed(nullptr), packed_size(0),
+            hot_slot(SECTOR_COLD), live(nullptr), live_capacity(0) {}
+
+        ~Sector(void) {
+            std::free(packed);
+            std::free(live);
+        }
+
+        // Allocator for the sector's entities
+        llib::PoolAllocator<SectorEntity> entities;
+
+        u32 index;
+        u32 live_count;
+
+        // Cells that moved in the last step or were changed since
+        u32 active_cells;
+
+        // Frames the sector has been at rest
+        u32 rest_frames;
+
+        // Position in the world's awake list, or `SECTOR_ASLEEP`
+        u32 awake_slot;
+
+        // Material of each cell, row by row, or `nullptr` while cold
+        u8 *cells;
+
+        // Packed cells while cold, `nullptr` if they are all empty
+        u8 *packed;
+        u32 packed_size;
+
+        // Position in the world's hot list, or `SECTOR_COLD`
+        u32 hot_slot;
+
+        // Live entities, in no particular order, `nullptr` while empty
+        SectorEntity **live;
+        u32 live_capacity;
+    };
+
+    /*
+     * A grid of sectors where only awake sectors are simulated.
+     *
+     * A sector goes to sleep once its cells and entities have been still for
+     * `SECTOR_SLEEP_FRAMES` frames, and is dropped from the awake list so it
+     * costs nothing per frame. It wakes when an entity enters it, a cell in it
+     * or on its border changes, or an explosion lands on it.
+     *
+     * Sectors start cold and empty. Touching a sector's cells, or waking it,
+     * makes it hot, and `freeze_outside` packs sleeping sectors away from the
+     * player again, so on a large map only the cells near the player take a
+     * full page each.
+     */
+    struct World {
+        World(void) = delete;
+        World(World const&) = delete;
+        World operator=(World&) = delete;
+
+        /*
+         * Creates a `width` by `height` grid of sleeping, empty sectors.
+         */
+        World(u32 const width, u32 const height):
+            m_pages(
+                SECTOR_PAGES_PER_BLOCK,
+                (static_cast<usize>(width) * height + SECTOR_PAGES_PER_BLOCK - 1) / SECTOR_PAGES_PER_BLOCK
+            )
+        {
+            m_width = width;
+            m_height = height;
+            m_awake_count = 0;
+            m_hot_count = 0;
+            m_records = nullptr;
+            m_record_count = 0;
+            m_record_slots = 0;
+            m_free = SECTOR_NONE;
+
+            usize const count = static_cast<usize>(width) * height;
+            m_sectors = reinterpret_cast<Sector *>(std::malloc(count * sizeof(Sector)));
+            m_awake = reinterpret_cast<u32 *>(std::malloc(count * sizeof(u32)));
+            m_hot = reinterpret_cast<u32 *>(std::malloc(count * sizeof(u32)));
+
+            for (usize i = 0; i < count; ++i) new (&m_sectors[i]) Sector(static_cast<u32>(i));
+        }
+
+        ~World(void) {
+            usize const count = static_cast<usize>(m_width) * m_height;
+            for (usize i = 0; i < count; ++i) m_sectors[i].~Sector();
+            std::free(m_sectors);
+            std::free(m_awake);
+            std::free(m_hot);
+            std::free(m_records);
+        }
+
+        /*
+         * Creates an entity in the sector under (`x`, `y`), waking it.
+         *
+         * Returns a handle with index `SECTOR_NONE` if the position is outside
+         * the world or the sector is full.
+         */
+        auto spawn(f32 const x, f32 const y, f32 const vx, f32 const vy) -> SectorHandle {
+            Sector *const sector = sector_at(x, y);
+            if (sector == nullptr) return SectorHandle{ SECTOR_NONE, 0 };
+
+            u32 const index = _new_record();
+            if (index == SECTOR_NONE) return SectorHandle{ SECTOR_NONE, 0 };
+
+            SectorEntity *const entity = _insert(*sector);
+            if (entity == nullptr) {
+                _free_record(index);
+                return SectorHandle{ SECTOR_NONE, 0 };
+            }
+
+            *entity = SectorEntity{ x, y, vx, vy, sector->index, entity->slot, index };
+            m_records[index].entity = entity;
+            return SectorHandle{ index, m_records[index].generation };
+        }
+
+        /*
+         * Removes an entity from its sector. Does nothing if the handle is
+         * stale.
+         */
+        void despawn(SectorHandle const handle) {
+            SectorEntity *const e = entity(handle);
+            if (e == nullptr) return;
+            _remove(m_sectors[e->sector], e);
+            _free_record(handle.index);
+        }
+
+        // Whether a handle still refers to a live entity
+        auto alive(SectorHandle const handle) -> bool {
+            return handle.index < m_record_count
+                && m_records[handle.index].generation == handle.generation
+                && m_records[handle.index].entity != nullptr;
+        }
+
+        /*
+         * Returns an entity, or `nullptr` if the handle is stale. The pointer
+         * is valid until the next step, which may move the entity to another
+         * sector.
+         */
+        auto entity(SectorHandle const handle) -> SectorEntity* {
+            return alive(handle) ? m_records[handle.index].entity : nullptr;
+        }
+
+        /*
+         * Material at a world position, rock outside the world. A cold
+         * sector is decoded into scratch rather than thawed, so looking at
+         * the map doesn't pull it back into pages.
+         */
+        auto cell(i32 const cx, i32 const cy) -> u8 {
+            i32 const sx = _floor_div(cx), sy = _floor_div(cy);
+            if (!_in_bounds(sx, sy)) return MAT_ROCK;
+            i32 const lx = cx - sx * static_cast<i32>(SECTOR_CELLS);
+            i32 const ly = cy - sy * static_cast<i32>(SECTOR_CELLS);
+            Sector const& sector = m_sectors[sy * m_width + sx];
+            if (sector.cells != nullptr) return sector.cells[ly * SECTOR_CELLS + lx];
+            if (sector.packed == nullptr) return MAT_EMPTY;
+
+            u8 scratch[SECTOR_CELLS * SECTOR_CELLS];
+            read_cells(sector, scratch);
+            return scratch[ly * SECTOR_CELLS + lx];
+        }
+
+        /*
+         * Changes a cell, waking its sector and any neighbour it borders.
+         */
+        void set_cell(i32 const cx, i32 const cy, u8 const material) {
+            u8 *const c = _cell(cx, cy);
+            if (c == nullptr) return;
+            *c = material;
+            _touch(cx, cy);
+        }
+
+        /*
+         * Wakes every sector touched by a blast of `radius` around (`x`, `y`).
+         */
+        void explosion(f32 const x, f32 const y, f32 const radius) {
+            i32 const x0 = _sector_coord(x - radius), x1 = _sector_coord(x + radius);
+            i32 const y0 = _sector_coord(y - radius), y1 = _sector_coord(y + radius);
+            for (i32 sy = y0; sy <= y1; ++sy)
+                for (i32 sx = x0; sx <= x1; ++sx)
+                    if (_in_bounds(sx, sy)) wake(m_sectors[sy * m_width + sx]);
+        }
+
+        /*
+         * Adds a sector to the awake list, resetting its rest counter.
+         */
+        void wake(Sector &sector) {
+            thaw(sector);
+            sector.rest_frames = 0;
+            if (sector.awake_slot != SECTOR_ASLEEP) return;
+            sector.awake_slot = m_awake_count;
+            m_awake[m_awake_count++] = sector.index;
+        }
+
+        /*
+         * Simulates every awake sector by `dt` seconds, sending sectors that
+         * have rested long enough to sleep.
+         */
+        void step(f32 const dt) {
+            // Sectors woken during the step are simulated from next frame.
+            u32 const awake = m_awake_count;
+
+            for (u32 a = 0; a < awake && a < m_awake_count; ++a) {
+                Sector &sector = m_sectors[m_awake[a]];
+
+                // Without a page the sector's cells can't move this frame
+                if (sector.active_cells > 0 && sector.cells != nullptr) _step_cells(sector);
+                u32 const moving = _step_entities(sector, dt);
+
+                sector.rest_frames = (sector.active_cells == 0 && moving == 0)
+                    ? sector.rest_frames + 1 : 0;
+            }
+
+            // Put rested sectors to sleep, walking backwards so swapped in
+            // sectors have already been checked.
+            for (u32 a = m_awake_count; a-- > 0;) {
+                Sector &sector = m_sectors[m_awake[a]];
+                if (sector.rest_frames < SECTOR_SLEEP_FRAMES) continue;
+
+                u32 const last = m_awake[--m_awake_count];
+                m_awake[a] = last;
+                m_sectors[last].awake_slot = a;
+                sector.awake_slot = SECTOR_ASLEEP;
+            }
+        }
+
+        /*
+         * Makes a sector hot, unpacking its cells into a page, and returns
+         * its cells, or `nullptr` if no page is left, in which case the
+         * sector stays cold.
+         *
+         * Packed cells that fail to decode are lost and the sector comes back
+         * empty.
+         */
+        auto thaw(Sector &sector) -> u8* {
+            if (sector.cells != nullptr) return sector.cells;
+
+            SectorPage *const page = m_pages.allocate();
+            if (page == nullptr) return nullptr;
+
+            sector.cells = page->cells;
+            if (sector.packed != nullptr) {
+                usize const n = SECTOR_CELLS * SECTOR_CELLS;
+                if (!llib::unpack(sector.packed, sector.packed_size, sector.cells, n))
+                    std::memset(sector.cells, MAT_EMPTY, n);
+                std::free(sector.packed);
+                sector.packed = nullptr;
+                sector.packed_size = 0;
+            } else {
+                std::memset(sector.cells, MAT_EMPTY, SECTOR_CELLS * SECTOR_CELLS);
+            }
+
+            sector.hot_slot = m_hot_count;
+            m_hot[m_hot_count++] = sector.index;
+            return sector.cells;
+        }
+
+        /*
+         * Packs a sleeping sector's cells and gives its page back. Returns
+         * false if the sector is awake, already cold, or there's no memory
+         * for its packed cells, leaving it hot.
+         */
+        auto freeze(Sector &sector) -> bool {
+            if (sector.cells == nullptr || sector.awake_slot != SECTOR_ASLEEP) return false;
+
+            if (!_pack(sector, sector.cells)) return false;
+            m_pages.deallocate(sector.cells);
+            sector.cells = nullptr;
+
+            u32 const last = m_hot[--m_hot_count];
+            m_hot[sector.hot_slot] = last;
+            m_sectors[last].hot_slot = sector.hot_slot;
+            sector.hot_slot = SECTOR_COLD;
+            return true;
+        }
+
+        /*
+         * Freezes every sleeping sector more than `radius` sectors away from
+         * the sector under (`x`, `y`), returning how many were frozen.
+         */
+        auto freeze_outside(f32 const x, f32 const y, i32 const radius) -> usize {
+            i32 const sx = _sector_coord(x), sy = _sector_coord(y);
+            usize frozen = 0;
+            // Walking backwards, so sectors swapped in have been checked
+            for (u32 h = m_hot_count; h-- > 0;) {
+                Sector &sector = m_sectors[m_hot[h]];
+                i32 const dx = static_cast<i32>(sector.index % m_width) - sx;
+                i32 const dy = static_cast<i32>(sector.index / m_width) - sy;
+                if (dx <= radius && dx >= -radius && dy <= radius && dy >= -radius) continue;
+                if (freeze(sector)) ++frozen;
+            }
+            return frozen;
+        }
+
+        /*
+         * Replaces a sector's cells, packing them straight into cold storage
+         * if the sector is cold. Sectors never share storage, so different
+         * sectors can be written from different threads.
+         *
+         * If there's no memory for the packed cells the sector is thawed and
+         * written instead, which touches the world's page pool and isn't safe
+         * alongside other writers.
+         */
+        void store_cells(Sector &sector, u8 const *const cells) {
+            usize const n = SECTOR_CELLS * SECTOR_CELLS;
+            if (sector.cells != nullptr) {
+                std::memcpy(sector.cells, cells, n);
+                return;
+            }
+
+            u8 *const old = sector.packed;
+            if (_pack(sector, cells)) {
+                std::free(old);
+                return;
+            }
+            u8 *const page = thaw(sector);
+            if (page != nullptr) std::memcpy(page, cells, n);
+        }
+
+        // Copies a sector's cells to `out`, without thawing it, empty if undecodable
+        void read_cells(Sector const& sector, u8 *const out) {
+            usize const n = SECTOR_CELLS * SECTOR_CELLS;
+            if (sector.cells != nullptr) std::memcpy(out, sector.cells, n);
+            else if (sector.packed == nullptr || !llib::unpack(sector.packed, sector.packed_size, out, n))
+                std::memset(out, MAT_EMPTY, n);
+        }
+
+        // Number of sectors with their cells in a page
+        auto hot_count(void) -> u32 { return m_hot_count; }
+
+        // Bytes of cells held, pages and packed buffers together
+        auto cell_bytes(void) -> usize {
+            usize bytes = static_cast<usize>(m_hot_count) * sizeof(SectorPage);
+            for (usize i = 0; i < sector_count(); ++i) bytes += m_sectors[i].packed_size;
+            return bytes;
+        }
+
+        // The sector under a world position, or `nullptr` outside the world
+        auto sector_at(f32 const x, f32 const y) -> Sector* {
+            i32 const sx = _sector_coord(x), sy = _sector_coord(y);
+            return _in_bounds(sx, sy) ? &m_sectors[sy * m_width + sx] : nullptr;
+        }
+
+        // Number of sectors being simulated
+        auto awake_count(void) -> u32 { return m_awake_count; }
+
+        // Number of sectors in the world
+        auto sector_count(void) -> usize { return static_cast<usize>(m_width) * m_height; }
+
+        auto sector(usize const i) -> Sector& { return m_sectors[i]; }
+        auto width(void) -> u32 { return m_width; }
+        auto height(void) -> u32 { return m_height; }
+
+    private:
+        /*
+         * Packs cells into a new buffer for a sector, none if all empty,
+         * without freeing its old one. Returns false, leaving the sector
+         * untouched, if the buffer can't be allocated.
+         */
+        static auto _pack(Sector &sector, u8 const *const cells) -> bool {
+            usize const n = SECTOR_CELLS * SECTOR_CELLS;
+            usize empty = 0;
+            while (empty < n && cells[empty] == MAT_EMPTY) ++empty;
+            if (empty == n) {
+                sector.packed = nullptr;
+                sector.packed_size = 0;
+                return true;
+            }
+
+            u8 buffer[llib::pack_bound(SECTOR_CELLS * SECTOR_CELLS)];
+            usize const size = llib::pack(cells, n, buffer, SECTOR_CELLS);
+            u8 *const packed = reinterpret_cast<u8 *>(std::malloc(size));
+            if (packed == nullptr) return false;
+            std::memcpy(packed, buffer, size);
+            sector.packed = packed;
+            sector.packed_size = static_cast<u32>(size);
+            return true;
+        }
+
+        auto _new_record(void) -> u32 {
+            u32 index;
+            if (m_free != SECTOR_NONE) {
+                index = m_free;
+                m_free = m_records[index].next_free;
+            } else {
+                if (m_record_count == m_record_slots) {
+                    u32 const slots = m_record_slots == 0 ? 1024 : m_record_slots * 2;
+                    SectorRecord *const records = reinterpret_cast<SectorRecord *>(
+                        std::realloc(m_records, slots * sizeof(SectorRecord))
+                    );
+                    if (records == nullptr) return SECTOR_NONE;
+                    m_records = records;
+                    m_record_slots = slots;
+                }
+                index = m_record_count++;
+                m_records[index].generation = 0;
+            }
+
+            m_records[index].entity = nullptr;
+            m_records[index].next_free = SECTOR_NONE;
+            return index;
+        }
+
+        void _free_record(u32 const index) {
+            SectorRecord &record = m_records[index];
+            record.entity = nullptr;
+            ++record.generation;
+            record.next_free = m_free;
+            m_free = index;
+        }
+
+        auto _insert(Sector &sector) -> SectorEntity* {
+            if (sector.live_count >= SECTOR_MAX_ENTITIES) return nullptr;
+
+            if (sector.live_count == sector.live_capacity) {
+                u32 const capacity = sector.live_capacity == 0 ? SECTOR_LIVE_MIN : sector.live_capacity * 2;
+                SectorEntity **const live = reinterpret_cast<SectorEntity **>(
+                    std::realloc(sector.live, capacity * sizeof(SectorEntity *))
+                );
+                if (live == nullptr) return nullptr;
+                sector.live = live;
+                sector.live_capacity = capacity;
+            }
+
+            SectorEntity *const entity = sector.entities.allocate();
+            if (entity == nullptr) return nullptr;
+
+            entity->sector = sector.index;
+            entity->slot = sector.live_count;
+            sector.live[sector.live_count++] = entity;
+            wake(sector);
+            return entity;
+        }
+
+        void _remove(Sector &sector, SectorEntity *const entity) {
+            SectorEntity *const last = sector.live[--sector.live_count];
+            sector.live[entity->slot] = last;
+            last->slot = entity->slot;
+            sector.entities.deallocate(entity);
+
+            if (sector.live_count == 0) {
+                std::free(sector.live);
+                sector.live = nullptr;
+                sector.live_capacity = 0;
+            }
+        }
+
+        /*
+         * Moves sand one cell down, or diagonally down, scanning bottom up so a
+         * grain only falls once per step. Grains leaving the bottom of the
+         * sector go through the world so the sector below wakes, and the cell
+         * a grain leaves is touched too, so sand resting on it in a sleeping
+         * neighbour wakes and falls.
+         */
+        void _step_cells(Sector &sector) {
+            i32 const base_x = static_cast<i32>((sector.index % m_width) * SECTOR_CELLS);
+            i32 const base_y = static_cast<i32>((sector.index / m_width) * SECTOR_CELLS);
+            u32 moved = 0;
+
+            for (i32 y = SECTOR_CELLS - 1; y >= 0; --y) {
+                for (i32 x = 0; x < static_cast<i32>(SECTOR_CELLS); ++x) {
+                    u8 &here = sector.cells[y * SECTOR_CELLS + x];
+                    if (here != MAT_SAND) continue;
+
+                    i32 const wx = base_x + x, wy = base_y + y;
+                    i32 const options[3] = { 0, -1, 1 };
+                    for (i32 const dx : options) {
+                        u8 *const below = _cell(wx + dx, wy + 1);
+                        if (below == nullptr || *below != MAT_EMPTY) continue;
+                        *below = MAT_SAND;
+                        here = MAT_EMPTY;
+                        _touch(wx + dx, wy + 1);
+                        _touch(wx, wy);
+                        ++moved;
+                        break;
+                    }
+                }
+            }
+
+            sector.active_cells = moved;
+        }
+
+        /*
+         * Moves every entity in a sector, handing entities that cross a border
+         * to the neighbouring sector. Returns the number still moving.
+         */
+        auto _step_entities(Sector &sector, f32 const dt) -> u32 {
+            u32 moving = 0;
+
+            for (u32 i = sector.live_count; i-- > 0;) {
+                SectorEntity &e = *sector.live[i];
+                f32 const x = e.x, y = e.y;
+                e.x += e.vx * dt;
+                e.y += e.vy * dt;
+                e.vx *= 0.98f;
+                e.vy *= 0.98f;
+
+                if (e.vx * e.vx + e.vy * e.vy < SECTOR_REST_SPEED2) {
+                    e.vx = 0.0f;
+                    e.vy = 0.0f;
+                }
+
+                Sector *const next = sector_at(e.x, e.y);
+                if (next == nullptr) {
+                    // Leaving the world removes the entity
+                    u32 const handle = e.handle;
+                    _remove(sector, &e);
+                    _free_record(handle);
+                    continue;
+                }
+
+                if (next != &sector) {
+                    // Move into the neighbour's pool, waking it. A full
+                    // neighbour stops the entity at the border instead.
+                    SectorEntity *const moved = _insert(*next);
+                    if (moved == nullptr) {
+                        e = SectorEntity{ x, y, 0.0f, 0.0f, e.sector, e.slot, e.handle };
+                        continue;
+                    }
+                    *moved = SectorEntity{ e.x, e.y, e.vx, e.vy, next->index, moved->slot, e.handle };
+                    m_records[e.handle].entity = moved;
+                    _remove(sector, &e);
+                    if (moved->vx != 0.0f || moved->vy != 0.0f) ++moving;
+                    continue;
+                }
+
+                if (e.vx != 0.0f || e.vy != 0.0f) ++moving;
+            }
+
+            return moving;
+        }
+
+        // Wakes the sector holding a cell and any sector sharing that border
+        void _touch(i32 const cx, i32 const cy) {
+            i32 const sx = _floor_div(cx), sy = _floor_div(cy);
+            i32 const lx = cx - sx * static_cast<i32>(SECTOR_CELLS);
+            i32 const ly = cy - sy * static_cast<i32>(SECTOR_CELLS);
+            i32 const last = static_cast<i32>(SECTOR_CELLS) - 1;
+
+            Sector &sector = m_sectors[sy * m_width + sx];
+            ++sector.active_cells;
+            wake(sector);
+
+            i32 const nx = lx == 0 ? -1 : (lx == last ? 1 : 0);
+            i32 const ny = ly == 0 ? -1 : (ly == last ? 1 : 0);
+            if (nx != 0 && _in_bounds(sx + nx, sy)) _wake_border(m_sectors[sy * m_width + sx + nx]);
+            if (ny != 0 && _in_bounds(sx, sy + ny)) _wake_border(m_sectors[(sy + ny) * m_width + sx]);
+            if (nx != 0 && ny != 0 && _in_bounds(sx + nx, sy + ny))
+                _wake_border(m_sectors[(sy + ny) * m_width + sx + nx]);
+        }
+
+        // A neighbour's border changed, so its own cells may now move
+        void _wake_border(Sector &sector) {
+            ++sector.active_cells;
+            wake(sector);
+        }
+
+        auto _cell(i32 const cx, i32 const cy) -> u8* {
+            i32 const sx = _floor_div(cx), sy = _floor_div(cy);
+            if (!_in_bounds(sx, sy)) return nullptr;
+            i32 const lx = cx - sx * static_cast<i32>(SECTOR_CELLS);
+            i32 const ly = cy - sy * static_cast<i32>(SECTOR_CELLS);
+            u8 *const cells = thaw(m_sectors[sy * m_width + sx]);
+            return cells == nullptr ? nullptr : &cells[ly * SECTOR_CELLS + lx];
+        }
+
+        auto _in_bounds(i32 const sx, i32 const sy) -> bool {
+            return sx >= 0 && sy >= 0 && sx < static_cast<i32>(m_width) && sy < static_cast<i32>(m_height);
+        }
+
+        static auto _floor_div(i32 const c) -> i32 {
+            i32 const n = static_cast<i32>(SECTOR_CELLS);
+            return c >= 0 ? c / n : -((-c + n - 1) / n);
+        }
+
+        static auto _sector_coord(f32 const v) -> i32 {
+            f32 const s = v / SECTOR_SIZE;
+            i32 const i = static_cast<i32>(s);
+            return s < static_cast<f32>(i) ? i - 1 : i;
+        }
+
+        u32 m_width;
+        u32 m_height;
+
+        // Every sector, row by row
+        Sector *m_sectors;
+
+        // Indices of awake sectors, the first `m_awake_count` entries
+        u32 *m_awake;
+        u32 m_awake_count;
+
+        // Pages of hot sectors' cells
+        llib::PoolAllocator<SectorPage> m_pages;
+
+        // Indices of hot sectors, the first `m_hot_count` entries
+        u32 *m_hot;
+        u32 m_hot_count;
+
+        // Where each handle's entity lives, growing as more are spawned
+        SectorRecord *m_records;
+        u32 m_record_count;
+        u32 m_record_slots;
+
+        // First free record, chained through `next_free`
+        u32 m_free;
+    };
+}
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef SPAWN_HPP
+#define SPAWN_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "../headers/ldata.h"
+#include "enemy.hpp"
+
+namespace game {
+    enum Formation : u8 {
+        // Evenly around a circle of radius `size`, moving inwards
+        FORMATION_RING,
+        // Along a horizontal line `size` units long, moving down
+        FORMATION_LINE,
+        // A square grid with `size` units between enemies, standing still
+        FORMATION_GRID,
+        // Scattered over a square `size` units wide, drifting at random
+        FORMATION_SCATTER
+    };
+
+    /*
+     * One group of enemies in a wave, as written by a designer.
+     */
+    struct WaveGroup {
+        u32 archetype;
+        u32 count;
+        Formation formation;
+
+        // Centre of the formation
+        f32 x;
+        f32 y;
+
+        // Radius, length, spacing or width depending on the formation
+        f32 size;
+
+        f32 speed;
+        f32 health;
+
+        // Spread of starting cooldowns, so a group doesn't fire all at once
+        f32 stagger;
+    };
+
+    /*
+     * A group's precomputed initial state, laid out exactly like the fields
+     * of an `EnemyBatch` so spawning is a copy per field.
+     */
+    struct WaveTable {
+        u32 archetype;
+        u32 count;
+        f32 *x;
+        f32 *y;
+        f32 *vx;
+        f32 *vy;
+        f32 *health;
+        f32 *cooldown;
+    };
+
+    struct Wave {
+        WaveTable *tables;
+        u32 table_count;
+
+        // Single allocation holding the tables and their field arrays
+        ptr memory;
+    };
+
+    /*
+     * The spawn director.
+     *
+     * Every wave is expanded into per group tables when the level loads, so
+     * spawning a wave at runtime is one contiguous reserve in each enemy batch
+     * followed by a `memcpy` per field, with no per enemy setup at all.
+     */
+    struct SpawnDirector {
+        SpawnDirector(void) = delete;
+        SpawnDirector(SpawnDirector const&) = delete;
+        SpawnDirector operator=(SpawnDirector&) = delete;
+
+        /*
+         * - max_waves is the number of waves the director can hold
+         */
+        SpawnDirector(usize const max_waves) {
+            m_max_waves = max_waves;
+            m_wave_count = 0;
+            m_waves = reinterpret_cast<Wave *>(std::calloc(max_waves, sizeof(Wave)));
+        }
+
+        ~SpawnDirector(void) {
+            for (usize i = 0; i < m_wave_count; ++i) std::free(m_waves[i].memory);
+            std::free(m_waves);
+        }
+
+        /*
+         * Precomputes a wave from its groups.
+         *
+         * Returns false if the director is full or out of memory.
+         */
+        auto add_wave(WaveGroup const *const groups, usize const group_count) -> bool {
+            if (m_wave_count >= m_max_waves) return false;
+
+            usize enemies = 0;
+            for (usize g = 0; g < group_count; ++g) enemies += groups[g].count;
+
+            // Headers first, then every field array back to back.
+            usize const header_bytes = group_count * sizeof(WaveTable);
+            u8 *const memory = reinterpret_cast<u8 *>(
+                std::malloc(header_bytes + enemies * fields * sizeof(f32))
+            );
+            if (memory == nullptr) return false;
+
+            Wave &wave = m_waves[m_wave_count++];
+            wave.memory = memory;
+            wave.tables = reinterpret_cast<WaveTable *>(memory);
+            wave.table_count = static_cast<u32>(group_count);
+
+            f32 *f = reinterpret_cast<f32 *>(memory + header_bytes);
+            for (usize g = 0; g < group_count; ++g) {
+                WaveGroup const& group = groups[g];
+                WaveTable &table = wave.tables[g];
+                usize const n = group.count;
+
+                table.archetype = group.archetype;
+                table.count = group.count;
+                table.x = f; f += n;
+                table.y = f; f += n;
+                table.vx = f; f += n;
+                table.vy = f; f += n;
+                table.health = f; f += n;
+                table.cooldown = f; f += n;
+
+                _layout(group, table);
+            }
+
+            return true;
+        }
+
+        /*
+         * Spawns a wave into the enemy batches, indexed by archetype.
+         *
+         * Returns the number of enemies spawned, fewer than the wave holds if
+         * a batch is missing or full.
+         */
+        auto spawn(usize const wave_index, EnemyBatch *const *const batches, usize const batch_count) -> usize {
+            if (wave_index >= m_wave_count) return 0;
+
+            Wave const& wave = m_waves[wave_index];
+            usize spawned = 0;
+
+            for (u32 g = 0; g < wave.table_count; ++g) {
+                WaveTable const& table = wave.tables[g];
+                if (table.archetype >= batch_count || batches[table.archetype] == nullptr) continue;
+
+                EnemyBatch &batch = *batches[table.archetype];
+                usize reserved;
+                usize const first = batch.reserve(table.count, reserved);
+                usize const bytes = reserved * sizeof(f32);
+
+                std::memcpy(batch.x + first, table.x, bytes);
+                std::memcpy(batch.y + first, table.y, bytes);
+                std::memcpy(batch.vx + first, table.vx, bytes);
+                std::memcpy(batch.vy + first, table.vy, bytes);
+                std::memcpy(batch.health + first, table.health, bytes);
+                std::memcpy(batch.cooldown + first, table.cooldown, bytes);
+                std::memset(batch.volley + first, 0, reserved * sizeof(u32));
+                std::memset(batch.action + first, 0, reserved * sizeof(u8));
+
+                spawned += reserved;
+            }
+
+            return spawned;
+        }
+
+        // Number of waves loaded
+        auto wave_count(void) -> usize { return m_wave_count; }
+
+    private:
+        // Float fields per enemy in a wave table
+        static constexpr usize fields = 6;
+
+        // Fills a table with a group's formation
+        static void _layout(WaveGroup const& group, WaveTable &table) {
+            usize const n = group.count;
+            f32 const inv_n = n > 0 ? 1.0f / static_cast<f32>(n) : 0.0f;
+
+            for (usize i = 0; i < n; ++i) {
+                f32 const t = static_cast<f32>(i) * inv_n;
+                f32 x = group.x, y = group.y, vx = 0.0f, vy = 0.0f;
+
+                switch (group.formation) {
+                case FORMATION_RING: {
+                    f32 const angle = 6.28318531f * t;
+                    f32 const c = std::cos(angle), s = std::sin(angle);
+                    x += c * group.size;
+                    y += s * group.size;
+                    vx = -c * group.speed;
+                    vy = -s * group.speed;
+                } break;
+                case FORMATION_LINE:
+                    x += (t - 0.5f) * group.size;
+                    vy = group.speed;
+                    break;
+                case FORMATION_GRID: {
+                    usize const side = static_cast<usize>(std::ceil(std::sqrt(static_cast<f32>(n))));
+                    f32 const half = 0.5f * static_cast<f32>(side - 1) * group.size;
+                    x += static_cast<f32>(i % side) * group.size - half;
+                    y += static_cast<f32>(i / side) * group.size - half;
+                } break;
+                case FORMATION_SCATTER: {
+                    // Hashing the index keeps scattered waves identical between runs.
+                    u32 h = static_cast<u32>(i) * 0x9e3779b9u + table.archetype;
+                    h ^= h >> 16; h *= 0x85ebca6bu; h ^= h >> 13; h *= 0xc2b2ae35u; h ^= h >> 16;
+                    f32 const u = static_cast<f32>(h & 0xffff) / 65535.0f;
+                    f32 const v = static_cast<f32>(h >> 16) / 65535.0f;
+                    x += (u - 0.5f) * group.size;
+                    y += (v - 0.5f) * group.size;
+                    vx = (v - 0.5f) * group.speed;
+                    vy = (u - 0.5f) * group.speed;
+                } break;
+                }
+
+                table.x[i] = x;
+                table.y[i] = y;
+                table.vx[i] = vx;
+                table.vy[i] = vy;
+                table.health[i] = group.health;
+                table.cooldown[i] = group.stagger * t;
+            }
+        }
+
+        Wave *m_waves;
+        usize m_wave_count;
+        usize m_max_waves;
+    };
+}
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef STARFIELD_HPP
+#define STARFIELD_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include "../headers/ldata.h"
+#include "../headers/lpool.hpp"
+#include "../headers/lrandom.hpp"
+
+namespace game {
+    // Most stars a single tile can hold
+    constexpr usize STAR_TILE_MAX = 64;
+
+    // Most parallax layers a starfield can have
+    constexpr usize STAR_MAX_LAYERS = 8;
+
+    // Tile nodes in each block of the cache's pool allocator
+    constexpr usize STAR_TILES_PER_BLOCK = 64;
+
+    // A parallax layer of stars
+    struct StarLayer {
+        // How far the layer moves per unit the camera moves, 1 being the
+        // foreground and smaller values further away
+        f32 parallax;
+        // Width and height of a tile in layer units
+        f32 tile_size;
+        // Stars per tile are picked evenly from this range
+        u32 min_stars;
+        u32 max_stars;
+        f32 min_brightness;
+        f32 max_brightness;
+    };
+
+    /*
+     * A square of one layer's stars, laid out for the renderer, and its place
+     * in the cache.
+     */
+    struct StarTile {
+        // Star positions within the tile, from 0 to the layer's tile size
+        f32 x[STAR_TILE_MAX];
+        f32 y[STAR_TILE_MAX];
+        f32 brightness[STAR_TILE_MAX];
+        u32 count;
+
+        i32 tx;
+        i32 ty;
+        u32 layer;
+
+        // Least recently used list, most recent first
+        StarTile *lru_prev;
+        StarTile *lru_next;
+
+        // Next tile in the same hash bucket
+        StarTile *hash_next;
+
+        // The `visible` call that last returned the tile, which can't evict it
+        u64 pin;
+    };
+
+    // A visible tile and where its origin lands relative to the view's corner
+    struct StarTileView {
+        StarTile const *tile;
+        f32 screen_x;
+        f32 screen_y;
+    };
+
+    // What the cache did since the last `reset_stats`
+    struct StarfieldStats {
+        usize hits;
+        usize misses;
+        usize evictions;
+    };
+
+    /*
+     * The starfield, parallax layers of procedural stars over an unbounded
+     * plane.
+     *
+     * Nothing about a tile is stored except while it is cached: a tile is
+     * built on first view from a generator seeded by its layer and
+     * coordinates, so it comes out the same every time it's rebuilt. Tiles
+     * live in nodes from a pool allocator with a fixed block limit, indexed
+     * by a hash table and ordered by last use, and once the limit is reached
+     * the least recently viewed tile is evicted for the new one. Memory stays
+     * at `max_tiles` tiles however far the camera goes.
+     *
+     * `max_tiles` should cover the tiles visible in one frame across every
+     * layer with some to spare, or tiles will be rebuilt every frame. A
+     * `visible` call never evicts a tile it has already returned, so when
+     * the view needs more than `max_tiles` it returns what fits.
+     */
+    struct Starfield {
+        Starfield(void) = delete;
+        Starfield(Starfield const&) = delete;
+        Starfield operator=(Starfield&) = delete;
+
+        /*
+         * - layers are copied, at most `STAR_MAX_LAYERS`
+         * - max_tiles is the most tiles kept at once
+         */
+        Starfield(StarLayer const *const layers, usize const layer_count, u64 const seed, usize const max_tiles):
+            m_tiles(STAR_TILES_PER_BLOCK, (max_tiles + STAR_TILES_PER_BLOCK - 1) / STAR_TILES_PER_BLOCK)
+        {
+            m_layer_count = layer_count < STAR_MAX_LAYERS ? layer_count : STAR_MAX_LAYERS;
+            for (usize i = 0; i < m_layer_count; ++i) m_layers[i] = layers[i];
+            m_seed = seed;
+            m_max_tiles = max_tiles;
+            m_count = 0;
+            m_pin = 0;
+            m_views = 0;
+            m_lru_head = nullptr;
+            m_lru_tail = nullptr;
+            m_stats = {};
+
+            // A power of two of buckets, at least one per tile
+            m_bucket_mask = 1;
+            while (m_bucket_mask < max_tiles) m_bucket_mask <<= 1;
+            m_buckets = reinterpret_cast<StarTile **>(std::calloc(m_bucket_mask, sizeof(ptr)));
+            --m_bucket_mask;
+        }
+
+        ~Starfield(void) { std::free(m_buckets); }
+
+        /*
+         * Returns a tile, building it if it isn't cached, and marks it as the
+         * most recently used. Returns `nullptr` if `layer` is out of range or
+         * no tile can be allocated or evicted.
+         */
+        auto tile(u32 const layer, i32 const tx, i32 const ty) -> StarTile* {
+            if (layer >= m_layer_count) return nullptr;
+
+            StarTile **const bucket = &m_buckets[_hash(layer, tx, ty) & m_bucket_mask];
+            for (StarTile *t = *bucket; t != nullptr; t = t->hash_next) {
+                if (t->tx == tx && t->ty == ty && t->layer == layer) {
+                    ++m_stats.hits;
+                    _unlink_lru(t);
+                    _push_lru(t);
+                    t->pin = m_pin;
+                    return t;
+                }
+            }
+
+            ++m_stats.misses;
+            StarTile *t = m_count < m_max_tiles ? m_tiles.allocate() : nullptr;
+            if (t == nullptr) {
+                // The tail is the least recent, so if it's pinned they all are.
+                t = m_lru_tail;
+                if (t == nullptr || (m_pin != 0 && t->pin == m_pin)) return nullptr;
+                _evict(t);
+                ++m_stats.evictions;
+            } else {
+                ++m_count;
+            }
+
+            _build(t, layer, tx, ty);
+            t->hash_next = *bucket;
+            *bucket = t;
+            _push_lru(t);
+            t->pin = m_pin;
+            return t;
+        }
+
+        /*
+         * Writes the tiles of every layer that overlap a `view_w` by `view_h`
+         * view whose top left corner is at (`camera_x`, `camera_y`), back
+         * layers first, returning how many were written. At most `max_views`
+         * are written, and fewer if the cache runs out of tiles that weren't
+         * already written.
+         */
+        auto visible(
+            f32 const camera_x, f32 const camera_y, f32 const view_w, f32 const view_h,
+            StarTileView *const views, usize const max_views
+        ) -> usize {
+            m_pin = ++m_views;
+            usize const n = _visible(camera_x, camera_y, view_w, view_h, views, max_views);
+            m_pin = 0;
+            return n;
+        }
+
+        // Tiles currently cached
+        auto cached(void) -> usize { return m_count; }
+
+        // Bytes of tiles the cache can ever hold
+        auto budget_bytes(void) -> usize { return m_max_tiles * sizeof(StarTile); }
+
+        auto stats(void) -> StarfieldStats { return m_stats; }
+        void reset_stats(void) { m_stats = {}; }
+
+    private:
+        auto _visible(
+            f32 const camera_x, f32 const camera_y, f32 const view_w, f32 const view_h,
+            StarTileView *const views, usize const max_views
+        ) -> usize {
+            usize n = 0;
+            for (usize l = 0; l < m_layer_count; ++l) {
+                StarLayer const& layer = m_layers[l];
+                f32 const origin_x = camera_x * layer.parallax, origin_y = camera_y * layer.parallax;
+                i32 const x0 = static_cast<i32>(std::floor(origin_x / layer.tile_size));
+                i32 const y0 = static_cast<i32>(std::floor(origin_y / layer.tile_size));
+                i32 const x1 = static_cast<i32>(std::floor((origin_x + view_w) / layer.tile_size));
+                i32 const y1 = static_cast<i32>(std::floor((origin_y + view_h) / layer.tile_size));
+
+                for (i32 ty = y0; ty <= y1; ++ty) {
+                    for (i32 tx = x0; tx <= x1; ++tx) {
+                        if (n == max_views) return n;
+                        StarTile const *const t = tile(static_cast<u32>(l), tx, ty);
+                        if (t == nullptr) return n;
+                        views[n++] = {
+                            t,
+                            static_cast<f32>(tx) * layer.tile_size - origin_x,
+                            static_cast<f32>(ty) * layer.tile_size - origin_y
+                        };
+                    }
+                }
+            }
+            return n;
+        }
+
+        static auto _hash(u32 const layer, i32 const tx, i32 const ty) -> u64 {
+            u64 key = (static_cast<u64>(static_cast<u32>(tx)) << 32 | static_cast<u32>(ty)) ^ (static_cast<u64>(layer) * 0x9e3779b97f4a7c15ull);
+            return llib::splitmix64(key);
+        }
+
+        // Fills a tile from a generator seeded by its layer and coordinates
+        void _build(StarTile *const t, u32 const layer, i32 const tx, i32 const ty) {
+            StarLayer const& l = m_layers[layer];
+            llib::Xoshiro256 rng(_hash(layer, tx, ty) ^ m_seed);
+
+            u32 const span = l.max_stars > l.min_stars ? l.max_stars - l.min_stars + 1 : 1;
+            u32 const count = l.min_stars + rng.next_below(span);
+            t->count = count < STAR_TILE_MAX ? count : STAR_TILE_MAX;
+            for (u32 i = 0; i < t->count; ++i) {
+                t->x[i] = rng.next_f32() * l.tile_size;
+                t->y[i] = rng.next_f32() * l.tile_size;
+                t->brightness[i] = l.min_brightness + rng.next_f32() * (l.max_brightness - l.min_brightness);
+            }
+
+            t->tx = tx;
+            t->ty = ty;
+            t->layer = layer;
+        }
+
+        // Drops a tile from its bucket and the LRU list, keeping the node
+        void _evict(StarTile *const t) {
+            StarTile **link = &m_buckets[_hash(t->layer, t->tx, t->ty) & m_bucket_mask];
+            while (*link != t) link = &(*link)->hash_next;
+            *link = t->hash_next;
+            _unlink_lru(t);
+        }
+
+        void _push_lru(StarTile *const t) {
+            t->lru_prev = nullptr;
+            t->lru_next = m_lru_head;
+            if (m_lru_head != nullptr) m_lru_head->lru_prev = t;
+            else m_lru_tail = t;
+            m_lru_head = t;
+        }
+
+        void _unlink_lru(StarTile *const t) {
+            if (t->lru_prev != nullptr) t->lru_prev->lru_next = t->lru_next;
+            else m_lru_head = t->lru_next;
+            if (t->lru_next != nullptr) t->lru_next->lru_prev = t->lru_prev;
+            else m_lru_tail = t->lru_prev;
+        }
+
+        StarLayer m_layers[STAR_MAX_LAYERS];
+        usize m_layer_count;
+        u64 m_seed;
+
+        llib::PoolAllocator<StarTile> m_tiles;
+        usize m_max_tiles;
+        usize m_count;
+
+        // Pin of the running `visible` call, or 0 outside one
+        u64 m_pin;
+        u64 m_views;
+
+        StarTile **m_buckets;
+        usize m_bucket_mask;
+
+        StarTile *m_lru_head;
+        StarTile *m_lru_tail;
+
+        StarfieldStats m_stats;
+    };
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef TERRAIN_HPP
+#define TERRAIN_HPP
+
+#include "../headers/ldata.h"
+#include "../headers/ljobs.hpp"
+#include "../headers/lmath.hpp"
+#include "../headers/lnoise.hpp"
+#include "sector.hpp"
+
+namespace game {
+    enum AreaKind : u8 {
+        // Solid rock cut through by winding tunnels
+        AREA_CAVES,
+        // Open space scattered with rock clumps
+        AREA_ASTEROIDS,
+        // Drifting clouds of loose sand
+        AREA_NEBULA
+    };
+
+    /*
+     * Noise settings for world generation. Frequencies are in cycles per
+     * cell.
+     */
+    struct TerrainSettings {
+        u32 seed;
+
+        // Decides which kind of area each cell belongs to
+        llib::NoiseParams areas;
+        // Warped noise, open where it's above `cave_open`
+        llib::NoiseParams caves;
+        f32 cave_open;
+        // Rock where fBm is above `asteroid_solid`
+        llib::NoiseParams asteroids;
+        f32 asteroid_solid;
+        // Sand where a slice of 3D fBm is above `nebula_dense`
+        llib::NoiseParams nebula;
+        f32 nebula_dense;
+
+        // Area noise below this is caves, above `nebula_above` is nebula and
+        // anything between is asteroids
+        f32 caves_below;
+        f32 nebula_above;
+    };
+
+    // Settings giving areas a few hundred cells across
+    inline auto default_terrain(u32 const seed) -> TerrainSettings {
+        return {
+            seed,
+            { seed, 1.0f / 1024.0f, 2, 2.0f, 0.5f, 0.0f },
+            { seed + 1, 1.0f / 96.0f, 4, 2.0f, 0.5f, 24.0f }, 0.1f,
+            { seed + 2, 1.0f / 24.0f, 3, 2.0f, 0.45f, 0.0f }, 0.35f,
+            { seed + 3, 1.0f / 160.0f, 4, 2.0f, 0.55f, 0.0f }, 0.15f,
+            -0.2f, 0.2f
+        };
+    }
+
+    /*
+     * The terrain generator, filling a world's sector cells from noise.
+     *
+     * Each sector is one job on the job pool and cells are evaluated 8 at a
+     * time along each row. Cells are sampled in world coordinates, so sectors
+     * can be made in any order and still meet seamlessly. A group of 8 only
+     * evaluates the area noise it needs, so the cost follows the mix of areas
+     * rather than always paying for all three.
+     *
+     * Each sector is generated into a buffer on the job's stack and handed to
+     * the world, which packs it straight into cold storage unless the sector
+     * is hot, so generating a large map never holds more than its packed
+     * size. Sectors stay asleep until something happens in them. `stream`
+     * spreads a world over frames.
+     */
+    struct TerrainGenerator {
+        TerrainGenerator(void) = delete;
+        TerrainGenerator(TerrainGenerator const&) = delete;
+        TerrainGenerator operator=(TerrainGenerator&) = delete;
+
+        /*
+         * - jobs runs sectors in parallel, or `nullptr` to generate on the
+         *   calling thread
+         */
+        TerrainGenerator(TerrainSettings const& settings, llib::JobPool *const jobs):
+            m_settings(settings), m_jobs(jobs), m_cursor(0) {}
+
+        /*
+         * Generates sectors [`first`, `first + count`) of `world`.
+         */
+        void generate(World &world, usize const first, usize const count) {
+            auto const task = [&](usize const t) { _sector(world, world.sector(first + t)); };
+            if (m_jobs != nullptr) m_jobs->parallel_for(count, task);
+            else for (usize t = 0; t < count; ++t) task(t);
+        }
+
+        // Generates every sector of `world`
+        void generate(World &world) { generate(world, 0, world.sector_count()); }
+
+        /*
+         * Generates the next `budget` sectors of `world` in sector order,
+         * returning true once every sector is done.
+         */
+        auto stream(World &world, usize const budget) -> bool {
+            usize const total = world.sector_count();
+            usize const count = m_cursor + budget < total ? budget : total - m_cursor;
+            generate(world, m_cursor, count);
+            m_cursor += count;
+            return m_cursor == total;
+        }
+
+        // Starts streaming over from the first sector
+        void restart(void) { m_cursor = 0; }
+
+    private:
+        void _sector(World &world, Sector &sector) {
+            using llib::f32x8;
+
+            f32 const base_x = static_cast<f32>((sector.index % world.width()) * SECTOR_CELLS);
+            f32 const base_y = static_cast<f32>((sector.index / world.width()) * SECTOR_CELLS);
+            // Sample at cell centres
+            alignas(32) f32 const centres[8] = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+            f32x8 const lane_x = f32x8::load(centres);
+            TerrainSettings const& s = m_settings;
+            u8 cells[SECTOR_CELLS * SECTOR_CELLS];
+
+            for (usize y = 0; y < SECTOR_CELLS; ++y) {
+                f32x8 const py(base_y + static_cast<f32>(y) + 0.5f);
+                for (usize x = 0; x < SECTOR_CELLS; x += 8) {
+                    f32x8 const px = lane_x + f32x8(base_x + static_cast<f32>(x));
+
+                    alignas(32) f32 area[8], field[8];
+                    llib::fbm2(px, py, s.areas).store(area);
+
+                    bool any[3] = { false, false, false };
+                    u8 kind[8];
+                    for (usize k = 0; k < 8; ++k) {
+                        kind[k] = area[k] < s.caves_below ? AREA_CAVES : (area[k] > s.nebula_above ? AREA_NEBULA : AREA_ASTEROIDS);
+                        any[kind[k]] = true;
+                    }
+
+                    u8 *const row = &cells[y * SECTOR_CELLS + x];
+                    for (usize k = 0; k < 8; ++k) row[k] = MAT_EMPTY;
+
+                    if (any[AREA_CAVES]) {
+                        llib::warp2(px, py, s.caves).store(field);
+                        for (usize k = 0; k < 8; ++k)
+                            if (kind[k] == AREA_CAVES && field[k] <= s.cave_open) row[k] = MAT_ROCK;
+                    }
+                    if (any[AREA_ASTEROIDS]) {
+                        llib::fbm2(px, py, s.asteroids).store(field);
+                        for (usize k = 0; k < 8; ++k)
+                            if (kind[k] == AREA_ASTEROIDS && field[k] > s.asteroid_solid) row[k] = MAT_ROCK;
+                    }
+                    if (any[AREA_NEBULA]) {
+                        llib::fbm3(px, py, f32x8(static_cast<f32>(s.seed % 1024)), s.nebula).store(field);
+                        for (usize k = 0; k < 8; ++k)
+                            if (kind[k] == AREA_NEBULA && field[k] > s.nebula_dense) row[k] = MAT_SAND;
+                    }
+                }
+            }
+
+            world.store_cells(sector, cells);
+            sector.active_cells = 0;
+        }
+
+        TerrainSettings m_settings;
+        llib::JobPool *m_jobs;
+
+        // Next sector `stream` generates
+        usize m_cursor;
+    };
+}
+
+#endif
@@ -0,0 +1,439 @@
+#ifndef VM_HPP
+#define VM_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "../headers/ldata.h"
+#include "../headers/lpool.hpp"
+#include "projectile.hpp"
+
+// Dispatch through a table of label addresses where the compiler allows it.
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+
+namespace game {
+    // Registers per script
+    constexpr usize VM_REGISTERS = 16;
+
+    // Most instructions and constants in a program
+    constexpr usize VM_MAX_CODE = 1 << 16;
+    constexpr usize VM_MAX_CONSTANTS = 1 << 16;
+
+    // Backwards jumps a script may take in one tick before it is cut off
+    constexpr u32 VM_MAX_JUMPS = 1024;
+
+    // Longest wait in frames, the most `VM_WAITK` can encode
+    constexpr u32 VM_MAX_WAIT = 0xffff;
+
+    // Script states per block of the state pool
+    constexpr usize VM_STATES_PER_BLOCK = 256;
+
+    /*
+     * Instructions are 32 bits: the opcode in the low byte followed by three
+     * byte operands `a`, `b` and `c`. Some instructions read `b` and `c`
+     * together as a 16 bit operand `bc`.
+     */
+    enum VmOp : u8 {
+        // Stops the script for good
+        VM_HALT,
+        // r[a] = k[bc]
+        VM_LOADK,
+        // r[a] = r[b]
+        VM_MOV,
+        // r[a] = r[b] + r[c]
+        VM_ADD,
+        // r[a] = r[b] - r[c]
+        VM_SUB,
+        // r[a] = r[b] * r[c]
+        VM_MUL,
+        // r[a] = r[b] / r[c]
+        VM_DIV,
+        // r[a] = r[b] + k[c]
+        VM_ADDK,
+        // r[a] = sin(r[b])
+        VM_SIN,
+        // r[a] = cos(r[b])
+        VM_COS,
+        // pc = bc
+        VM_JMP,
+        // if r[a] < r[b], pc += (i8)c
+        VM_JLT,
+        // Sleeps for r[a] frames
+        VM_WAIT,
+        // Sleeps for bc frames
+        VM_WAITK,
+        // Fires a bullet from the script's position at angle r[a] and speed r[b]
+        VM_FIRE,
+        // Sets the script's velocity to (r[a], r[b])
+        VM_MOVE,
+        // r[a] = x, r[b] = y
+        VM_POS,
+        VM_OP_COUNT
+    };
+
+    // Builds an instruction from its opcode and operands
+    constexpr auto vm_encode(VmOp const op, u8 const a, u8 const b, u8 const c) -> u32 {
+        return static_cast<u32>(op) | (u32(a) << 8) | (u32(b) << 16) | (u32(c) << 24);
+    }
+
+    // Builds an instruction with a 16 bit `bc` operand
+    constexpr auto vm_encode_wide(VmOp const op, u8 const a, u16 const bc) -> u32 {
+        return static_cast<u32>(op) | (u32(a) << 8) | (u32(bc) << 16);
+    }
+
+    /*
+     * A loaded script program.
+     *
+     * Programs are checked once when loaded so the interpreter never has to
+     * check registers, constants or jump targets while running.
+     */
+    struct VmProgram {
+        u32 const *code;
+        u32 code_size;
+        f32 const *constants;
+        u32 constant_count;
+    };
+
+    /*
+     * Checks every instruction of a program.
+     *
+     * Returns false if an opcode is unknown, a register or constant is out of
+     * range, a jump lands outside the code, or the code can run off its end.
+     */
+    inline auto vm_validate(VmProgram const& program) -> bool {
+        if (program.code_size == 0 || program.code_size > VM_MAX_CODE) return false;
+        if (program.constant_count > VM_MAX_CONSTANTS) return false;
+
+        for (u32 pc = 0; pc < program.code_size; ++pc) {
+            u32 const insn = program.code[pc];
+            u32 const op = insn & 0xff;
+            u32 const a = (insn >> 8) & 0xff, b = (insn >> 16) & 0xff, c = insn >> 24;
+            u32 const bc = insn >> 16;
+
+            switch (op) {
+            case VM_HALT: case VM_WAITK:
+                break;
+            case VM_LOADK:
+                if (a >= VM_REGISTERS || bc >= program.constant_count) return false;
+                break;
+            case VM_ADDK:
+                if (a >= VM_REGISTERS || b >= VM_REGISTERS || c >= program.constant_count) return false;
+                break;
+            case VM_ADD: case VM_SUB: case VM_MUL: case VM_DIV:
+                if (a >= VM_REGISTERS || b >= VM_REGISTERS || c >= VM_REGISTERS) return false;
+                break;
+            case VM_MOV: case VM_SIN: case VM_COS: case VM_FIRE: case VM_MOVE: case VM_POS:
+                if (a >= VM_REGISTERS || b >= VM_REGISTERS) return false;
+                break;
+            case VM_WAIT:
+                if (a >= VM_REGISTERS) return false;
+                break;
+            case VM_JMP:
+                if (bc >= program.code_size) return false;
+                break;
+            case VM_JLT: {
+                i64 const target = static_cast<i64>(pc) + 1 + static_cast<i8>(c);
+                if (a >= VM_REGISTERS || b >= VM_REGISTERS) return false;
+                if (target < 0 || target >= program.code_size) return false;
+            } break;
+            default:
+                return false;
+            }
+        }
+
+        // Execution must end in a halt or a jump, never fall off the end.
+        u32 const last = program.code[program.code_size - 1] & 0xff;
+        return last == VM_HALT || last == VM_JMP;
+    }
+
+    /*
+     * Reads a program from a bytecode file already in memory.
+     *
+     * The format is the magic `LVM1`, the instruction count and constant count
+     * as little endian `u32`s, then the instructions and the `f32` constants.
+     * The program points into `data`, which must outlive it and be 4 byte
+     * aligned. Returns false if the data is malformed.
+     */
+    inline auto vm_load(u8 const *const data, usize const size, VmProgram &program) -> bool {
+        if (size < 12 || std::memcmp(data, "LVM1", 4) != 0) return false;
+
+        u32 counts[2];
+        std::memcpy(counts, data + 4, sizeof(counts));
+        usize const needed = 12 + (static_cast<usize>(counts[0]) + counts[1]) * 4;
+        if (size < needed) return false;
+
+        program.code = reinterpret_cast<u32 const *>(data + 12);
+        program.code_size = counts[0];
+        program.constants = reinterpret_cast<f32 const *>(data + 12 + counts[0] * 4);
+        program.constant_count = counts[1];
+        return vm_validate(program);
+    }
+
+    // The state block of one running script
+    struct VmState {
+        f32 r[VM_REGISTERS];
+        f32 x;
+        f32 y;
+        f32 vx;
+        f32 vy;
+        VmProgram const *program;
+        u32 pc;
+        u32 wait;
+        u32 slot;
+        u32 halted;
+    };
+
+    /*
+     * The script machine, running many scripts each tick in one batch.
+     *
+     * Script states come from a pool allocator and the live ones are listed in
+     * an array, so a tick is a straight walk over that array with each script
+     * running until it waits or halts.
+     */
+    struct VmMachine {
+        VmMachine(void) = delete;
+        VmMachine(VmMachine const&) = delete;
+        VmMachine operator=(VmMachine&) = delete;
+
+        /*
+         * - capacity is the most scripts that can run at once
+         */
+        VmMachine(usize const capacity):
+            m_states(VM_STATES_PER_BLOCK, (capacity + VM_STATES_PER_BLOCK - 1) / VM_STATES_PER_BLOCK)
+        {
+            m_capacity = capacity;
+            m_count = 0;
+            m_live = reinterpret_cast<VmState **>(std::malloc(capacity * sizeof(VmState *)));
+        }
+
+        ~VmMachine(void) {
+            std::free(m_live);
+        }
+
+        /*
+         * Starts a validated program at (`x`, `y`).
+         *
+         * Returns `nullptr` if the machine is full.
+         */
+        auto spawn(VmProgram const& program, f32 const x, f32 const y) -> VmState* {
+            if (m_count >= m_capacity) return nullptr;
+
+            VmState *const state = m_states.allocate();
+            if (state == nullptr) return nullptr;
+
+            std::memset(state, 0, sizeof(VmState));
+            state->program = &program;
+            state->x = x;
+            state->y = y;
+            state->slot = static_cast<u32>(m_count);
+            m_live[m_count++] = state;
+            return state;
+        }
+
+        /*
+         * Runs every script for one tick, moving them by `dt` seconds and
+         * firing their bullets into `projectiles`. Halted scripts are freed.
+         *
+         * Returns the number of instructions executed.
+         */
+        auto step(ProjectilePool &projectiles, f32 const dt) -> u64 {
+            u64 executed = 0;
+
+            for (usize i = m_count; i-- > 0;) {
+                VmState &state = *m_live[i];
+
+                if (state.wait > 0) {
+                    --state.wait;
+                } else {
+                    executed += _run(state, projectiles);
+                }
+
+                state.x += state.vx * dt;
+                state.y += state.vy * dt;
+
+                if (state.halted) {
+                    VmState *const last = m_live[--m_count];
+                    m_live[i] = last;
+                    last->slot = static_cast<u32>(i);
+                    m_states.deallocate(&state);
+                }
+            }
+
+            return executed;
+        }
+
+        // Number of running scripts
+        auto count(void) -> usize { return m_count; }
+
+    private:
+        /*
+         * Runs one script until it waits, halts or uses up its jumps.
+         */
+        static auto _run(VmState &state, ProjectilePool &projectiles) -> u64 {
+            u32 const *const code = state.program->code;
+            f32 const *const k = state.program->constants;
+            f32 *const r = state.r;
+            u32 pc = state.pc;
+            u32 jumps = VM_MAX_JUMPS;
+            u64 executed = 0;
+            u32 insn;
+
+#define VM_A ((insn >> 8) & 0xff)
+#define VM_B ((insn >> 16) & 0xff)
+#define VM_C (insn >> 24)
+#define VM_BC (insn >> 16)
+
+#if VM_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+            static void *const labels[VM_OP_COUNT] = {
+                &&op_halt, &&op_loadk, &&op_mov, &&op_add, &&op_sub, &&op_mul,
+                &&op_div, &&op_addk, &&op_sin, &&op_cos, &&op_jmp, &&op_jlt,
+                &&op_wait, &&op_waitk, &&op_fire, &&op_move, &&op_pos
+            };
+#define VM_CASE(name, op) name:
+#define VM_NEXT() do { insn = code[pc++]; ++executed; goto *labels[insn & 0xff]; } while (0)
+            VM_NEXT();
+#else
+#define VM_CASE(name, op) case op:
+#define VM_NEXT() continue
+            for (;;) {
+            insn = code[pc++];
+            ++executed;
+            switch (insn & 0xff) {
+#endif
+
+            VM_CASE(op_halt, VM_HALT)
+                state.halted = 1;
+                state.pc = pc - 1;
+                return executed;
+
+            VM_CASE(op_loadk, VM_LOADK)
+                r[VM_A] = k[VM_BC];
+                VM_NEXT();
+
+            VM_CASE(op_mov, VM_MOV)
+                r[VM_A] = r[VM_B];
+                VM_NEXT();
+
+            VM_CASE(op_add, VM_ADD)
+                r[VM_A] = r[VM_B] + r[VM_C];
+                VM_NEXT();
+
+            VM_CASE(op_sub, VM_SUB)
+                r[VM_A] = r[VM_B] - r[VM_C];
+                VM_NEXT();
+
+            VM_CASE(op_mul, VM_MUL)
+                r[VM_A] = r[VM_B] * r[VM_C];
+                VM_NEXT();
+
+            VM_CASE(op_div, VM_DIV)
+                r[VM_A] = r[VM_B] / r[VM_C];
+                VM_NEXT();
+
+            VM_CASE(op_addk, VM_ADDK)
+                r[VM_A] = r[VM_B] + k[VM_C];
+                VM_NEXT();
+
+            VM_CASE(op_sin, VM_SIN)
+                r[VM_A] = std::sin(r[VM_B]);
+                VM_NEXT();
+
+            VM_CASE(op_cos, VM_COS)
+                r[VM_A] = std::cos(r[VM_B]);
+                VM_NEXT();
+
+            VM_CASE(op_jmp, VM_JMP)
+                // A script spinning without waiting is stopped where it is and
+                // picks up from the jump next tick.
+                if (VM_BC < pc && --jumps == 0) {
+                    state.pc = VM_BC;
+                    return executed;
+                }
+                pc = VM_BC;
+                VM_NEXT();
+
+            VM_CASE(op_jlt, VM_JLT)
+                if (r[VM_A] < r[VM_B]) {
+                    i32 const offset = static_cast<i8>(VM_C);
+                    pc = static_cast<u32>(static_cast<i32>(pc) + offset);
+                    if (offset < 0 && --jumps == 0) {
+                        state.pc = pc;
+                        return executed;
+                    }
+                }
+                VM_NEXT();
+
+            VM_CASE(op_wait, VM_WAIT) {
+                // Compared as floats first, so NaN and huge waits never reach the cast
+                f32 const frames = r[VM_A];
+                state.wait = frames >= static_cast<f32>(VM_MAX_WAIT) ? VM_MAX_WAIT - 1
+                           : frames > 1.0f ? static_cast<u32>(frames) - 1 : 0;
+                state.pc = pc;
+                return executed;
+            }
+
+            VM_CASE(op_waitk, VM_WAITK)
+                state.wait = VM_BC > 0 ? VM_BC - 1 : 0;
+                state.pc = pc;
+                return executed;
+
+            VM_CASE(op_fire, VM_FIRE) {
+                usize reserved;
+                usize const b = projectiles.reserve(1, reserved);
+                if (reserved == 1) {
+                    f32 const angle = r[VM_A], speed = r[VM_B];
+                    projectiles.x[b] = state.x;
+                    projectiles.y[b] = state.y;
+                    projectiles.vx[b] = std::cos(angle) * speed;
+                    projectiles.vy[b] = std::sin(angle) * speed;
+                    projectiles.damage[b] = 1.0f;
+                    projectiles.homing[b] = 0.0f;
+                    projectiles.life[b] = 5.0f;
+                    projectiles.flags[b] = PROJECTILE_NONE;
+                    projectiles.bounces[b] = 0;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(op_move, VM_MOVE)
+                state.vx = r[VM_A];
+                state.vy = r[VM_B];
+                VM_NEXT();
+
+            VM_CASE(op_pos, VM_POS)
+                r[VM_A] = state.x;
+                r[VM_B] = state.y;
+                VM_NEXT();
+
+#if VM_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#else
+            }
+            }
+#endif
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_A
+#undef VM_B
+#undef VM_C
+#undef VM_BC
+        }
+
+        // Allocator for script states
+        llib::PoolAllocator<VmState> m_states;
+
+        // Running scripts, the first `m_count` entries
+        VmState **m_live;
+        usize m_count;
+        usize m_capacity;
+    };
+}
+
+#endif
@@ -0,0 +1,381 @@
+#ifndef WEAPON_HPP
+#define WEAPON_HPP
+
+#include <cmath>
+#include "../headers/ldata.h"
+#include "projectile.hpp"
+
+namespace game {
+    // Most instructions a compiled weapon can hold
+    constexpr usize WEAPON_MAX_OPS = 32;
+
+    // Most constants a compiled weapon can hold
+    constexpr usize WEAPON_MAX_TABLE = 512;
+
+    // Most bullets a single volley can produce
+    constexpr usize WEAPON_MAX_VOLLEY = 1024;
+
+    /*
+     * The modifiers a player can stack onto a weapon, in the order they apply.
+     *
+     * Shape modifiers multiply the number of shots in a volley, while stat
+     * modifiers change every shot equally.
+     */
+    enum WeaponModifierKind : u8 {
+        // Shape: `count` shots fanned across `value` radians
+        MOD_SPREAD,
+        // Shape: `count` parallel shots `value` units apart
+        MOD_SPLIT,
+        // Shape: `count` shots each `value` times faster than the last
+        MOD_RAMP,
+        // Shape: rotates the volley by `value` radians per volley fired
+        MOD_SPIN,
+        // Stat: multiplies speed by `value`
+        MOD_SPEED,
+        // Stat: multiplies damage by `value`
+        MOD_DAMAGE,
+        // Stat: multiplies lifetime by `value`
+        MOD_LIFETIME,
+        // Stat: adds `value` homing strength
+        MOD_HOMING,
+        // Stat: adds `count` bounces
+        MOD_BOUNCE
+    };
+
+    struct WeaponModifier {
+        WeaponModifierKind kind;
+        u32 count;
+        f32 value;
+    };
+
+    // A weapon as built by the player, before compilation
+    struct WeaponConfig {
+        f32 speed;
+        f32 damage;
+        f32 lifetime;
+        WeaponModifier const *modifiers;
+        usize modifier_count;
+    };
+
+    enum WeaponOpCode : u8 {
+        WOP_FAN,
+        WOP_SPLIT,
+        WOP_RAMP,
+        WOP_SPIN,
+        WOP_EMIT
+    };
+
+    /*
+     * A single instruction, sized so four fit in a cache line.
+     *
+     * `count` is the number of shots each existing shot becomes and `table` is
+     * the offset of that instruction's precomputed constants in the program.
+     */
+    struct WeaponOp {
+        WeaponOpCode code;
+        u8 _pad;
+        u16 count;
+        u16 table;
+        u16 _pad2;
+        f32 value;
+        u32 _pad3;
+    };
+
+    static_assert(sizeof(WeaponOp) == 16, "WeaponOp should stay 16 bytes");
+
+    /*
+     * A compiled weapon, a flat instruction array with its constant table.
+     *
+     * Stat modifiers are folded into the per bullet attributes at compile time,
+     * so only the shape of a volley is left for the interpreter.
+     */
+    struct WeaponProgram {
+        WeaponOp ops[WEAPON_MAX_OPS];
+        u32 op_count;
+
+        // Sines, cosines and offsets used by the instructions
+        f32 table[WEAPON_MAX_TABLE];
+        u32 table_size;
+
+        // Number of bullets each volley emits
+        u32 volley_size;
+
+        // Attributes shared by every bullet
+        f32 speed;
+        f32 damage;
+        f32 lifetime;
+        f32 homing;
+        u32 flags;
+        u32 bounces;
+    };
+
+    /*
+     * Compiles a weapon configuration into a program.
+     *
+     * Returns false if the weapon has too many shape modifiers, needs more
+     * constants than the table holds, or a volley would exceed
+     * `WEAPON_MAX_VOLLEY` bullets.
+     */
+    inline auto compile_weapon(WeaponConfig const& config, WeaponProgram &program) -> bool {
+        program.op_count = 0;
+        program.table_size = 0;
+        program.volley_size = 1;
+        program.speed = config.speed;
+        program.damage = config.damage;
+        program.lifetime = config.lifetime;
+        program.homing = 0.0f;
+        program.flags = PROJECTILE_NONE;
+        program.bounces = 0;
+
+        for (usize i = 0; i < config.modifier_count; ++i) {
+            WeaponModifier const& mod = config.modifiers[i];
+
+            // Fold stat modifiers straight into the bullet attributes.
+            switch (mod.kind) {
+            case MOD_SPEED:    program.speed *= mod.value;    continue;
+            case MOD_DAMAGE:   program.damage *= mod.value;   continue;
+            case MOD_LIFETIME: program.lifetime *= mod.value; continue;
+            case MOD_HOMING:
+                program.homing += mod.value;
+                program.flags |= PROJECTILE_HOMING;
+                continue;
+            case MOD_BOUNCE:
+                program.bounces += mod.count;
+                program.flags |= PROJECTILE_BOUNCE;
+                continue;
+            default: break;
+            }
+
+            // Back to back spins are a single rotation.
+            if (mod.kind == MOD_SPIN) {
+                if (program.op_count > 0 && program.ops[program.op_count - 1].code == WOP_SPIN) {
+                    program.ops[program.op_count - 1].value += mod.value;
+                    continue;
+                }
+            } else {
+                // A shape modifier of one shot does nothing.
+                if (mod.count <= 1) continue;
+                // Divide rather than multiply, as counts from a pack can be huge.
+                if (mod.count > WEAPON_MAX_VOLLEY / program.volley_size) return false;
+            }
+
+            // Leave room for the final emit.
+            if (program.op_count >= WEAPON_MAX_OPS - 1) return false;
+
+            WeaponOp &op = program.ops[program.op_count++];
+            op = WeaponOp{};
+            op.count = static_cast<u16>(mod.kind == MOD_SPIN ? 1 : mod.count);
+            op.table = static_cast<u16>(program.table_size);
+            op.value = mod.value;
+
+            usize const table_needed = mod.kind == MOD_SPREAD ? 2 * op.count
+                                     : mod.kind == MOD_SPIN ? 0 : op.count;
+            if (program.table_size + table_needed > WEAPON_MAX_TABLE) return false;
+
+            f32 *const table = program.table + program.table_size;
+            program.table_size += static_cast<u32>(table_needed);
+
+            switch (mod.kind) {
+            case MOD_SPREAD: {
+                // Each shot becomes `count` shots evenly fanned across the arc,
+                // stored as (cos, sin) pairs so rotation is a complex multiply.
+                op.code = WOP_FAN;
+                f32 const step = mod.value / static_cast<f32>(op.count - 1);
+                for (usize k = 0; k < op.count; ++k) {
+                    f32 const angle = -0.5f * mod.value + step * static_cast<f32>(k);
+                    table[2 * k] = std::cos(angle);
+                    table[2 * k + 1] = std::sin(angle);
+                }
+            } break;
+            case MOD_SPLIT: {
+                // Sideways offsets centred on the original shot.
+                op.code = WOP_SPLIT;
+                f32 const centre = 0.5f * static_cast<f32>(op.count - 1);
+                for (usize k = 0; k < op.count; ++k)
+                    table[k] = (static_cast<f32>(k) - centre) * mod.value;
+            } break;
+            case MOD_RAMP: {
+                op.code = WOP_RAMP;
+                f32 scale = 1.0f;
+                for (usize k = 0; k < op.count; ++k) {
+                    table[k] = scale;
+                    scale *= mod.value;
+                }
+            } break;
+            case MOD_SPIN:
+                op.code = WOP_SPIN;
+                break;
+            default:
+                return false;
+            }
+
+            if (mod.kind != MOD_SPIN) program.volley_size *= op.count;
+        }
+
+        program.ops[program.op_count] = WeaponOp{};
+        program.ops[program.op_count++].code = WOP_EMIT;
+        return true;
+    }
+
+    /*
+     * Runs compiled weapons, building each volley in a scratch buffer and
+     * emitting it into a projectile pool.
+     *
+     * Volleys are built in the weapon's local frame, facing along +x, and only
+     * rotated into the world while being written to the pool. The scratch
+     * buffer is kept between volleys so firing never allocates.
+     */
+    struct WeaponInterpreter {
+        /*
+         * Fires a single volley of `program` from (`x`, `y`) along the unit
+         * direction (`aim_x`, `aim_y`). `volley` is how many volleys the weapon
+         * has fired so far, used by spinning patterns.
+         *
+         * Returns the number of bullets emitted, which is less than the volley
+         * size when the pool is full.
+         */
+        auto fire(
+            WeaponProgram const& program,
+            ProjectilePool &pool,
+            f32 const x, f32 const y,
+            f32 const aim_x, f32 const aim_y,
+            u32 const volley
+        ) -> usize {
+            // Every volley starts as a single shot from the muzzle.
+            usize n = 1;
+            m_dx[0] = 1.0f;
+            m_dy[0] = 0.0f;
+            m_ox[0] = 0.0f;
+            m_oy[0] = 0.0f;
+            m_speed[0] = 1.0f;
+
+            for (WeaponOp const *op = program.ops;; ++op) {
+                f32 const *const table = program.table + op->table;
+                usize const count = op->count;
+
+                switch (op->code) {
+                case WOP_FAN:
+                    // Expand in place from the back so no shot is overwritten
+                    // before it has been read.
+                    for (usize i = n; i-- > 0;) {
+                        f32 const dx = m_dx[i], dy = m_dy[i];
+                        f32 const ox = m_ox[i], oy = m_oy[i], speed = m_speed[i];
+                        for (usize k = 0; k < count; ++k) {
+                            usize const j = i * count + k;
+                            f32 const c = table[2 * k], s = table[2 * k + 1];
+                            m_dx[j] = dx * c - dy * s;
+                            m_dy[j] = dx * s + dy * c;
+                            m_ox[j] = ox;
+                            m_oy[j] = oy;
+                            m_speed[j] = speed;
+                        }
+                    }
+                    n *= count;
+                    break;
+
+                case WOP_SPLIT:
+                    for (usize i = n; i-- > 0;) {
+                        f32 const dx = m_dx[i], dy = m_dy[i];
+                        f32 const ox = m_ox[i], oy = m_oy[i], speed = m_speed[i];
+                        for (usize k = 0; k < count; ++k) {
+                            usize const j = i * count + k;
+                            // Offset along the perpendicular (-dy, dx).
+                            m_dx[j] = dx;
+                            m_dy[j] = dy;
+                            m_ox[j] = ox - dy * table[k];
+                            m_oy[j] = oy + dx * table[k];
+                            m_speed[j] = speed;
+                        }
+                    }
+                    n *= count;
+                    break;
+
+                case WOP_RAMP:
+                    for (usize i = n; i-- > 0;) {
+                        f32 const dx = m_dx[i], dy = m_dy[i];
+                        f32 const ox = m_ox[i], oy = m_oy[i], speed = m_speed[i];
+                        for (usize k = 0; k < count; ++k) {
+                            usize const j = i * count + k;
+                            m_dx[j] = dx;
+                            m_dy[j] = dy;
+                            m_ox[j] = ox;
+                            m_oy[j] = oy;
+                            m_speed[j] = speed * table[k];
+                        }
+                    }
+                    n *= count;
+                    break;
+
+                case WOP_SPIN: {
+                    // One sin/cos per volley, not per shot.
+                    f32 const angle = op->value * static_cast<f32>(volley);
+                    f32 const c = std::cos(angle), s = std::sin(angle);
+                    for (usize i = 0; i < n; ++i) {
+                        f32 const dx = m_dx[i], dy = m_dy[i];
+                        f32 const ox = m_ox[i], oy = m_oy[i];
+                        m_dx[i] = dx * c - dy * s;
+                        m_dy[i] = dx * s + dy * c;
+                        m_ox[i] = ox * c - oy * s;
+                        m_oy[i] = ox * s + oy * c;
+                    }
+                } break;
+
+                case WOP_EMIT:
+                    return _emit(program, pool, n, x, y, aim_x, aim_y);
+
+                default:
+                    // A corrupt program, emit nothing rather than run off the end
+                    return 0;
+                }
+            }
+        }
+
+    private:
+        /*
+         * Rotates the volley into the world and writes it straight into the
+         * pool's field arrays.
+         */
+        auto _emit(
+            WeaponProgram const& program,
+            ProjectilePool &pool,
+            usize const n,
+            f32 const x, f32 const y,
+            f32 const aim_x, f32 const aim_y
+        ) -> usize {
+            usize reserved;
+            usize const first = pool.reserve(n, reserved);
+
+            f32 *const px = pool.x + first;
+            f32 *const py = pool.y + first;
+            f32 *const pvx = pool.vx + first;
+            f32 *const pvy = pool.vy + first;
+
+            for (usize i = 0; i < reserved; ++i) {
+                f32 const speed = m_speed[i] * program.speed;
+                px[i] = x + m_ox[i] * aim_x - m_oy[i] * aim_y;
+                py[i] = y + m_ox[i] * aim_y + m_oy[i] * aim_x;
+                pvx[i] = (m_dx[i] * aim_x - m_dy[i] * aim_y) * speed;
+                pvy[i] = (m_dx[i] * aim_y + m_dy[i] * aim_x) * speed;
+            }
+
+            for (usize i = 0; i < reserved; ++i) {
+                pool.damage[first + i] = program.damage;
+                pool.homing[first + i] = program.homing;
+                pool.life[first + i] = program.lifetime;
+                pool.flags[first + i] = program.flags;
+                pool.bounces[first + i] = program.bounces;
+            }
+
+            return reserved;
+        }
+
+        // The volley being built, in the weapon's local frame
+        f32 m_dx[WEAPON_MAX_VOLLEY];
+        f32 m_dy[WEAPON_MAX_VOLLEY];
+        f32 m_ox[WEAPON_MAX_VOLLEY];
+        f32 m_oy[WEAPON_MAX_VOLLEY];
+        f32 m_speed[WEAPON_MAX_VOLLEY];
+    };
+}
+
+#endif
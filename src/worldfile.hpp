@@ -0,0 +1,518 @@
+#ifndef WORLDFILE_HPP
+#define WORLDFILE_HPP
+
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../headers/ldata.h"
+#include "../headers/lpool.hpp"
+#include "sector.hpp"
+
+namespace game {
+    // Bytes of cells in a chunk, one chunk per sector
+    constexpr usize CHUNK_BYTES = SECTOR_CELLS * SECTOR_CELLS;
+
+    // Chunk data is laid out on boundaries of this many bytes, a page
+    constexpr usize CHUNK_ALIGN = 4096;
+
+    // Resident chunks in each block of the chunk pool
+    constexpr usize CHUNKS_PER_BLOCK = 16;
+
+    constexpr u32 WORLD_FILE_MAGIC = 0x444c5257; // "WRLD"
+    constexpr u32 WORLD_FILE_VERSION = 1;
+
+    // The chunk has been written at least once, otherwise it reads as empty
+    constexpr u32 CHUNK_PRESENT = 1;
+
+    // The start of a world file
+    struct WorldFileHeader {
+        u32 magic;
+        u32 version;
+        // Size of the world in chunks
+        u32 width;
+        u32 height;
+        u32 chunk_cells;
+        u32 reserved;
+        // Where the first chunk starts, a multiple of `CHUNK_ALIGN`
+        u64 data_offset;
+    };
+
+    // Where a chunk lives in the file, one per chunk after the header
+    struct WorldChunkEntry {
+        u64 offset;
+        u32 size;
+        u32 flags;
+    };
+
+    // What opening a world file found
+    enum WorldOpen : u8 {
+        // Nothing that looks like a world, so a new one can be made
+        WORLD_OPEN_NONE,
+        WORLD_OPEN_MAPPED,
+        // A world that couldn't be read or mapped, which is left as it is
+        WORLD_OPEN_FAILED
+    };
+
+    enum ChunkState : u8 {
+        // In the LRU list, free to use and evict
+        CHUNK_RESIDENT,
+        // Handed to the writeback thread, kept out of the LRU list
+        CHUNK_WRITING
+    };
+
+    // A chunk held in memory
+    struct WorldChunk {
+        u8 cells[CHUNK_BYTES];
+        u32 index;
+        u8 state;
+        bool dirty;
+        // Set by the writeback thread under the queue lock once written
+        bool written;
+
+        // Least recently used list, most recent first
+        WorldChunk *lru_prev;
+        WorldChunk *lru_next;
+
+        // Next chunk in the writeback or returned queue
+        WorldChunk *queue_next;
+    };
+
+    // What the chunk cache did since the last `reset_stats`
+    struct WorldFileStats {
+        usize hits;
+        usize page_ins;
+        usize evictions;
+        usize writebacks;
+        // Times the game thread had to wait on the writeback thread
+        usize stalls;
+    };
+
+    /*
+     * The world file, a memory-mapped store of every sector's cells with
+     * only a bounded set of them held in memory.
+     *
+     * The file is a header, an index entry per chunk and then the chunks on
+     * page boundaries. A new file is sized up front but left sparse, so
+     * chunks that were never written take no disk and read as empty. Chunks
+     * are copied out of the mapping into nodes from a pool allocator on first
+     * use, after which the mapped pages are dropped again, so the pages the
+     * process holds stay at the budget however big the world is. `prefetch`
+     * asks the kernel to read ahead the chunks around a point, so they are
+     * already in the page cache when the player gets there.
+     *
+     * Once the budget is used the least recently used chunk is evicted. Clean
+     * chunks are reused straight away, dirty ones are queued for the
+     * writeback thread, which copies them into the mapping and starts the
+     * write out to disk, then hands the node back as a clean chunk at the cold
+     * end of the LRU list. Asking for a chunk that is still being written
+     * waits for it, which costs a 4 KiB copy at most.
+     *
+     * Chunk pointers are valid until the next call to `chunk` or `modify`.
+     */
+    struct WorldFile {
+        WorldFile(void) = delete;
+        WorldFile(WorldFile const&) = delete;
+        WorldFile operator=(WorldFile&) = delete;
+
+        /*
+         * Opens the world file at `path`, or creates one of `width` by
+         * `height` chunks if there is no world there. A world that is there
+         * but can't be read or mapped is never overwritten, and the file is
+         * left invalid. Check `valid()` before use.
+         *
+         * - budget is the most chunks held in memory at once, at least one
+         */
+        WorldFile(char const *const path, u32 const width, u32 const height, usize const budget):
+            m_chunks(CHUNKS_PER_BLOCK, (_min_budget(budget) + CHUNKS_PER_BLOCK - 1) / CHUNKS_PER_BLOCK)
+        {
+            m_map = nullptr;
+            m_map_size = 0;
+            m_resident = nullptr;
+            m_budget = _min_budget(budget);
+            m_count = 0;
+            m_lru_head = nullptr;
+            m_lru_tail = nullptr;
+            m_pending_head = nullptr;
+            m_pending_tail = nullptr;
+            m_returned = nullptr;
+            m_in_flight = 0;
+            m_stopping = false;
+            m_stats = {};
+
+            m_fd = ::open(path, O_RDWR | O_CREAT, 0644);
+            if (m_fd < 0) return;
+            WorldOpen const found = _map_existing();
+            if (found == WORLD_OPEN_FAILED || (found == WORLD_OPEN_NONE && !_map_new(width, height))) {
+                ::close(m_fd);
+                m_fd = -1;
+                return;
+            }
+
+            m_resident = reinterpret_cast<WorldChunk **>(std::calloc(chunk_count(), sizeof(ptr)));
+            m_writer = std::thread([this] { _write_loop(); });
+        }
+
+        /*
+         * Writes back every dirty chunk, then stops the writeback thread and
+         * unmaps the file.
+         */
+        ~WorldFile(void) {
+            if (m_fd < 0) return;
+            flush();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_wake.notify_all();
+            m_writer.join();
+
+            ::munmap(m_map, m_map_size);
+            ::close(m_fd);
+            std::free(m_resident);
+        }
+
+        // Whether the file opened and mapped
+        auto valid(void) -> bool { return m_fd >= 0; }
+
+        /*
+         * Returns chunk `index` for reading, paging it in if it isn't
+         * resident.
+         */
+        auto chunk(u32 const index) -> WorldChunk* {
+            _reclaim();
+
+            WorldChunk *c = m_resident[index];
+            if (c != nullptr) {
+                ++m_stats.hits;
+                if (c->state == CHUNK_WRITING) _wait(c);
+                _unlink_lru(c);
+                _push_lru(c);
+                return c;
+            }
+
+            c = _take();
+            c->index = index;
+            c->state = CHUNK_RESIDENT;
+            c->dirty = false;
+            c->written = false;
+            _page_in(c);
+            m_resident[index] = c;
+            _push_lru(c);
+            ++m_stats.page_ins;
+            return c;
+        }
+
+        // Returns chunk `index` for writing, to be written back on eviction
+        auto modify(u32 const index) -> u8* {
+            WorldChunk *const c = chunk(index);
+            c->dirty = true;
+            return c->cells;
+        }
+
+        // Replaces a sector's cells with its chunk's
+        void load(World &world, Sector &sector) {
+            world.store_cells(sector, chunk(static_cast<u32>(sector.index))->cells);
+        }
+
+        // Copies a sector's cells into its chunk, hot or cold
+        void store(World &world, Sector const& sector) {
+            world.read_cells(sector, modify(static_cast<u32>(sector.index)));
+        }
+
+        /*
+         * Starts reading the chunks within `radius` of (`x`, `y`) in world
+         * units into the page cache in the background.
+         */
+        void prefetch(f32 const x, f32 const y, f32 const radius) {
+            WorldFileHeader const& h = _header();
+            i32 const x0 = _clamp(static_cast<i32>((x - radius) / SECTOR_SIZE), h.width);
+            i32 const y0 = _clamp(static_cast<i32>((y - radius) / SECTOR_SIZE), h.height);
+            i32 const x1 = _clamp(static_cast<i32>((x + radius) / SECTOR_SIZE), h.width);
+            i32 const y1 = _clamp(static_cast<i32>((y + radius) / SECTOR_SIZE), h.height);
+
+            for (i32 cy = y0; cy <= y1; ++cy) {
+                // A row of chunks is contiguous in the file
+                u32 const first = static_cast<u32>(cy) * h.width + static_cast<u32>(x0);
+                usize const count = static_cast<usize>(x1 - x0 + 1);
+                ::madvise(_slot(first), count * CHUNK_ALIGN, MADV_WILLNEED);
+            }
+        }
+
+        /*
+         * Writes back every dirty chunk and waits until the file is up to
+         * date on disk.
+         */
+        void flush(void) {
+            WorldChunk *c = m_lru_head;
+            while (c != nullptr) {
+                WorldChunk *const next = c->lru_next;
+                if (c->dirty) {
+                    _unlink_lru(c);
+                    _queue(c);
+                }
+                c = next;
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_done.wait(lock, [this] { return m_in_flight == 0; });
+            }
+            _reclaim();
+            ::msync(m_map, m_map_size, MS_SYNC);
+        }
+
+        auto width(void) -> u32 { return _header().width; }
+        auto height(void) -> u32 { return _header().height; }
+        auto chunk_count(void) -> usize { return static_cast<usize>(width()) * height(); }
+
+        // Chunks currently held in memory
+        auto resident(void) -> usize { return m_count; }
+
+        // Bytes of chunks the cache can ever hold
+        auto budget_bytes(void) -> usize { return m_budget * sizeof(WorldChunk); }
+
+        auto stats(void) -> WorldFileStats { return m_stats; }
+        void reset_stats(void) { m_stats = {}; }
+
+    private:
+        auto _header(void) -> WorldFileHeader& { return *reinterpret_cast<WorldFileHeader *>(m_map); }
+
+        auto _entry(u32 const index) -> WorldChunkEntry& {
+            return reinterpret_cast<WorldChunkEntry *>(m_map + sizeof(WorldFileHeader))[index];
+        }
+
+        auto _slot(u32 const index) -> u8* { return m_map + _header().data_offset + static_cast<usize>(index) * CHUNK_ALIGN; }
+
+        static auto _min_budget(usize const budget) -> usize { return budget > 0 ? budget : 1; }
+
+        static auto _clamp(i32 const v, u32 const size) -> i32 {
+            return v < 0 ? 0 : (v >= static_cast<i32>(size) ? static_cast<i32>(size) - 1 : v);
+        }
+
+        static auto _data_offset(usize const chunks) -> u64 {
+            usize const index_end = sizeof(WorldFileHeader) + chunks * sizeof(WorldChunkEntry);
+            return (index_end + CHUNK_ALIGN - 1) / CHUNK_ALIGN * CHUNK_ALIGN;
+        }
+
+        auto _map(usize const size) -> bool {
+            ptr const map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+            if (map == MAP_FAILED) return false;
+            m_map = reinterpret_cast<u8 *>(map);
+            m_map_size = size;
+            return true;
+        }
+
+        /*
+         * Maps the world already in the file. A file too short for a header,
+         * or without the world magic, holds no world. One with the magic is
+         * someone's world, so if it's from another version, cut short or
+         * can't be mapped it fails rather than being replaced.
+         */
+        auto _map_existing(void) -> WorldOpen {
+            struct stat info;
+            if (::fstat(m_fd, &info) != 0) return WORLD_OPEN_FAILED;
+            if (static_cast<usize>(info.st_size) < sizeof(WorldFileHeader)) return WORLD_OPEN_NONE;
+
+            WorldFileHeader h;
+            if (::pread(m_fd, &h, sizeof(h), 0) != static_cast<isize>(sizeof(h))) return WORLD_OPEN_FAILED;
+            if (h.magic != WORLD_FILE_MAGIC) return WORLD_OPEN_NONE;
+            if (h.version != WORLD_FILE_VERSION || h.chunk_cells != SECTOR_CELLS) return WORLD_OPEN_FAILED;
+
+            usize const chunks = static_cast<usize>(h.width) * h.height;
+            usize const size = _data_offset(chunks) + chunks * CHUNK_ALIGN;
+            if (h.data_offset != _data_offset(chunks) || static_cast<usize>(info.st_size) < size) return WORLD_OPEN_FAILED;
+            return _map(size) ? WORLD_OPEN_MAPPED : WORLD_OPEN_FAILED;
+        }
+
+        // Sizes the file for a new empty world and maps it
+        auto _map_new(u32 const width, u32 const height) -> bool {
+            usize const chunks = static_cast<usize>(width) * height;
+            usize const size = _data_offset(chunks) + chunks * CHUNK_ALIGN;
+            if (::ftruncate(m_fd, 0) != 0 || ::ftruncate(m_fd, static_cast<off_t>(size)) != 0) return false;
+            if (!_map(size)) return false;
+
+            _header() = { WORLD_FILE_MAGIC, WORLD_FILE_VERSION, width, height, SECTOR_CELLS, 0, _data_offset(chunks) };
+            return true;
+        }
+
+        // Copies a chunk out of the mapping, then drops the mapped pages
+        void _page_in(WorldChunk *const c) {
+            WorldChunkEntry const& entry = _entry(c->index);
+            if ((entry.flags & CHUNK_PRESENT) == 0) {
+                std::memset(c->cells, MAT_EMPTY, CHUNK_BYTES);
+                return;
+            }
+            u8 *const slot = _slot(c->index);
+            std::memcpy(c->cells, slot, CHUNK_BYTES);
+            ::madvise(slot, CHUNK_ALIGN, MADV_DONTNEED);
+        }
+
+        // Finds a node for a new chunk, evicting or waiting as needed
+        auto _take(void) -> WorldChunk* {
+            if (m_count < m_budget) {
+                WorldChunk *const c = m_chunks.allocate();
+                if (c != nullptr) {
+                    ++m_count;
+                    return c;
+                }
+            }
+
+            for (;;) {
+                WorldChunk *const c = m_lru_tail;
+                if (c == nullptr) {
+                    // Everything is being written back
+                    ++m_stats.stalls;
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        m_done.wait(lock, [this] { return m_returned != nullptr; });
+                    }
+                    _reclaim();
+                    continue;
+                }
+
+                _unlink_lru(c);
+                if (c->dirty) {
+                    _queue(c);
+                    continue;
+                }
+                m_resident[c->index] = nullptr;
+                ++m_stats.evictions;
+                return c;
+            }
+        }
+
+        // Hands a dirty chunk to the writeback thread
+        void _queue(WorldChunk *const c) {
+            c->state = CHUNK_WRITING;
+            c->dirty = false;
+            c->queue_next = nullptr;
+            ++m_stats.writebacks;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_pending_tail != nullptr) m_pending_tail->queue_next = c;
+                else m_pending_head = c;
+                m_pending_tail = c;
+                ++m_in_flight;
+            }
+            m_wake.notify_one();
+        }
+
+        // Waits until the writeback thread is done with a chunk
+        void _wait(WorldChunk *const c) {
+            ++m_stats.stalls;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_done.wait(lock, [c] { return c->written; });
+            }
+            _reclaim();
+        }
+
+        // Puts written chunks back at the cold end of the LRU list
+        void _reclaim(void) {
+            WorldChunk *c;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                c = m_returned;
+                m_returned = nullptr;
+            }
+            while (c != nullptr) {
+                WorldChunk *const next = c->queue_next;
+                c->state = CHUNK_RESIDENT;
+                c->written = false;
+                _push_lru_tail(c);
+                c = next;
+            }
+        }
+
+        void _write_loop(void) {
+            for (;;) {
+                WorldChunk *c;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wake.wait(lock, [this] { return m_pending_head != nullptr || m_stopping; });
+                    if (m_pending_head == nullptr) return;
+                    c = m_pending_head;
+                    m_pending_head = c->queue_next;
+                    if (m_pending_head == nullptr) m_pending_tail = nullptr;
+                }
+
+                u8 *const slot = _slot(c->index);
+                std::memcpy(slot, c->cells, CHUNK_BYTES);
+                WorldChunkEntry &entry = _entry(c->index);
+                entry.offset = static_cast<u64>(slot - m_map);
+                entry.size = CHUNK_BYTES;
+                entry.flags |= CHUNK_PRESENT;
+                // Start the write to disk, then let go of the pages, which
+                // stay dirty in the page cache until written
+                ::msync(slot, CHUNK_ALIGN, MS_ASYNC);
+                ::madvise(slot, CHUNK_ALIGN, MADV_DONTNEED);
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    c->written = true;
+                    c->queue_next = m_returned;
+                    m_returned = c;
+                    --m_in_flight;
+                }
+                m_done.notify_all();
+            }
+        }
+
+        void _push_lru(WorldChunk *const c) {
+            c->lru_prev = nullptr;
+            c->lru_next = m_lru_head;
+            if (m_lru_head != nullptr) m_lru_head->lru_prev = c;
+            else m_lru_tail = c;
+            m_lru_head = c;
+        }
+
+        void _push_lru_tail(WorldChunk *const c) {
+            c->lru_next = nullptr;
+            c->lru_prev = m_lru_tail;
+            if (m_lru_tail != nullptr) m_lru_tail->lru_next = c;
+            else m_lru_head = c;
+            m_lru_tail = c;
+        }
+
+        void _unlink_lru(WorldChunk *const c) {
+            if (c->lru_prev != nullptr) c->lru_prev->lru_next = c->lru_next;
+            else m_lru_head = c->lru_next;
+            if (c->lru_next != nullptr) c->lru_next->lru_prev = c->lru_prev;
+            else m_lru_tail = c->lru_prev;
+        }
+
+        int m_fd;
+        u8 *m_map;
+        usize m_map_size;
+
+        llib::PoolAllocator<WorldChunk> m_chunks;
+        usize m_budget;
+        usize m_count;
+
+        // Node of each resident chunk by index, or `nullptr`
+        WorldChunk **m_resident;
+
+        WorldChunk *m_lru_head;
+        WorldChunk *m_lru_tail;
+
+        // Shared with the writeback thread under `m_mutex`
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        WorldChunk *m_pending_head;
+        WorldChunk *m_pending_tail;
+        WorldChunk *m_returned;
+        usize m_in_flight;
+        bool m_stopping;
+        std::thread m_writer;
+
+        WorldFileStats m_stats;
+    };
+}
+
+#endif